@@ -0,0 +1,181 @@
+#include "checksumpanel.h"
+#include "qhexedit.h"
+#include <QAction>
+#include <QApplication>
+#include <QClipboard>
+#include <QComboBox>
+#include <QHeaderView>
+#include <QLabel>
+#include <QSettings>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+#include <QtConcurrent>
+
+// Selections are checksummed once they stopped changing for this long
+constexpr int updateDelayMs = 150;
+
+ChecksumPanel::ChecksumPanel(QWidget *parent)
+    : QWidget(parent), m_pos(0), m_count(0)
+{
+    m_cmbScope = new QComboBox(this);
+    m_cmbScope->addItem(tr("Selection"));
+    m_cmbScope->addItem(tr("Whole image"));
+    m_status = new QLabel(this);
+    m_view = new QTreeWidget(this);
+    m_view->setColumnCount(2);
+    m_view->setHeaderLabels({ tr("Algorithm"), tr("Value") });
+    m_view->setRootIsDecorated(false);
+    m_view->header()->setStretchLastSection(true);
+    m_view->setContextMenuPolicy(Qt::ActionsContextMenu);
+
+    QSettings settings("RigoLigo", "PicoEaseUI");
+    QStringList checked = settings.value("Checksums/Algorithms",
+                                         QStringList { Checksum::name(Checksum::Sum8),
+                                                       Checksum::name(Checksum::Crc16Ccitt),
+                                                       Checksum::name(Checksum::Crc32),
+                                                       Checksum::name(Checksum::Sha256) }).toStringList();
+    for (int idx = 0; idx < Checksum::AlgorithmCount; idx++) {
+        auto name = Checksum::name(Checksum::Algorithm(idx));
+        auto item = new QTreeWidgetItem(m_view, { name });
+        item->setData(0, Qt::UserRole, idx);
+        item->setCheckState(0, checked.contains(name) ? Qt::Checked : Qt::Unchecked);
+        item->setFont(1, QFont("Monospace"));
+    }
+    m_view->resizeColumnToContents(0);
+
+    auto copy = new QAction(tr("Copy value"), m_view);
+    m_view->addAction(copy);
+    connect(copy, &QAction::triggered, this, [this]() {
+        if (m_view->currentItem())
+            QApplication::clipboard()->setText(m_view->currentItem()->text(1));
+    });
+
+    auto layout = new QVBoxLayout(this);
+    layout->setContentsMargins(3, 3, 3, 3);
+    layout->addWidget(m_cmbScope);
+    layout->addWidget(m_status);
+    layout->addWidget(m_view);
+
+    m_delay.setSingleShot(true);
+    m_delay.setInterval(updateDelayMs);
+    connect(&m_delay, &QTimer::timeout, this, &ChecksumPanel::startCompute);
+    connect(m_cmbScope, &QComboBox::currentIndexChanged, this, &ChecksumPanel::scheduleUpdate);
+    connect(m_view, &QTreeWidget::itemChanged, this, &ChecksumPanel::itemChanged);
+    connect(&m_watcher, &QFutureWatcherBase::finished, this, &ChecksumPanel::computeFinished);
+    connect(&m_watcher, &QFutureWatcherBase::progressValueChanged, this, [this](int value) {
+        m_status->setText(tr("Computing... %1%").arg(value / 10));
+    });
+}
+
+ChecksumPanel::~ChecksumPanel()
+{
+    m_watcher.cancel();
+    m_watcher.waitForFinished();
+}
+
+void ChecksumPanel::setEditor(QHexEdit *editor)
+{
+    // The run is outdated, it must not outlive the connection stopping it
+    m_watcher.cancel();
+    m_watcher.waitForFinished();
+    if (m_editor)
+        disconnect(m_editor, nullptr, this, nullptr);
+    m_editor = editor;
+    if (m_editor) {
+        connect(m_editor, &QHexEdit::selectionChanged, this, &ChecksumPanel::scheduleUpdate);
+        connect(m_editor, &QHexEdit::dataChanged, this, &ChecksumPanel::scheduleUpdate);
+        connect(m_editor, &QHexEdit::dataAboutToBeReplaced, this, [this]() {
+            m_watcher.cancel();
+            m_watcher.waitForFinished();
+        });
+    }
+    scheduleUpdate();
+}
+
+void ChecksumPanel::scheduleUpdate()
+{
+    // Outdated as soon as anything changed, so stop at once and restart later
+    m_watcher.cancel();
+    m_delay.start();
+}
+
+void ChecksumPanel::startCompute()
+{
+    // A cancelled run stops at its next block, it must not outlive its chunks
+    m_watcher.cancel();
+    m_watcher.waitForFinished();
+
+    for (int idx = 0; idx < m_view->topLevelItemCount(); idx++)
+        m_view->topLevelItem(idx)->setText(1, QString());
+    m_computed = checkedAlgorithms();
+    if (!m_editor || m_computed.isEmpty()) {
+        m_status->setText(m_editor ? tr("No algorithm selected") : tr("No editor"));
+        return;
+    }
+
+    qint64 pos = 0;
+    qint64 count = m_editor->chunks()->size();
+    if (m_cmbScope->currentIndex() == 0) {
+        pos = m_editor->getSelectionBegin();
+        count = m_editor->getSelectionEnd() - pos;
+        if (count <= 0) {
+            m_status->setText(tr("No selection"));
+            return;
+        }
+    }
+
+    m_pos = pos + m_editor->addressOffset();
+    m_count = count;
+    Chunks *chunks = m_editor->chunks();
+    auto algorithms = m_computed;
+    m_status->setText(tr("Computing..."));
+    m_watcher.setFuture(QtConcurrent::run([chunks, pos, count, algorithms](QPromise<QVector<QByteArray>> &promise) {
+        promise.setProgressRange(0, 1000);
+        auto results = Checksum::compute(*chunks, pos, count, algorithms, [&promise, pos, count](qint64 reached) {
+            promise.setProgressValue((int)((reached - pos) * 1000 / count));
+            return !promise.isCanceled();
+        });
+        promise.addResult(results);
+    }));
+}
+
+void ChecksumPanel::computeFinished()
+{
+    if (m_watcher.isCanceled() || m_watcher.future().resultCount() == 0)
+        return;
+    auto results = m_watcher.result();
+    if (results.size() != m_computed.size())
+        return;
+
+    for (int idx = 0; idx < m_view->topLevelItemCount(); idx++) {
+        auto item = m_view->topLevelItem(idx);
+        int computed = m_computed.indexOf(Checksum::Algorithm(item->data(0, Qt::UserRole).toInt()));
+        item->setText(1, computed < 0 ? QString() : QString::fromLatin1(results.at(computed).toHex().toUpper()));
+    }
+    m_status->setText(m_cmbScope->currentIndex() == 0 ? tr("%1 bytes from %2").arg(m_count).arg(m_pos, 0, 16)
+                                                      : tr("%1 bytes, whole image").arg(m_count));
+}
+
+void ChecksumPanel::itemChanged(QTreeWidgetItem *item, int column)
+{
+    // Values are set in column 1, only check boxes change the selection
+    Q_UNUSED(item);
+    if (column != 0) return;
+
+    QStringList checked;
+    for (auto algorithm : checkedAlgorithms())
+        checked.append(Checksum::name(algorithm));
+    QSettings("RigoLigo", "PicoEaseUI").setValue("Checksums/Algorithms", checked);
+    scheduleUpdate();
+}
+
+QVector<Checksum::Algorithm> ChecksumPanel::checkedAlgorithms() const
+{
+    QVector<Checksum::Algorithm> algorithms;
+    for (int idx = 0; idx < m_view->topLevelItemCount(); idx++) {
+        auto item = m_view->topLevelItem(idx);
+        if (item->checkState(0) == Qt::Checked)
+            algorithms.append(Checksum::Algorithm(item->data(0, Qt::UserRole).toInt()));
+    }
+    return algorithms;
+}
@@ -0,0 +1,48 @@
+#ifndef CHECKSUMPANEL_H
+#define CHECKSUMPANEL_H
+
+#include <QWidget>
+#include <QFutureWatcher>
+#include <QPointer>
+#include <QTimer>
+#include "checksum.h"
+
+class QHexEdit;
+class QComboBox;
+class QLabel;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+// Computes checksums over the selection or the whole image of an editor, in
+// the background and again whenever the selection or the data changes
+class ChecksumPanel : public QWidget
+{
+    Q_OBJECT
+public:
+    ChecksumPanel(QWidget *parent = nullptr);
+    ~ChecksumPanel();
+
+    void setEditor(QHexEdit *editor); ///< Editor, whose data is checksummed
+
+private slots:
+    void scheduleUpdate();
+    void startCompute();
+    void computeFinished();
+    void itemChanged(QTreeWidgetItem *item, int column);
+
+private:
+    QVector<Checksum::Algorithm> checkedAlgorithms() const;
+
+    QPointer<QHexEdit> m_editor;
+    QFutureWatcher<QVector<QByteArray>> m_watcher;
+    QVector<Checksum::Algorithm> m_computed;  ///< Algorithms of the running computation
+    qint64 m_pos;                             ///< Address of the computed range
+    qint64 m_count;                           ///< Size of the computed range
+    QTimer m_delay;
+
+    QComboBox *m_cmbScope;
+    QLabel *m_status;
+    QTreeWidget *m_view;
+};
+
+#endif // CHECKSUMPANEL_H
@@ -0,0 +1,105 @@
+#include "flashprogrammer.h"
+#include "picoeasemodel.h"
+#include "chunks.h"
+#include <algorithm>
+
+FlashProgrammer::FlashProgrammer(PicoEaseModel *model, QObject *parent)
+    : QObject(parent), m_model(model), m_address(0), m_verifying(-1), m_readToken(0)
+{
+    connect(m_model, &PicoEaseModel::WriteRomFinished, this, &FlashProgrammer::writeFinished);
+    connect(m_model, &PicoEaseModel::MemoryReadFinished, this, &FlashProgrammer::readFinished);
+}
+
+QVector<QPair<qint64, qint64>> FlashProgrammer::pageRanges(const QVector<QPair<qint64, qint64>> &ranges,
+                                                           qint64 address, qint64 pageSize, qint64 size)
+{
+    QVector<QPair<qint64, qint64>> pages;
+    for (auto &&range : ranges) {
+        // Page boundaries are those of target addresses
+        qint64 first = (address + range.first) / pageSize * pageSize - address;
+        qint64 end = (address + range.first + range.second + pageSize - 1) / pageSize * pageSize - address;
+        first = std::max<qint64>(first, 0);
+        end = std::min(end, size);
+        if (first >= end) continue;
+        if (!pages.isEmpty() && first <= pages.last().first + pages.last().second)
+            pages.last().second = std::max(pages.last().second, end - pages.last().first);
+        else
+            pages.append({ first, end - first });
+    }
+    return pages;
+}
+
+bool FlashProgrammer::programChanges(Chunks *source, qint64 address, qint64 pageSize, int recordSize, int window)
+{
+    if (isRunning() || !source || pageSize <= 0) return false;
+
+    auto pages = pageRanges(source->changedRanges(), address, pageSize, source->size());
+    if (pages.isEmpty()) return false;
+    if (!m_model->IssueWriteRom(source, pages, address, recordSize, window)) return false;
+
+    m_source = source;
+    m_address = address;
+    m_ranges = pages;
+    m_verifying = -1;
+    return true;
+}
+
+void FlashProgrammer::writeFinished(bool ok)
+{
+    if (!isRunning() || m_verifying >= 0) return;
+    if (!ok) {
+        finish(false, tr("Programming failed, see the log."));
+        return;
+    }
+    m_verifying = 0;
+    verifyNext();
+}
+
+void FlashProgrammer::verifyNext()
+{
+    if (m_verifying >= m_ranges.size()) {
+        // The target holds these bytes now, they are not changed anymore
+        for (auto &&range : m_ranges)
+            m_source->setDataChanged(range.first, QByteArray(range.second, char(0)));
+        qint64 bytes = 0;
+        for (auto &&range : m_ranges)
+            bytes += range.second;
+        finish(true, tr("Programmed and verified %1 bytes in %2 ranges.").arg(bytes).arg(m_ranges.size()));
+        return;
+    }
+    auto &range = m_ranges.at(m_verifying);
+    m_readToken = m_model->RequestMemoryRead(m_address + range.first, range.second);
+}
+
+void FlashProgrammer::readFinished(quint64 token, qint64 address, QByteArray data)
+{
+    // Answers to other readers, e.g. a live view, have another token
+    if (!isRunning() || m_verifying < 0 || m_verifying >= m_ranges.size() || token != m_readToken) return;
+    auto &range = m_ranges.at(m_verifying);
+    if (data.size() < range.second) {
+        finish(false, data.isEmpty() ? tr("Reading back %1 failed.").arg(address, 0, 16)
+                                     : tr("Reading back %1 failed, %2 of %3 bytes read.")
+                                           .arg(address, 0, 16).arg(data.size()).arg(range.second));
+        return;
+    }
+
+    auto expected = m_source->data(range.first, range.second);
+    auto diff = std::mismatch(expected.cbegin(), expected.cend(), data.cbegin());
+    if (diff.first != expected.cend()) {
+        qint64 at = address + (diff.first - expected.cbegin());
+        finish(false, tr("Verify failed at %1: read %2, expected %3.")
+                          .arg(at, 0, 16).arg(uchar(*diff.second), 2, 16, QChar('0'))
+                          .arg(uchar(*diff.first), 2, 16, QChar('0')));
+        return;
+    }
+    m_verifying += 1;
+    verifyNext();
+}
+
+void FlashProgrammer::finish(bool ok, QString message)
+{
+    m_source.clear();
+    m_ranges.clear();
+    m_verifying = -1;
+    emit finished(ok, message);
+}
@@ -0,0 +1,48 @@
+#ifndef FLASHPROGRAMMER_H
+#define FLASHPROGRAMMER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+
+class Chunks;
+class PicoEaseModel;
+
+// Programs only the pages of an image, which hold changed (highlighted)
+// bytes, then reads these pages back from the target to verify them
+class FlashProgrammer : public QObject
+{
+    Q_OBJECT
+public:
+    FlashProgrammer(PicoEaseModel *model, QObject *parent = nullptr);
+
+    // Ranges of source positions rounded out to whole pages of the target,
+    // where position 0 is at address. Pages reaching past the source are cut.
+    static QVector<QPair<qint64, qint64>> pageRanges(const QVector<QPair<qint64, qint64>> &ranges,
+                                                     qint64 address, qint64 pageSize, qint64 size);
+
+    // source must stay unchanged until finished(). Returns false if nothing
+    // is changed or the write cannot be issued.
+    bool programChanges(Chunks *source, qint64 address, qint64 pageSize, int recordSize, int window);
+    bool isRunning() const { return !m_source.isNull(); }
+
+signals:
+    void finished(bool ok, QString message);
+
+private slots:
+    void writeFinished(bool ok);
+    void readFinished(quint64 token, qint64 address, QByteArray data);
+
+private:
+    void verifyNext();
+    void finish(bool ok, QString message);
+
+    PicoEaseModel *m_model;
+    QPointer<Chunks> m_source;
+    qint64 m_address;                             ///< Target address of source position 0
+    QVector<QPair<qint64, qint64>> m_ranges;      ///< Pages written, positions and lengths
+    int m_verifying;                              ///< Range being read back, -1 while writing
+    quint64 m_readToken;                          ///< Of the read of m_verifying
+};
+
+#endif // FLASHPROGRAMMER_H
@@ -0,0 +1,101 @@
+#include "gangdevice.h"
+#include "picoeasemodel.h"
+#include "bindiff.h"
+#include "checksum.h"
+#include <QSaveFile>
+#include <algorithm>
+#include <cstdlib>
+
+GangDevice::GangDevice(const GangJob &job)
+    : QObject(nullptr), m_job(job), m_model(nullptr), m_async(nullptr), m_done(false)
+{
+}
+
+void GangDevice::start()
+{
+    // Created in the thread of the device, the port lives there too
+    m_timer.start();
+    m_model = new PicoEaseModel(this);
+    connect(m_model, &PicoEaseModel::UpdateProgressBar, this, [this](bool, int value, int maximum) {
+        emit progress(value, maximum);
+    });
+    // Connected ahead of m_async, so a lost port ends the flow through finish()
+    connect(m_model, &PicoEaseModel::SerialPortUnexpectedDisconnection, this, &GangDevice::portLost);
+    m_async = new PicoEaseAsync(m_model, this);
+    run();
+}
+
+void GangDevice::cancel()
+{
+    finish(false, tr("Cancelled"));
+}
+
+PicoEaseFlow GangDevice::run()
+{
+    // Every command is issued as soon as the one before ended. finish()
+    // disconnects, which ends a command being awaited, so m_done is checked
+    // after each.
+    emit stepChanged(tr("Connecting"));
+    if (!m_model->ConnectPicoEaseSerialPort(m_job.portName)) {
+        finish(false, tr("Cannot open the port"));
+        co_return;
+    }
+    if (m_job.unlock) {
+        emit stepChanged(tr("Unlocking"));
+        bool unlocked = co_await m_async->unlock();
+        if (m_done) co_return;
+        if (!unlocked) {
+            finish(false, tr("Unlock failed"));
+            co_return;
+        }
+    }
+
+    emit stepChanged(tr("Dumping"));
+    m_model->SetDumpCacheTarget(m_job.cacheTarget);
+    QByteArrayView data = co_await m_async->readMemory(m_job.address, m_job.length);
+    if (m_done) co_return;
+
+    bool ok = data.size() == m_job.length;
+    quint32 crc = Checksum::crc32(0xffffffff, data.constData(), data.size()) ^ 0xffffffff;
+    QStringList result { tr("CRC-32 %1").arg(crc, 8, 16, QChar('0')).toUpper() };
+    if (!ok)
+        result << tr("%1 of %2 bytes read").arg(data.size()).arg(m_job.length);
+
+    if (!m_job.reference.isEmpty()) {
+        emit stepChanged(tr("Verifying"));
+        qint64 common = std::min<qint64>(data.size(), m_job.reference.size());
+        qint64 differing = std::abs(data.size() - m_job.reference.size());
+        for (auto &&run : BinDiff::changes(data.constData(), m_job.reference.constData(), common))
+            differing += run.second;
+        if (differing > 0) {
+            ok = false;
+            result << tr("%1 bytes differ").arg(differing);
+        } else {
+            result << tr("matches");
+        }
+    }
+
+    if (!m_job.dumpPath.isEmpty()) {
+        QSaveFile file(m_job.dumpPath);
+        if (!file.open(QIODevice::WriteOnly) || file.write(data.constData(), data.size()) != data.size() || !file.commit()) {
+            ok = false;
+            result << tr("cannot be saved");
+        }
+    }
+    finish(ok, result.join(", "));
+}
+
+void GangDevice::portLost()
+{
+    finish(false, tr("Serial port error"));
+}
+
+void GangDevice::finish(bool ok, QString result)
+{
+    if (m_done) return;
+    m_done = true;
+    if (m_model)
+        m_model->DisconnectPicoEaseSerialPort();
+    emit stepChanged(ok ? tr("Done") : tr("Failed"));
+    emit finished(ok, tr("%1 (%2 ms)").arg(result).arg(m_timer.elapsed()));
+}
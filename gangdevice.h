@@ -0,0 +1,54 @@
+#ifndef GANGDEVICE_H
+#define GANGDEVICE_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include "picoeaseasync.h"
+
+class PicoEaseModel;
+
+// What every device of a gang does: unlock, dump a range and compare it with
+// a reference
+struct GangJob
+{
+    QString portName;
+    bool unlock;
+    qint64 address;
+    qint64 length;
+    QString cacheTarget;                          ///< Target type of the page cache, empty if none
+    QByteArray reference;                         ///< Compared with the dump, not if empty
+    QString dumpPath;                             ///< Dump is saved here, not if empty
+};
+
+// Runs a GangJob on one PicoEASE. It is moved to a thread of its own, where
+// start() creates its model, so the port is served by that thread.
+class GangDevice : public QObject
+{
+    Q_OBJECT
+public:
+    GangDevice(const GangJob &job);
+
+public slots:
+    void start();
+    void cancel();
+
+signals:
+    void stepChanged(QString step);
+    void progress(int value, int maximum);
+    void finished(bool ok, QString result);
+
+private slots:
+    void portLost();
+
+private:
+    PicoEaseFlow run();
+    void finish(bool ok, QString result);
+
+    GangJob m_job;
+    PicoEaseModel *m_model;
+    PicoEaseAsync *m_async;
+    QElapsedTimer m_timer;
+    bool m_done;
+};
+
+#endif // GANGDEVICE_H
@@ -0,0 +1,249 @@
+#include "gangpanel.h"
+#include "gangdevice.h"
+#include "picoeasemodel.h"
+#include "hexvalidator.h"
+#include "qhexedit.h"
+#include <QCheckBox>
+#include <QDir>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QRegularExpression>
+#include <QSerialPortInfo>
+#include <QSettings>
+#include <QThread>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+#include <algorithm>
+
+GangPanel::GangPanel(QHexEdit *reference, QWidget *parent)
+    : QWidget(parent), m_reference(reference)
+{
+    QSettings settings("RigoLigo", "PicoEaseUI");
+    m_edtAddress = new QLineEdit(settings.value("Gang/Address", "0").toString(), this);
+    m_edtAddress->setValidator(new HexValidator(8, this));
+    m_edtAddress->setToolTip(tr("Address (hex)"));
+    m_edtLength = new QLineEdit(settings.value("Gang/Length", "4000").toString(), this);
+    m_edtLength->setValidator(new HexValidator(8, this));
+    m_edtLength->setToolTip(tr("Length (hex)"));
+    m_chkUnlock = new QCheckBox(tr("Unlock"), this);
+    m_chkUnlock->setChecked(settings.value("Gang/Unlock", false).toBool());
+    m_chkVerify = new QCheckBox(tr("Verify with File Content"), this);
+    m_chkVerify->setChecked(settings.value("Gang/Verify", true).toBool());
+    m_dumpDirectory = settings.value("Gang/DumpDirectory").toString();
+    m_btnDumpDirectory = new QPushButton(this);
+    auto btnRefresh = new QPushButton(tr("Refresh"), this);
+    m_btnRun = new QPushButton(tr("Run"), this);
+    m_btnCancel = new QPushButton(tr("Cancel"), this);
+    m_progress = new QProgressBar(this);
+    m_progress->setRange(0, 1000);
+    m_status = new QLabel(this);
+
+    m_view = new QTreeWidget(this);
+    m_view->setColumnCount(4);
+    m_view->setHeaderLabels({ tr("Port"), tr("Step"), tr("Progress"), tr("Result") });
+    m_view->setRootIsDecorated(false);
+    m_view->header()->setStretchLastSection(true);
+
+    auto range = new QHBoxLayout;
+    range->addWidget(m_edtAddress);
+    range->addWidget(m_edtLength);
+    range->addWidget(m_chkUnlock);
+    auto buttons = new QHBoxLayout;
+    buttons->addWidget(btnRefresh);
+    buttons->addStretch();
+    buttons->addWidget(m_btnRun);
+    buttons->addWidget(m_btnCancel);
+    auto layout = new QVBoxLayout(this);
+    layout->setContentsMargins(3, 3, 3, 3);
+    layout->addLayout(range);
+    layout->addWidget(m_chkVerify);
+    layout->addWidget(m_btnDumpDirectory);
+    layout->addWidget(m_view);
+    layout->addLayout(buttons);
+    layout->addWidget(m_progress);
+    layout->addWidget(m_status);
+
+    refreshPorts();
+    auto checked = settings.value("Gang/Ports").toStringList();
+    for (int row = 0; row < m_view->topLevelItemCount(); row++) {
+        auto item = m_view->topLevelItem(row);
+        item->setCheckState(0, checked.contains(item->data(0, Qt::UserRole).toString()) ? Qt::Checked : Qt::Unchecked);
+    }
+
+    connect(btnRefresh, &QPushButton::clicked, this, &GangPanel::refreshPorts);
+    connect(m_btnDumpDirectory, &QPushButton::clicked, this, &GangPanel::chooseDumpDirectory);
+    connect(m_btnRun, &QPushButton::clicked, this, &GangPanel::run);
+    connect(m_btnCancel, &QPushButton::clicked, this, &GangPanel::cancel);
+    updateState();
+}
+
+GangPanel::~GangPanel()
+{
+    QStringList checked;
+    for (int row = 0; row < m_view->topLevelItemCount(); row++) {
+        auto item = m_view->topLevelItem(row);
+        if (item->checkState(0) == Qt::Checked)
+            checked.append(item->data(0, Qt::UserRole).toString());
+    }
+    QSettings settings("RigoLigo", "PicoEaseUI");
+    settings.setValue("Gang/Ports", checked);
+    settings.setValue("Gang/Address", m_edtAddress->text());
+    settings.setValue("Gang/Length", m_edtLength->text());
+    settings.setValue("Gang/Unlock", m_chkUnlock->isChecked());
+    settings.setValue("Gang/Verify", m_chkVerify->isChecked());
+    settings.setValue("Gang/DumpDirectory", m_dumpDirectory);
+
+    // Devices close their ports in their own threads
+    for (auto &&device : m_devices) {
+        if (!device.thread) continue;
+        device.thread->quit();
+        device.thread->wait();
+    }
+}
+
+void GangPanel::refreshPorts()
+{
+    if (!m_devices.isEmpty()) return;
+
+    // Ports keep their check state, new ones are not checked
+    QStringList checked;
+    for (int row = 0; row < m_view->topLevelItemCount(); row++) {
+        auto item = m_view->topLevelItem(row);
+        if (item->checkState(0) == Qt::Checked)
+            checked.append(item->data(0, Qt::UserRole).toString());
+    }
+    m_view->clear();
+    QList<QPair<QString, QString>> ports;
+    for (auto &&info : QSerialPortInfo::availablePorts())
+        ports.append({ info.portName() + ": " + info.description(), info.portName() });
+    ports.append({ tr("Emulator"), PicoEaseModel::EmulatorPortName });
+    for (auto &&port : ports) {
+        auto item = new QTreeWidgetItem(m_view, { port.first });
+        item->setData(0, Qt::UserRole, port.second);
+        item->setCheckState(0, checked.contains(port.second) ? Qt::Checked : Qt::Unchecked);
+    }
+    m_view->resizeColumnToContents(0);
+}
+
+void GangPanel::chooseDumpDirectory()
+{
+    // Cancelling the dialog stops saving dumps
+    m_dumpDirectory = QFileDialog::getExistingDirectory(this, tr("Save dumps to"), m_dumpDirectory);
+    updateState();
+}
+
+void GangPanel::run()
+{
+    if (!m_devices.isEmpty()) return;
+    qint64 address = m_edtAddress->text().toLongLong(nullptr, 16);
+    qint64 length = m_edtLength->text().toLongLong(nullptr, 16);
+    if (length <= 0) return;
+
+    // Every device gets its copy of the job, the reference is shared
+    GangJob job { QString(), m_chkUnlock->isChecked(), address, length, m_cacheTarget, QByteArray(), QString() };
+    if (m_chkVerify->isChecked())
+        job.reference = m_reference->chunks()->data(0, length);
+
+    for (int row = 0; row < m_view->topLevelItemCount(); row++) {
+        auto item = m_view->topLevelItem(row);
+        for (int column = 1; column < m_view->columnCount(); column++)
+            item->setText(column, QString());
+        if (item->checkState(0) != Qt::Checked) continue;
+
+        job.portName = item->data(0, Qt::UserRole).toString();
+        if (!m_dumpDirectory.isEmpty()) {
+            QString name = job.portName;
+            name.replace(QRegularExpression("[^A-Za-z0-9_.-]"), "_");
+            job.dumpPath = QDir(m_dumpDirectory).filePath(name + ".bin");
+        }
+
+        int idx = m_devices.size();
+        auto device = new GangDevice(job);
+        auto thread = new QThread(this);
+        device->moveToThread(thread);
+        m_devices.append(Device { row, device, thread, 0, 1, false, false });
+        connect(thread, &QThread::started, device, &GangDevice::start);
+        connect(device, &GangDevice::finished, thread, &QThread::quit, Qt::DirectConnection);
+        connect(thread, &QThread::finished, device, &QObject::deleteLater);
+        connect(device, &GangDevice::stepChanged, this, [this, row](QString step) {
+            m_view->topLevelItem(row)->setText(1, step);
+        });
+        connect(device, &GangDevice::progress, this, [this, idx](int value, int maximum) {
+            m_devices[idx].value = value;
+            m_devices[idx].maximum = std::max(maximum, 1);
+            updateProgress();
+        });
+        connect(device, &GangDevice::finished, this, [this, idx](bool ok, QString result) {
+            deviceFinished(idx, ok, result);
+        });
+    }
+    if (m_devices.isEmpty()) {
+        m_status->setText(tr("No port checked"));
+        return;
+    }
+
+    m_timer.start();
+    m_status->setText(tr("Running on %n device(s)", nullptr, m_devices.size()));
+    updateProgress();
+    updateState();
+    for (auto &&device : m_devices)
+        device.thread->start();
+}
+
+void GangPanel::cancel()
+{
+    for (auto &&device : m_devices) {
+        if (device.device)
+            QMetaObject::invokeMethod(device.device.data(), &GangDevice::cancel);
+    }
+}
+
+void GangPanel::deviceFinished(int idx, bool ok, QString result)
+{
+    auto &device = m_devices[idx];
+    device.finished = true;
+    device.ok = ok;
+    device.value = device.maximum;
+    m_view->topLevelItem(device.row)->setText(3, result);
+    updateProgress();
+    for (auto &&other : m_devices) {
+        if (!other.finished) return;
+    }
+
+    // The threads are done, their devices deleted
+    int succeeded = 0;
+    for (auto &&other : m_devices) {
+        succeeded += other.ok ? 1 : 0;
+        other.thread->wait();
+        delete other.thread;
+    }
+    m_status->setText(tr("%1 of %2 devices OK in %3 ms").arg(succeeded).arg(m_devices.size()).arg(m_timer.elapsed()));
+    m_devices.clear();
+    updateState();
+}
+
+void GangPanel::updateProgress()
+{
+    // The gang is as far as its devices on average
+    double done = 0;
+    for (auto &&device : m_devices) {
+        double fraction = std::min(1.0, double(device.value) / device.maximum);
+        done += fraction;
+        m_view->topLevelItem(device.row)->setText(2, QString("%1 %").arg(int(fraction * 100)));
+    }
+    m_progress->setValue(m_devices.isEmpty() ? 0 : int(done * 1000 / m_devices.size()));
+}
+
+void GangPanel::updateState()
+{
+    bool running = !m_devices.isEmpty();
+    m_btnRun->setEnabled(!running);
+    m_btnCancel->setEnabled(running);
+    m_btnDumpDirectory->setText(m_dumpDirectory.isEmpty() ? tr("Dumps are not saved")
+                                                          : tr("Save dumps to %1").arg(m_dumpDirectory));
+}
@@ -0,0 +1,70 @@
+#ifndef GANGPANEL_H
+#define GANGPANEL_H
+
+#include <QWidget>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QVector>
+
+class GangDevice;
+class QCheckBox;
+class QHexEdit;
+class QLabel;
+class QLineEdit;
+class QProgressBar;
+class QPushButton;
+class QThread;
+class QTreeWidget;
+
+// Runs the same unlock, dump and verify on several PicoEASEs at once, every
+// one with its own model on its own thread, so a gang takes about as long as
+// its slowest device
+class GangPanel : public QWidget
+{
+    Q_OBJECT
+public:
+    GangPanel(QHexEdit *reference, QWidget *parent = nullptr);
+    ~GangPanel();
+
+    void setCacheTarget(QString target) { m_cacheTarget = target; } ///< Target type of the page cache
+
+private slots:
+    void refreshPorts();
+    void chooseDumpDirectory();
+    void run();
+    void cancel();
+
+private:
+    struct Device {
+        int row;                                  ///< Item in m_view
+        QPointer<GangDevice> device;
+        QPointer<QThread> thread;
+        int value;
+        int maximum;
+        bool finished;
+        bool ok;
+    };
+
+    void deviceFinished(int idx, bool ok, QString result);
+    void updateProgress();
+    void updateState();
+
+    QHexEdit *m_reference;
+    QString m_cacheTarget;
+    QString m_dumpDirectory;
+    QVector<Device> m_devices;                    ///< Of the running gang
+    QElapsedTimer m_timer;
+
+    QLineEdit *m_edtAddress;
+    QLineEdit *m_edtLength;
+    QCheckBox *m_chkUnlock;
+    QCheckBox *m_chkVerify;
+    QPushButton *m_btnDumpDirectory;
+    QPushButton *m_btnRun;
+    QPushButton *m_btnCancel;
+    QProgressBar *m_progress;
+    QLabel *m_status;
+    QTreeWidget *m_view;
+};
+
+#endif // GANGPANEL_H
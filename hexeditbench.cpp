@@ -0,0 +1,78 @@
+// Measures the paint time of QHexEdit at several window sizes, once repainting
+// the rows shown and once scrolling a page per frame, so no row is cached.
+// Runs on the offscreen platform unless QT_QPA_PLATFORM says otherwise.
+
+#include "qhexedit.h"
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <algorithm>
+
+struct FrameTimes
+{
+    qint64 median;                              // us
+    qint64 worst;
+};
+
+static FrameTimes measure(QHexEdit &edit, int frames, bool scroll)
+{
+    QVector<qint64> times;
+    QElapsedTimer timer;
+    qint64 line = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        if (scroll) {
+            line += edit.viewport()->height() / std::max(1, edit.fontMetrics().height());
+            edit.scrollToLine(line);
+        }
+        timer.start();
+        edit.viewport()->repaint();
+        times.append(timer.nsecsElapsed() / 1000);
+    }
+    std::sort(times.begin(), times.end());
+    return { times.at(times.size() / 2), times.last() };
+}
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Prints the paint times of QHexEdit at several window sizes.");
+    parser.addHelpOption();
+    QCommandLineOption framesOption("frames", "Frames per window size and mode.", "count", "200");
+    QCommandLineOption sizeOption("size", "Bytes shown (hex), 1 MiB by default.", "size", "100000");
+    parser.addOptions({ framesOption, sizeOption });
+    parser.process(app);
+    int frames = std::max(1, parser.value(framesOption).toInt());
+
+    // Random bytes, so every glyph and color is drawn
+    QByteArray data(parser.value(sizeOption).toLongLong(nullptr, 16), Qt::Uninitialized);
+    QRandomGenerator random(1);
+    for (auto &byte : data)
+        byte = char(random.bounded(256));
+
+    QHexEdit edit;
+    edit.setData(data);
+    edit.show();
+
+    QTextStream out(stdout);
+    out << "window      rows  static median/worst us  scroll median/worst us" << Qt::endl;
+    for (QSize size : { QSize(640, 480), QSize(1280, 800), QSize(1920, 1080), QSize(2560, 1440), QSize(3840, 2160) }) {
+        edit.resize(size);
+        edit.scrollToLine(0);
+        app.processEvents();
+        edit.viewport()->repaint(); // glyph atlases are built by the first frame
+
+        auto still = measure(edit, frames, false);
+        auto scrolled = measure(edit, frames, true);
+        out << QString("%1x%2").arg(size.width()).arg(size.height()).leftJustified(12)
+            << QString::number(edit.viewport()->height() / std::max(1, edit.fontMetrics().height())).rightJustified(4)
+            << QString("%1 / %2").arg(still.median).arg(still.worst).rightJustified(24)
+            << QString("%1 / %2").arg(scrolled.median).arg(scrolled.worst).rightJustified(24) << Qt::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include "imageverifier.h"
+#include "picoeasemodel.h"
+#include "chunks.h"
+#include "checksum.h"
+#include "bindiff.h"
+#include <QtConcurrent>
+
+ImageVerifier::ImageVerifier(PicoEaseModel *model, QObject *parent)
+    : QObject(parent), m_model(model), m_address(0), m_blockSize(0), m_localDone(false), m_deviceDone(false), m_reading(-1), m_readToken(0)
+{
+    connect(&m_watcher, &QFutureWatcher<quint32>::finished, this, &ImageVerifier::localFinished);
+    connect(m_model, &PicoEaseModel::BlockCrcFinished, this, &ImageVerifier::deviceFinished);
+    connect(m_model, &PicoEaseModel::MemoryReadFinished, this, &ImageVerifier::readFinished);
+}
+
+bool ImageVerifier::verify(Chunks *image, qint64 address, qint64 blockSize)
+{
+    if (isRunning() || m_watcher.isRunning() || !image || blockSize <= 0) return false;
+    qint64 size = image->size();
+    if (size <= 0) return false;
+
+    m_image = image;
+    m_address = address;
+    m_blockSize = blockSize;
+    m_deviceCrcs.clear();
+    m_localDone = false;
+    m_deviceDone = false;
+    m_reads.clear();
+    m_reading = -1;
+    m_differences.clear();
+
+    // PicoEASE and the local threads compute their CRCs at the same time
+    QList<QPair<qint64, qint64>> blocks;
+    for (qint64 pos = 0; pos < size; pos += blockSize)
+        blocks.append(qMakePair(pos, std::min(blockSize, size - pos)));
+    m_watcher.setFuture(QtConcurrent::mapped(blocks, [image](const QPair<qint64, qint64> &block) {
+        auto data = image->data(block.first, block.second);
+        return Checksum::crc32(0xffffffff, data.constData(), data.size()) ^ 0xffffffff;
+    }));
+    if (!m_model->IssueBulkCommand(PicoEaseModel::BCBlockCrc, { {"offset", QString::number(address, 16)},
+                                                                 {"length", QString::number(size, 16)},
+                                                                 {"block", QString::number(blockSize, 16)} })) {
+        m_watcher.cancel();
+        m_image.clear();
+        return false;
+    }
+    return true;
+}
+
+void ImageVerifier::cancel()
+{
+    if (!isRunning()) return;
+    // The local threads read the image, which may change after finished()
+    m_watcher.cancel();
+    m_watcher.waitForFinished();
+    finish(false, tr("Verify canceled."));
+}
+
+void ImageVerifier::localFinished()
+{
+    m_localDone = true;
+    if (isRunning() && m_deviceDone)
+        compareBlocks();
+}
+
+void ImageVerifier::deviceFinished(qint64 address, qint64 blockSize, QVector<quint32> crcs)
+{
+    if (!isRunning() || m_deviceDone || address != m_address || blockSize != m_blockSize) return;
+    m_deviceCrcs = crcs;
+    m_deviceDone = true;
+    // Not m_watcher.isRunning(), which turns false before localFinished()
+    // comes, which would compare the blocks a second time
+    if (m_localDone)
+        compareBlocks();
+}
+
+void ImageVerifier::compareBlocks()
+{
+    // Without CRCs of PicoEASE every block is read back, runs of differing
+    // blocks in one read each
+    auto local = m_watcher.future().results();
+    qint64 size = m_image->size();
+    for (int idx = 0; idx < local.size(); idx++) {
+        if (idx < m_deviceCrcs.size() && m_deviceCrcs.at(idx) == local.at(idx)) continue;
+        qint64 pos = idx * m_blockSize;
+        qint64 length = std::min(m_blockSize, size - pos);
+        if (!m_reads.isEmpty() && m_reads.last().first + m_reads.last().second == pos)
+            m_reads.last().second += length;
+        else
+            m_reads.append(qMakePair(pos, length));
+    }
+    m_reading = 0;
+    readNext();
+}
+
+void ImageVerifier::readNext()
+{
+    if (m_reading >= m_reads.size()) {
+        if (m_differences.isEmpty()) {
+            finish(true, m_reads.isEmpty() ? tr("Target memory matches, all block CRCs are equal.")
+                                           : tr("Target memory matches."));
+        } else {
+            qint64 bytes = 0;
+            for (auto &&run : m_differences)
+                bytes += run.second;
+            finish(false, tr("%1 bytes in %2 ranges differ from the image.").arg(bytes).arg(m_differences.size()));
+        }
+        return;
+    }
+    auto &read = m_reads.at(m_reading);
+    m_readToken = m_model->RequestMemoryRead(m_address + read.first, read.second);
+}
+
+void ImageVerifier::readFinished(quint64 token, qint64 address, QByteArray data)
+{
+    // Answers to other readers, e.g. a live view, have another token
+    if (!isRunning() || m_reading < 0 || m_reading >= m_reads.size() || token != m_readToken) return;
+    auto &read = m_reads.at(m_reading);
+    if (data.size() < read.second) {
+        finish(false, data.isEmpty() ? tr("Reading back %1 failed.").arg(address, 0, 16)
+                                     : tr("Reading back %1 failed, %2 of %3 bytes read.")
+                                           .arg(address, 0, 16).arg(data.size()).arg(read.second));
+        return;
+    }
+
+    auto expected = m_image->data(read.first, read.second);
+    for (auto &&run : BinDiff::changes(expected.constData(), data.constData(), expected.size()))
+        m_differences.append(qMakePair(read.first + run.first, run.second));
+    m_reading += 1;
+    readNext();
+}
+
+void ImageVerifier::finish(bool ok, QString message)
+{
+    m_image.clear();
+    m_reading = -1;
+    emit finished(ok, message, m_differences);
+}
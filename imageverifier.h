@@ -0,0 +1,56 @@
+#ifndef IMAGEVERIFIER_H
+#define IMAGEVERIFIER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+#include <QFutureWatcher>
+
+class Chunks;
+class PicoEaseModel;
+
+// Verifies target memory against an image by comparing CRC-32s of blocks,
+// computed by PicoEASE and locally in parallel. Only blocks which differ are
+// read back and compared byte by byte. If PicoEASE cannot compute them, all
+// of the range is read back.
+class ImageVerifier : public QObject
+{
+    Q_OBJECT
+public:
+    ImageVerifier(PicoEaseModel *model, QObject *parent = nullptr);
+
+    // image must stay unchanged until finished()
+    bool verify(Chunks *image, qint64 address, qint64 blockSize);
+    // Ends a verify with finished(false), answers of PicoEASE still due are ignored
+    void cancel();
+    bool isRunning() const { return !m_image.isNull(); }
+
+signals:
+    // differences are positions and lengths in the image
+    void finished(bool ok, QString message, QVector<QPair<qint64, qint64>> differences);
+
+private slots:
+    void localFinished();
+    void deviceFinished(qint64 address, qint64 blockSize, QVector<quint32> crcs);
+    void readFinished(quint64 token, qint64 address, QByteArray data);
+
+private:
+    void compareBlocks();
+    void readNext();
+    void finish(bool ok, QString message);
+
+    PicoEaseModel *m_model;
+    QPointer<Chunks> m_image;
+    qint64 m_address;                             ///< Target address of image position 0
+    qint64 m_blockSize;
+    QFutureWatcher<quint32> m_watcher;            ///< Local CRCs, one per block
+    QVector<quint32> m_deviceCrcs;
+    bool m_localDone;                             ///< finished() of m_watcher arrived
+    bool m_deviceDone;
+    QVector<QPair<qint64, qint64>> m_reads;       ///< Runs of differing blocks to read back
+    int m_reading;                                ///< Index in m_reads, -1 while checking
+    quint64 m_readToken;                          ///< Of the read of m_reading
+    QVector<QPair<qint64, qint64>> m_differences;
+};
+
+#endif // IMAGEVERIFIER_H
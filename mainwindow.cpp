@@ -1,15 +1,27 @@
 
 #include <QSerialPortInfo>
+#include <QDockWidget>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QMessageBox>
+#include <QProgressDialog>
+#include <QtConcurrent>
 #include "picoeasemodel.h"
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
 #include "hexvalidator.h"
+#include "signaturepanel.h"
+#include "checksumpanel.h"
+#include "stringspanel.h"
+#include "watchpanel.h"
+#include "gangpanel.h"
+#include "flashprogrammer.h"
+#include "imageverifier.h"
+#include "scriptrunner.h"
 
 MainWindow::MainWindow(PicoEaseModel *model, QWidget *parent)
     : QMainWindow(parent)
-    , settings("RigoLigo", "PicoEaseUI"), ui(new Ui::MainWindow)
+    , settings("RigoLigo", "PicoEaseUI"), ui(new Ui::MainWindow), searchEditor(nullptr), diffSyncing(false), diffShown(-1)
 {
     this->model = model;
 
@@ -30,7 +42,7 @@ MainWindow::MainWindow(PicoEaseModel *model, QWidget *parent)
     ui->splitter->setStretchFactor(1, 0);
 
     // Initialize log view, model, etc
-    ui->lstCommandLog->setModel(model->LogModel());
+    ui->lstCommandLog->setModel(&logModel);
 
     // Model communications
     connect(model, &PicoEaseModel::SerialPortUnexpectedDisconnection, this, &MainWindow::modelSerialPortUnexpectedDisconnection);
@@ -38,15 +50,68 @@ MainWindow::MainWindow(PicoEaseModel *model, QWidget *parent)
     connect(model, &PicoEaseModel::BulkCommandLockUi, this, &MainWindow::modelBulkCommandLockUi);
     connect(model, &PicoEaseModel::UpdateProgressBar, this, &MainWindow::modelUpdateProgressBar);
     connect(model, &PicoEaseModel::UpdateProgressMessage, this, &MainWindow::modelUpdateProgressMessage);
-    connect(model, &PicoEaseModel::LogViewAutoscroll, this, &MainWindow::modelLogViewAutoscroll);
+    connect(model, &PicoEaseModel::LogAppended, this, &MainWindow::modelLogAppended);
 
     connect(model, &PicoEaseModel::UpdateDumpContentToUi, this, &MainWindow::modelUpdateDumpContent);
+    programmer = new FlashProgrammer(model, this);
+    connect(programmer, &FlashProgrammer::finished, this, &MainWindow::programmerFinished);
+    verifier = new ImageVerifier(model, this);
+    // Queued, a verify canceled by setData() of the file editor does not show
+    // its message box in the middle of it
+    connect(verifier, &ImageVerifier::finished, this, &MainWindow::verifierFinished, Qt::QueuedConnection);
+    connect(ui->hexFileContent, &QHexEdit::dataAboutToBeReplaced, verifier, &ImageVerifier::cancel);
+    scriptRunner = new ScriptRunner(model, this);
+    connect(scriptRunner, &ScriptRunner::stepStarted, this, [this]() {
+        ui->grpActions->setEnabled(false);
+    });
+    connect(scriptRunner, &ScriptRunner::stepFinished, this, &MainWindow::scriptStepFinished);
+    connect(scriptRunner, &ScriptRunner::finished, this, &MainWindow::scriptFinished);
 
     // Set properties for editors
     ui->hexDumpContent->setReadOnly(true);
 
+    // Editors keep block hashes for image digests, background search may run in any of them
+    for (auto editor : { ui->hexDumpContent, ui->hexFileContent, ui->hexScratchpad }) {
+        editor->chunks()->setMerkleTreeEnabled(true);
+        connect(editor, &QHexEdit::searchProgress, this, &MainWindow::hexEditSearchProgress);
+        connect(editor, &QHexEdit::searchFinished, this, &MainWindow::hexEditSearchFinished);
+    }
+
+    // Compare mode, redone shortly after either side changed
+    diffDelay.setSingleShot(true);
+    diffDelay.setInterval(300);
+    connect(&diffDelay, &QTimer::timeout, this, &MainWindow::startDiff);
+    connect(&diffWatcher, &QFutureWatcherBase::finished, this, &MainWindow::diffFinished);
+    connect(&diffWatcher, &QFutureWatcherBase::progressValueChanged, this, &MainWindow::hexEditSearchProgress);
+    for (auto editor : { ui->hexDumpContent, ui->hexFileContent }) {
+        connect(editor, &QHexEdit::dataChanged, this, [this]() {
+            if (ui->actionCompare->isChecked()) diffDelay.start();
+        });
+        connect(editor, &QHexEdit::topLineChanged, this, &MainWindow::diffEditorScrolled);
+    }
+
+    // Tool panels work on the editor in the current tab
+    signaturePanel = new SignaturePanel(this);
+    addToolDock(signaturePanel, tr("Signatures"));
+    connect(signaturePanel, &SignaturePanel::hitActivated, this, &MainWindow::showEditorRange);
+    checksumPanel = new ChecksumPanel(this);
+    addToolDock(checksumPanel, tr("Checksums"));
+    stringsPanel = new StringsPanel(this);
+    addToolDock(stringsPanel, tr("Strings"));
+    connect(stringsPanel, &StringsPanel::stringActivated, this, &MainWindow::showEditorRange);
+    watchPanel = new WatchPanel(model, this);
+    addToolDock(watchPanel, tr("Watch"));
+    gangPanel = new GangPanel(ui->hexFileContent, this);
+    addToolDock(gangPanel, tr("Gang"));
+    connect(ui->edtTargetId, &QLineEdit::textChanged, this, [this](const QString &text) {
+        gangPanel->setCacheTarget(text.trimmed());
+    });
+    connect(ui->tabEditors, &QTabWidget::currentChanged, this, &MainWindow::editorTabChanged);
+    editorTabChanged();
+
     // Address selector constraints
     ui->edtMemRangeBegin->setValidator(new HexValidator(8, this));
+    ui->edtPageSize->setValidator(new HexValidator(8, this));
     ui->cmbMemRangeLength->setValidator(new HexValidator(8, this));
 
     // Final initializations
@@ -57,6 +122,12 @@ MainWindow::MainWindow(PicoEaseModel *model, QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    // The editors and their chunks are destroyed before the panels and the
+    // verifier, whose threads read them. The panels stop theirs when the
+    // editors are destroyed, the verifier is stopped here.
+    cancelDiff();
+    disconnect(verifier, nullptr, this, nullptr);
+    verifier->cancel();
     delete ui;
 }
 
@@ -85,12 +156,25 @@ void MainWindow::refreshSerialPorts()
             ui->cmbSerialPortSelection->setCurrentIndex(ui->cmbSerialPortSelection->count() - 1);
         }
     }
+
+    // Commands can be tried without a PicoEASE
+    ui->cmbSerialPortSelection->addItem(tr("Emulator"), PicoEaseModel::EmulatorPortName);
+    if (currentPortText == tr("Emulator")) {
+        ui->cmbSerialPortSelection->setCurrentIndex(ui->cmbSerialPortSelection->count() - 1);
+    }
 }
 
 void MainWindow::issueManualCommand()
 {
-    ui->edtCommand->setEnabled(false); // Awaits command finishing
-    model->SendPicoEaseCommand(ui->edtCommand->text() + '\n');
+    // Commands typed while others run are queued behind them, script lines
+    // such as dump or repeat work here too
+    if (!ui->btnConnectSerialPort->isChecked()) return;
+    QString error;
+    scriptRunner->setWriteParameters(ui->spnWriteRecordSize->value(), settings.value("Target/WriteWindow", 8).toInt());
+    if (!scriptRunner->enqueue(ui->edtCommand->text(), &error)) {
+        modelLogAppended(error, PicoEaseModel::System);
+        return;
+    }
     ui->edtCommand->clear();
 }
 
@@ -108,6 +192,37 @@ bool MainWindow::commonSaveBinary(QString filePath, QByteArrayView binaryData)
     return true;
 }
 
+QHexEdit *MainWindow::currentEditor()
+{
+    return qobject_cast<QHexEdit*>(ui->tabEditors->currentWidget());
+}
+
+void MainWindow::addToolDock(QWidget *panel, QString title)
+{
+    auto dock = new QDockWidget(title, this);
+    dock->setObjectName(title);
+    dock->setWidget(panel);
+    addDockWidget(Qt::RightDockWidgetArea, dock);
+    dock->hide();
+    ui->menuView->addAction(dock->toggleViewAction());
+}
+
+void MainWindow::startSearch(qint64 from)
+{
+    if (searchEditor)
+        searchEditor->cancelSearch();
+
+    searchEditor = currentEditor();
+    if (!searchEditor) return;
+
+    searchEditor->startSearch(searchPattern, from);
+    ui->actionCancelSearch->setEnabled(true);
+    uiOperatingMessage->setText(tr("Searching for %1").arg(searchPattern.pattern()));
+    uiOperationProgress->setVisible(true);
+    uiOperationProgress->setMaximum(1000);
+    uiOperationProgress->setValue(0);
+}
+
 void MainWindow::on_btnConnectSerialPort_clicked(bool checked)
 {
     if (checked) {
@@ -122,6 +237,7 @@ void MainWindow::on_btnConnectSerialPort_clicked(bool checked)
 
     } else {
         // Disconnect
+        scriptRunner->stop();
         model->DisconnectPicoEaseSerialPort();
         setUiConnectedState(false);
     }
@@ -135,6 +251,7 @@ void MainWindow::on_btnCommandExec_clicked()
 
 void MainWindow::on_btnReadTargetMemory_clicked()
 {
+    model->SetDumpCacheTarget(ui->edtTargetId->text().trimmed());
     model->IssueBulkCommand(
         PicoEaseModel::BCDumpRom,
         {
@@ -143,6 +260,175 @@ void MainWindow::on_btnReadTargetMemory_clicked()
         });
 }
 
+void MainWindow::on_btnBrowseTargetMemory_clicked()
+{
+    auto address = ui->edtMemRangeBegin->text().toLongLong(nullptr, 16);
+    auto length = ui->cmbMemRangeLength->currentText().toLongLong(nullptr, 16);
+    if (length <= 0) return;
+
+    // Pages are requested from within reads, so the device is connected queued
+    QSharedPointer<PagedDevice> memory(new PagedDevice(address, length));
+    connect(memory.data(), &PagedDevice::readRequested, model, &PicoEaseModel::RequestMemoryRead, Qt::QueuedConnection);
+    connect(memory.data(), &PagedDevice::pagesChanged, ui->hexDumpContent, &QHexEdit::reload, Qt::QueuedConnection);
+    // Pages are told by their address, the device does not keep tokens
+    connect(model, &PicoEaseModel::MemoryReadFinished, memory.data(), [device = memory.data()](quint64, qint64 address, QByteArray data) {
+        device->readFinished(address, data);
+    });
+
+    cancelDiff(); // the compare must not read the device being replaced
+    ui->hexDumpContent->setData(*memory);
+    ui->hexDumpContent->setAddressOffset(address);
+    ui->tabEditors->setCurrentWidget(ui->hexDumpContent);
+    liveMemory = memory;
+    dumpImage.reset();
+}
+
+void MainWindow::on_btnWriteTargetMemory_clicked()
+{
+    auto editor = currentEditor();
+    if (!editor) return;
+    qint64 pos = editor->getSelectionBegin();
+    qint64 length = editor->getSelectionEnd() - pos;
+    if (length <= 0) {
+        pos = 0;
+        length = editor->chunks()->size();
+    }
+    if (length <= 0) return;
+
+    auto address = ui->edtMemRangeBegin->text().toLongLong(nullptr, 16);
+    auto answer = QMessageBox::question(
+        this, tr("Write memory"),
+        tr("Write %1 bytes to target memory at %2?").arg(length).arg(address, 0, 16));
+    if (answer != QMessageBox::Yes) return;
+
+    // The source must not change while it is sent
+    bool readOnly = editor->isReadOnly();
+    editor->setReadOnly(true);
+    if (!model->IssueWriteRom(editor->chunks(), pos, length, address, ui->spnWriteRecordSize->value(),
+                              settings.value("Target/WriteWindow", 8).toInt())) {
+        editor->setReadOnly(readOnly);
+        return;
+    }
+    connect(model, &PicoEaseModel::WriteRomFinished, editor, [editor, readOnly]() {
+        editor->setReadOnly(readOnly);
+    }, Qt::SingleShotConnection);
+}
+
+void MainWindow::on_btnWriteChanges_clicked()
+{
+    auto editor = currentEditor();
+    if (!editor) return;
+    auto address = ui->edtMemRangeBegin->text().toLongLong(nullptr, 16);
+    auto pageSize = ui->edtPageSize->text().toLongLong(nullptr, 16);
+    if (pageSize <= 0) return;
+
+    auto answer = QMessageBox::question(
+        this, tr("Write changes"),
+        tr("Write the pages with changed bytes to target memory at %1 and verify them?").arg(address, 0, 16));
+    if (answer != QMessageBox::Yes) return;
+
+    // The source must not change until it is verified
+    bool readOnly = editor->isReadOnly();
+    editor->setReadOnly(true);
+    if (!programmer->programChanges(editor->chunks(), address, pageSize, ui->spnWriteRecordSize->value(),
+                                    settings.value("Target/WriteWindow", 8).toInt())) {
+        editor->setReadOnly(readOnly);
+        uiOperatingMessage->setText(tr("No changed bytes to write"));
+        return;
+    }
+    connect(programmer, &FlashProgrammer::finished, editor, [editor, readOnly]() {
+        editor->setReadOnly(readOnly);
+    }, Qt::SingleShotConnection);
+}
+
+void MainWindow::programmerFinished(bool ok, QString message)
+{
+    if (ok) {
+        uiOperatingMessage->setText(message);
+    } else {
+        QMessageBox::critical(this, tr("Write changes"), message);
+    }
+}
+
+void MainWindow::on_btnVerifyFile_clicked()
+{
+    // The button cancels the verify running
+    if (verifier->isRunning()) {
+        verifier->cancel();
+        return;
+    }
+    auto address = ui->edtMemRangeBegin->text().toLongLong(nullptr, 16);
+    auto blockSize = ui->edtPageSize->text().toLongLong(nullptr, 16);
+
+    // The image must not change until it is verified
+    auto editor = ui->hexFileContent;
+    bool readOnly = editor->isReadOnly();
+    editor->setReadOnly(true);
+    editor->setMarkedRanges({});
+    if (!verifier->verify(editor->chunks(), address, blockSize)) {
+        editor->setReadOnly(readOnly);
+        return;
+    }
+    ui->btnVerifyFile->setText(tr("Cancel Verify"));
+    connect(verifier, &ImageVerifier::finished, editor, [editor, readOnly]() {
+        editor->setReadOnly(readOnly);
+    }, Qt::SingleShotConnection);
+}
+
+void MainWindow::verifierFinished(bool ok, QString message, QVector<QPair<qint64, qint64>> differences)
+{
+    ui->btnVerifyFile->setText(tr("Verify File"));
+    ui->hexFileContent->setMarkedRanges(differences);
+    if (!differences.isEmpty()) {
+        showEditorRange(ui->hexFileContent, differences.first().first, differences.first().second);
+    }
+    if (ok) {
+        uiOperatingMessage->setText(message);
+    } else {
+        QMessageBox::warning(this, tr("Verify file"), message);
+    }
+}
+
+void MainWindow::on_actionRunScript_triggered()
+{
+    auto path = settings.value("DialogPath/Script").toString();
+    auto openPath = QFileDialog::getOpenFileName(this, tr("Run script"), path, tr("Scripts (*.txt);;All files (*)"));
+    if (openPath.isEmpty()) return;
+    settings.setValue("DialogPath/Script", QFileInfo(openPath).dir().path());
+
+    QFile f(openPath);
+    if (!f.open(QFile::ReadOnly | QFile::Text)) {
+        QMessageBox::critical(this, tr("Run script"), tr("Selected file cannot be opened."));
+        return;
+    }
+    QString error;
+    scriptRunner->setWriteParameters(ui->spnWriteRecordSize->value(), settings.value("Target/WriteWindow", 8).toInt());
+    if (!scriptRunner->enqueue(QString::fromUtf8(f.readAll()), &error)) {
+        QMessageBox::warning(this, tr("Run script"), error);
+    }
+}
+
+void MainWindow::scriptStepFinished(QString step, bool ok, QString result, qint64 ms)
+{
+    // Timed from issuing the step to its last answer
+    if (ok) {
+        modelLogAppended(tr("%1: %2 ms%3").arg(step).arg(ms).arg(result.isEmpty() ? QString() : ", " + result),
+                         PicoEaseModel::System);
+    } else {
+        modelLogAppended(tr("%1: FAILED after %2 ms, %3").arg(step).arg(ms).arg(result), PicoEaseModel::System);
+    }
+}
+
+void MainWindow::scriptFinished(bool ok, int steps, qint64 ms)
+{
+    if (steps > 1 || !ok) {
+        modelLogAppended(ok ? tr("Script finished, %1 steps in %2 ms").arg(steps).arg(ms)
+                            : tr("Script STOPPED after %1 steps, %2 ms").arg(steps).arg(ms),
+                         PicoEaseModel::System);
+    }
+    ui->grpActions->setEnabled(ui->btnConnectSerialPort->isChecked() && !model->IsBusy());
+}
+
 void MainWindow::modelSerialPortUnexpectedDisconnection()
 {
     ui->btnConnectSerialPort->setChecked(false);
@@ -157,8 +443,8 @@ void MainWindow::modelManualCommandFinish()
 
 void MainWindow::modelBulkCommandLockUi(bool setLocked)
 {
-    ui->frmCommandInput->setDisabled(setLocked);
-    ui->grpActions->setDisabled(setLocked);
+    // Commands can still be typed ahead, actions wait for a script to finish
+    ui->grpActions->setDisabled(setLocked || scriptRunner->isRunning());
 }
 
 void MainWindow::modelUpdateProgressMessage(QString message)
@@ -173,18 +459,65 @@ void MainWindow::modelUpdateProgressBar(bool enabled, int value, int maximum)
     uiOperationProgress->setValue(value);
 }
 
-void MainWindow::modelLogViewAutoscroll()
+void MainWindow::modelLogAppended(QString text, PicoEaseModel::LogType type)
 {
-    // Qt really should make view capable of doing autoscroll on its own
-    QTimer::singleShot(0, [&](){
-        ui->lstCommandLog->scrollToBottom();
-    });
+    QColor color;
+    switch (type) {
+    case PicoEaseModel::System: color = { 255, 255, 255 }; break;
+    case PicoEaseModel::BulkCmd: color = { 160, 160, 255 }; break;
+    case PicoEaseModel::ManualCmd: color = { 160, 255, 160 }; break;
+    case PicoEaseModel::ReturnData: color = { 160, 160, 160 }; break;
+    }
+
+    logModel.insertRow(logModel.rowCount());
+    auto index = logModel.index(logModel.rowCount() - 1);
+    logModel.setData(index, text);
+    logModel.setData(index, color, Qt::ForegroundRole);
+
+    if (ui->chkLogsAutoscroll->isChecked()) {
+        // Qt really should make view capable of doing autoscroll on its own
+        QTimer::singleShot(0, [&](){
+            ui->lstCommandLog->scrollToBottom();
+        });
+    }
 }
 
-void MainWindow::modelUpdateDumpContent(QByteArray data, size_t offset)
+void MainWindow::modelUpdateDumpContent(QSharedPointer<SparseImage> data, size_t offset)
 {
-    ui->hexDumpContent->setData(data);
+    cancelDiff(); // the compare must not read the buffer being replaced
+    ui->hexDumpContent->setData(*data);
     ui->hexDumpContent->setAddressOffset(offset);
+    dumpImage = data; // the editor reads it from now on, the former one is released
+    liveMemory.reset();
+}
+
+void MainWindow::hexEditSearchProgress(int permille)
+{
+    uiOperationProgress->setValue(permille);
+}
+
+void MainWindow::hexEditSearchFinished(qint64 pos, qint64 length)
+{
+    ui->actionCancelSearch->setEnabled(false);
+    uiOperationProgress->setVisible(false);
+    if (pos < 0)
+        uiOperatingMessage->setText(tr("Pattern not found"));
+    else
+        uiOperatingMessage->setText(tr("Found %1 bytes at %2").arg(length).arg(pos, 0, 16));
+}
+
+void MainWindow::editorTabChanged()
+{
+    signaturePanel->setEditor(currentEditor());
+    checksumPanel->setEditor(currentEditor());
+    stringsPanel->setEditor(currentEditor());
+}
+
+void MainWindow::showEditorRange(QHexEdit *editor, qint64 pos, qint64 length)
+{
+    ui->tabEditors->setCurrentWidget(editor);
+    editor->selectRange(pos, length);
+    editor->setFocus();
 }
 
 void MainWindow::setUiConnectedState(bool connected)
@@ -193,6 +526,7 @@ void MainWindow::setUiConnectedState(bool connected)
         // Connect
         ui->grpActions->setEnabled(true);
         ui->btnCommandExec->setEnabled(true);
+        ui->actionRunScript->setEnabled(true);
 
         ui->btnRefreshSerialPorts->setEnabled(false);
         ui->cmbSerialPortSelection->setEnabled(false);
@@ -200,6 +534,7 @@ void MainWindow::setUiConnectedState(bool connected)
         // Disconnect
         ui->grpActions->setEnabled(false);
         ui->btnCommandExec->setEnabled(false);
+        ui->actionRunScript->setEnabled(false);
 
         ui->btnRefreshSerialPorts->setEnabled(true);
         ui->cmbSerialPortSelection->setEnabled(true);
@@ -220,20 +555,72 @@ void MainWindow::on_actionSave_as_triggered()
     settings.setValue("DialogPath/SaveDump", QFileInfo(savePath).dir().path());
 }
 
-void MainWindow::on_chkLogsAutoscroll_stateChanged(int arg1)
+void MainWindow::on_actionExportSelection_triggered()
 {
-    model->SetLogAutoscrollSignalEnabled(arg1 != Qt::Unchecked);
+    auto editor = currentEditor();
+    if (!editor) return;
+    qint64 begin = editor->getSelectionBegin();
+    qint64 length = editor->getSelectionEnd() - begin;
+    if (length <= 0) {
+        QMessageBox::information(this, tr("Export selection"), tr("Select the bytes to export first."));
+        return;
+    }
+
+    const QString filterReadable = tr("Hex dump with addresses and ASCII (*.txt)");
+    const QString filterWrapped = tr("Hex, 16 bytes per line (*.txt)");
+    const QString filterHex = tr("Plain hex (*.txt)");
+    QString filter = settings.value("Export/Format", filterReadable).toString();
+    auto path = settings.value("DialogPath/Export").toString();
+    auto savePath = QFileDialog::getSaveFileName(this,
+                                                 tr("Export selection to..."),
+                                                 path,
+                                                 filterReadable + ";;" + filterWrapped + ";;" + filterHex,
+                                                 &filter);
+    if (savePath.isEmpty()) return;
+    settings.setValue("DialogPath/Export", QFileInfo(savePath).dir().path());
+    settings.setValue("Export/Format", filter);
+
+    QFile f(savePath);
+    if (!f.open(QFile::WriteOnly | QFile::Truncate)) {
+        QMessageBox::critical(this, tr("Cannot open for saving"), tr("Selected file cannot be opened."));
+        return;
+    }
+
+    // Written block by block, so the text never has to fit into memory
+    auto format = filter == filterHex ? HexFormat::Hex
+                : filter == filterWrapped ? HexFormat::WrappedHex
+                : HexFormat::Readable;
+    QProgressDialog progress(tr("Exporting selection..."), tr("Cancel"), 0, 1000, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(500);
+    bool ok = editor->writeSelection(f, format, [&progress, begin, length](qint64 pos) {
+        progress.setValue((int)((pos - begin) * 1000 / length));
+        return !progress.wasCanceled();
+    });
+    progress.reset();
+    f.close();
+    if (!ok && !progress.wasCanceled())
+        QMessageBox::critical(this, tr("Export selection"), tr("Writing the file failed: %1").arg(f.errorString()));
 }
 
 void MainWindow::restoreSettings()
 {
     ui->chkLogsAutoscroll->setChecked(settings.value("Ui/LogAutoscroll", true).toBool());
-    model->SetLogAutoscrollSignalEnabled(ui->chkLogsAutoscroll->isChecked());
+    ui->actionCompareResync->setChecked(settings.value("Ui/CompareResync", false).toBool());
+    ui->actionShowMinimap->setChecked(settings.value("Ui/Minimap", false).toBool());
+    ui->spnWriteRecordSize->setValue(settings.value("Target/WriteRecordSize", 32).toInt());
+    ui->edtPageSize->setText(settings.value("Target/PageSize", "1000").toString());
+    ui->edtTargetId->setText(settings.value("Target/Id").toString());
 }
 
 void MainWindow::saveSettings()
 {
     settings.setValue("Ui/LogAutoscroll", ui->chkLogsAutoscroll->isChecked());
+    settings.setValue("Ui/CompareResync", ui->actionCompareResync->isChecked());
+    settings.setValue("Ui/Minimap", ui->actionShowMinimap->isChecked());
+    settings.setValue("Target/WriteRecordSize", ui->spnWriteRecordSize->value());
+    settings.setValue("Target/PageSize", ui->edtPageSize->text());
+    settings.setValue("Target/Id", ui->edtTargetId->text());
 }
 
 void MainWindow::on_edtCommand_returnPressed()
@@ -244,7 +631,7 @@ void MainWindow::on_edtCommand_returnPressed()
 
 void MainWindow::on_btnClearLogs_clicked()
 {
-    model->ClearLogs();
+    logModel.removeRows(0, logModel.rowCount(), QModelIndex());
 }
 
 
@@ -253,3 +640,260 @@ void MainWindow::on_btnUnlockTarget_clicked()
     model->IssueBulkCommand(PicoEaseModel::BCUnlockTarget);
 }
 
+
+
+void MainWindow::on_actionFind_triggered()
+{
+    bool ok;
+    auto text = QInputDialog::getText(this,
+                                      tr("Find"),
+                                      tr("Byte pattern, e.g. E8 ?? ?? ?? ?? (48|4C) 8B or \"MZ\":"),
+                                      QLineEdit::Normal,
+                                      searchPattern.pattern(),
+                                      &ok);
+    if (!ok || text.trimmed().isEmpty()) return;
+
+    BytePattern pattern(text);
+    if (!pattern.isValid()) {
+        QMessageBox::warning(this, tr("Invalid pattern"), pattern.errorString());
+        return;
+    }
+
+    searchPattern = pattern;
+    if (auto editor = currentEditor())
+        startSearch(editor->cursorPosition() / 2);
+}
+
+
+void MainWindow::on_actionFindNext_triggered()
+{
+    if (!searchPattern.isValid()) {
+        on_actionFind_triggered();
+        return;
+    }
+
+    // A found match leaves the cursor right behind it
+    if (auto editor = currentEditor())
+        startSearch(editor->cursorPosition() / 2);
+}
+
+
+void MainWindow::on_actionCancelSearch_triggered()
+{
+    if (searchEditor)
+        searchEditor->cancelSearch();
+}
+
+
+void MainWindow::on_actionCompare_toggled(bool checked)
+{
+    if (checked) {
+        startDiff();
+        return;
+    }
+    cancelDiff();
+    diffRanges.clear();
+    ui->hexDumpContent->setMarkedRanges({});
+    ui->hexFileContent->setMarkedRanges({});
+    ui->actionNextDifference->setEnabled(false);
+    ui->actionPreviousDifference->setEnabled(false);
+    uiOperationProgress->setVisible(false);
+    uiOperatingMessage->clear();
+}
+
+
+void MainWindow::on_actionCompareResync_toggled(bool checked)
+{
+    Q_UNUSED(checked);
+    if (ui->actionCompare->isChecked())
+        startDiff();
+}
+
+
+void MainWindow::on_actionShowMinimap_toggled(bool checked)
+{
+    for (auto editor : { ui->hexDumpContent, ui->hexFileContent, ui->hexScratchpad })
+        editor->setMinimap(checked);
+}
+
+
+void MainWindow::on_actionTransformFill_triggered()
+{
+    transformSelection(Transform::Fill);
+}
+
+
+void MainWindow::on_actionTransformXor_triggered()
+{
+    transformSelection(Transform::Xor);
+}
+
+
+void MainWindow::on_actionTransformAdd_triggered()
+{
+    transformSelection(Transform::Add);
+}
+
+
+void MainWindow::on_actionTransformSwap16_triggered()
+{
+    transformSelection(Transform::Swap16);
+}
+
+
+void MainWindow::on_actionTransformSwap32_triggered()
+{
+    transformSelection(Transform::Swap32);
+}
+
+
+void MainWindow::transformSelection(Transform::Operation operation)
+{
+    QHexEdit *editor = currentEditor();
+    if (!editor || editor->isReadOnly()) return;
+    if (editor->getSelectionBegin() == editor->getSelectionEnd()) {
+        QMessageBox::information(this, tr("Transform"), tr("Select the bytes to transform first."));
+        return;
+    }
+
+    QByteArray operand;
+    if (operation == Transform::Fill || operation == Transform::Xor || operation == Transform::Add) {
+        bool ok;
+        auto text = QInputDialog::getText(this,
+                                          Transform(operation).name(),
+                                          tr("Hex bytes, repeated over the selection, e.g. FF or DE AD BE EF:"),
+                                          QLineEdit::Normal,
+                                          settings.value("Ui/TransformOperand").toString(),
+                                          &ok);
+        if (!ok) return;
+        operand = HexParser::parse(text.toLatin1());
+        if (operand.isEmpty()) {
+            QMessageBox::warning(this, tr("Transform"), tr("Enter at least one hex byte."));
+            return;
+        }
+        settings.setValue("Ui/TransformOperand", text);
+    }
+    editor->transformSelection(Transform(operation, operand));
+}
+
+
+void MainWindow::on_actionNextDifference_triggered()
+{
+    gotoDifference(true);
+}
+
+
+void MainWindow::on_actionPreviousDifference_triggered()
+{
+    gotoDifference(false);
+}
+
+void MainWindow::startDiff()
+{
+    // Both images are read by the worker, edits wait for its current block
+    cancelDiff();
+    Chunks *a = ui->hexDumpContent->chunks();
+    Chunks *b = ui->hexFileContent->chunks();
+    bool resync = ui->actionCompareResync->isChecked();
+    qint64 size = std::max<qint64>(a->size(), 1);
+    uiOperatingMessage->setText(tr("Comparing..."));
+    uiOperationProgress->setMaximum(1000);
+    uiOperationProgress->setValue(0);
+    uiOperationProgress->setVisible(true);
+    diffWatcher.setFuture(QtConcurrent::run([a, b, resync, size](QPromise<QVector<BinDiff::Range>> &promise) {
+        promise.setProgressRange(0, 1000);
+        QVector<BinDiff::Range> ranges;
+        if (BinDiff::compare(*a, *b, resync, ranges, [&promise, size](qint64 pos) {
+                promise.setProgressValue((int)(pos * 1000 / size));
+                return !promise.isCanceled();
+            }))
+            promise.addResult(ranges);
+    }));
+}
+
+void MainWindow::cancelDiff()
+{
+    diffDelay.stop();
+    diffWatcher.cancel();
+    diffWatcher.waitForFinished();
+}
+
+void MainWindow::diffFinished()
+{
+    if (diffWatcher.isCanceled() || diffWatcher.future().resultCount() == 0)
+        return;
+    uiOperationProgress->setVisible(false);
+    diffRanges = diffWatcher.result();
+    diffShown = -1;
+
+    QVector<QPair<qint64, qint64>> marksA, marksB;
+    qint64 bytes = 0;
+    for (auto &range : diffRanges) {
+        if (range.lenA > 0) marksA.append(qMakePair(range.posA, range.lenA));
+        if (range.lenB > 0) marksB.append(qMakePair(range.posB, range.lenB));
+        bytes += std::max(range.lenA, range.lenB);
+    }
+    ui->hexDumpContent->setMarkedRanges(marksA);
+    ui->hexFileContent->setMarkedRanges(marksB);
+    ui->actionNextDifference->setEnabled(!diffRanges.isEmpty());
+    ui->actionPreviousDifference->setEnabled(!diffRanges.isEmpty());
+    if (diffRanges.isEmpty())
+        uiOperatingMessage->setText(tr("Dump and file are equal"));
+    else
+        uiOperatingMessage->setText(tr("%n difference(s), %1 bytes", nullptr, diffRanges.size()).arg(bytes));
+}
+
+void MainWindow::diffEditorScrolled(qint64 line)
+{
+    // The other side follows, shifted by the lengths resync found to differ
+    if (!ui->actionCompare->isChecked() || diffSyncing) return;
+    auto source = qobject_cast<QHexEdit*>(sender());
+    bool fromA = source == ui->hexDumpContent;
+    QHexEdit *target = fromA ? ui->hexFileContent : ui->hexDumpContent;
+    qint64 pos = line * source->bytesPerLine();
+    pos = fromA ? BinDiff::mapToB(diffRanges, pos) : BinDiff::mapToA(diffRanges, pos);
+    diffSyncing = true;
+    target->scrollToLine(pos / target->bytesPerLine());
+    diffSyncing = false;
+}
+
+void MainWindow::gotoDifference(bool next)
+{
+    // Works from the cursor of the shown side, the scratchpad follows the dump
+    QHexEdit *editor = currentEditor();
+    bool inB = editor == ui->hexFileContent;
+    if (!inB) editor = ui->hexDumpContent;
+    qint64 pos = editor->cursorPosition() / 2;
+    int idx;
+    if (diffShown >= 0 && diffShown < diffRanges.size() &&
+        pos == (inB ? diffRanges[diffShown].posB + diffRanges[diffShown].lenB
+                    : diffRanges[diffShown].posA + diffRanges[diffShown].lenA)) {
+        // The cursor is still where the last step left it. Ranges empty on
+        // this side, e.g. bytes inserted into the other image, leave it at
+        // their start, so stepping goes on from their index.
+        idx = next ? diffShown + 1 : diffShown - 1;
+        if (idx >= diffRanges.size()) idx = -1;
+    } else if (!next) {
+        // the cursor sits behind a difference shown by the previous step
+        int current = BinDiff::previousRange(diffRanges, pos, inB);
+        if (current >= 0 && pos <= (inB ? diffRanges[current].posB + diffRanges[current].lenB
+                                        : diffRanges[current].posA + diffRanges[current].lenA))
+            pos = inB ? diffRanges[current].posB : diffRanges[current].posA;
+        idx = BinDiff::previousRange(diffRanges, pos, inB);
+    } else {
+        idx = BinDiff::nextRange(diffRanges, pos - 1, inB);
+    }
+    if (idx < 0) {
+        uiOperatingMessage->setText(next ? tr("No more differences") : tr("No previous difference"));
+        return;
+    }
+
+    diffShown = idx;
+    auto &range = diffRanges.at(idx);
+    diffSyncing = true;
+    ui->hexDumpContent->selectRange(range.posA, range.lenA);
+    ui->hexFileContent->selectRange(range.posB, range.lenB);
+    diffSyncing = false;
+    showEditorRange(editor, inB ? range.posB : range.posA, inB ? range.lenB : range.lenA);
+    uiOperatingMessage->setText(tr("Difference %1 of %2").arg(idx + 1).arg(diffRanges.size()));
+}
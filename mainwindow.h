@@ -5,6 +5,16 @@
 #include <QSettings>
 #include <QProgressBar>
 #include <QLabel>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QSharedPointer>
+#include "bytepattern.h"
+#include "bindiff.h"
+#include "sparseimage.h"
+#include "pageddevice.h"
+#include "transform.h"
+#include "picoeasemodel.h"
+#include "coloredstringlistmodel.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -13,6 +23,15 @@ class MainWindow;
 QT_END_NAMESPACE
 
 class PicoEaseModel;
+class QHexEdit;
+class SignaturePanel;
+class ChecksumPanel;
+class StringsPanel;
+class WatchPanel;
+class GangPanel;
+class FlashProgrammer;
+class ImageVerifier;
+class ScriptRunner;
 
 class MainWindow : public QMainWindow
 {
@@ -31,9 +50,19 @@ private slots:
     void modelBulkCommandLockUi(bool setLocked);
     void modelUpdateProgressMessage(QString message);
     void modelUpdateProgressBar(bool enabled, int value, int maximum);
-    void modelLogViewAutoscroll();
+    void modelLogAppended(QString text, PicoEaseModel::LogType type);
 
-    void modelUpdateDumpContent(QByteArray data, size_t offset);
+    void modelUpdateDumpContent(QSharedPointer<SparseImage> data, size_t offset);
+
+    void hexEditSearchProgress(int permille);
+    void hexEditSearchFinished(qint64 pos, qint64 length);
+
+    void editorTabChanged();
+    void showEditorRange(QHexEdit* editor, qint64 pos, qint64 length);
+
+    void startDiff();
+    void diffFinished();
+    void diffEditorScrolled(qint64 line);
 
 private slots:
     void on_btnRefreshSerialPorts_clicked();
@@ -44,9 +73,27 @@ private slots:
 
     void on_btnReadTargetMemory_clicked();
 
+    void on_btnBrowseTargetMemory_clicked();
+
+    void on_btnWriteTargetMemory_clicked();
+
+    void on_btnWriteChanges_clicked();
+
+    void programmerFinished(bool ok, QString message);
+
+    void on_btnVerifyFile_clicked();
+
+    void verifierFinished(bool ok, QString message, QVector<QPair<qint64, qint64>> differences);
+
+    void on_actionRunScript_triggered();
+
+    void scriptStepFinished(QString step, bool ok, QString result, qint64 ms);
+
+    void scriptFinished(bool ok, int steps, qint64 ms);
+
     void on_actionSave_as_triggered();
 
-    void on_chkLogsAutoscroll_stateChanged(int arg1);
+    void on_actionExportSelection_triggered();
 
     void on_edtCommand_returnPressed();
 
@@ -54,21 +101,84 @@ private slots:
 
     void on_btnUnlockTarget_clicked();
 
+    void on_actionFind_triggered();
+
+    void on_actionFindNext_triggered();
+
+    void on_actionCancelSearch_triggered();
+
+    void on_actionCompare_toggled(bool checked);
+
+    void on_actionCompareResync_toggled(bool checked);
+
+    void on_actionNextDifference_triggered();
+
+    void on_actionPreviousDifference_triggered();
+
+    void on_actionShowMinimap_toggled(bool checked);
+
+    void on_actionTransformFill_triggered();
+
+    void on_actionTransformXor_triggered();
+
+    void on_actionTransformAdd_triggered();
+
+    void on_actionTransformSwap16_triggered();
+
+    void on_actionTransformSwap32_triggered();
+
 private:
     QSettings settings;
     Ui::MainWindow *ui;
     PicoEaseModel* model;
+    ColoredStringListModel logModel;
 
     QLabel* uiOperatingMessage;
     QProgressBar* uiOperationProgress;
 
+    BytePattern searchPattern;
+    QHexEdit* searchEditor;
+
+    // Device shown by Dump Content, fill regions are not stored byte by byte
+    QSharedPointer<SparseImage> dumpImage;
+    // or target memory paged in while browsing it live
+    QSharedPointer<PagedDevice> liveMemory;
+
+    // Writes the changed pages of an editor and verifies them
+    FlashProgrammer* programmer;
+    // Compares target memory with File Content
+    ImageVerifier* verifier;
+    // Runs scripts and the commands typed, one right after the other
+    ScriptRunner* scriptRunner;
+
+    // Compare Dump Content (a) with File Content (b)
+    QFutureWatcher<QVector<BinDiff::Range>> diffWatcher;
+    QVector<BinDiff::Range> diffRanges;
+    QTimer diffDelay;
+    bool diffSyncing;
+    int diffShown; ///< Index of the range shown by the last step, -1 if none
+
+    // Tool panels
+    SignaturePanel* signaturePanel;
+    ChecksumPanel* checksumPanel;
+    StringsPanel* stringsPanel;
+    WatchPanel* watchPanel;
+    GangPanel* gangPanel;
+
     // Settings
     void restoreSettings();
     void saveSettings();
 
+    void transformSelection(Transform::Operation operation);
+
     void setUiConnectedState(bool connected);
     void refreshSerialPorts();
     void issueManualCommand();
     bool commonSaveBinary(QString filePath, QByteArrayView binaryData);
+    QHexEdit* currentEditor();
+    void addToolDock(QWidget* panel, QString title);
+    void startSearch(qint64 from);
+    void cancelDiff();
+    void gotoDifference(bool next);
 };
 #endif // MAINWINDOW_H
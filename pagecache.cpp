@@ -0,0 +1,78 @@
+#include "pagecache.h"
+#include "checksum.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QRegularExpression>
+#include <QSaveFile>
+
+PageCache::PageCache(const QString &directory) : m_directory(directory)
+{
+}
+
+quint32 PageCache::crc32(const QByteArray &data)
+{
+    return Checksum::crc32(0xffffffff, data.constData(), data.size()) ^ 0xffffffff;
+}
+
+QString PageCache::indexPath(const QString &target) const
+{
+    // Target names are typed in, they must not leave the directory
+    QString name = target;
+    name.replace(QRegularExpression("[^A-Za-z0-9_.-]"), "_");
+    return m_directory + '/' + name + ".index";
+}
+
+PageCache::Index &PageCache::index(const QString &target)
+{
+    auto it = m_indexes.find(target);
+    if (it != m_indexes.end()) return *it;
+
+    // Later lines of an address replace earlier ones
+    Index &entries = m_indexes[target];
+    QFile file(indexPath(target));
+    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        while (!file.atEnd()) {
+            auto fields = file.readLine().simplified().split(' ');
+            if (fields.size() != 3) continue;
+            entries.insert(fields[0].toLongLong(nullptr, 16), Entry { fields[1].toUInt(nullptr, 16), fields[2] });
+        }
+    }
+    return entries;
+}
+
+QByteArray PageCache::lookup(const QString &target, qint64 address, quint32 crc)
+{
+    auto &entries = index(target);
+    auto it = entries.constFind(address);
+    if (it == entries.constEnd() || it->crc != crc) return QByteArray();
+
+    // A damaged page file is a miss, it is read from the target again
+    QFile file(m_directory + "/pages/" + it->sha1);
+    if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+    auto data = file.readAll();
+    return crc32(data) == crc ? data : QByteArray();
+}
+
+void PageCache::store(const QString &target, qint64 address, const QByteArray &data)
+{
+    quint32 crc = crc32(data);
+    auto sha1 = QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+    auto &entries = index(target);
+    auto it = entries.constFind(address);
+    if (it != entries.constEnd() && it->sha1 == sha1) return;
+
+    QDir().mkpath(m_directory + "/pages");
+    QString pagePath = m_directory + "/pages/" + sha1;
+    if (!QFile::exists(pagePath)) {
+        QSaveFile page(pagePath);
+        if (!page.open(QIODevice::WriteOnly)) return;
+        page.write(data);
+        if (!page.commit()) return;
+    }
+
+    QFile file(indexPath(target));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) return;
+    file.write(QString("%1 %2 %3\n").arg(address, 0, 16).arg(crc, 8, 16, QChar('0')).arg(QString(sha1)).toLatin1());
+    entries.insert(address, Entry { crc, sha1 });
+}
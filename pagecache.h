@@ -0,0 +1,43 @@
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include <QString>
+#include <QHash>
+#include <QByteArray>
+
+// Pages of target memory read before, kept on disk across sessions. Every
+// target type has an index of address and CRC-32 to the SHA-1 of the page,
+// the pages themselves are stored once by their SHA-1, so identical pages of
+// any board or address share one file.
+//
+//   <directory>/<target>.index    lines of "address crc sha1", all in hex
+//   <directory>/pages/<sha1>      page content
+class PageCache
+{
+public:
+    static constexpr qint64 PageSize = 0x1000;
+
+    PageCache(const QString &directory);
+
+    // The page at address, if the one cached for target has this CRC-32,
+    // empty otherwise
+    QByteArray lookup(const QString &target, qint64 address, quint32 crc);
+    void store(const QString &target, qint64 address, const QByteArray &data);
+
+    static quint32 crc32(const QByteArray &data);
+
+private:
+    struct Entry {
+        quint32 crc;
+        QByteArray sha1;                          ///< Hex
+    };
+    typedef QHash<qint64, Entry> Index;
+
+    Index &index(const QString &target);
+    QString indexPath(const QString &target) const;
+
+    QString m_directory;
+    QHash<QString, Index> m_indexes;              ///< Loaded on first use, by target
+};
+
+#endif // PAGECACHE_H
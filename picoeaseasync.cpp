@@ -0,0 +1,121 @@
+#include "picoeaseasync.h"
+#include "picoeasemodel.h"
+#include <utility>
+
+PicoEaseAsync::PicoEaseAsync(PicoEaseModel *model, QObject *parent)
+    : QObject(parent), m_model(model), m_hookId(0), m_operation(None), m_issued(false), m_ok(false), m_address(0), m_length(0)
+{
+    // Results are taken as the model reports them, the flow goes on once the
+    // model is done with the command
+    m_hookId = m_model->AddCommandEndedHook([this]() { commandEnded(); });
+    connect(m_model, &PicoEaseModel::UnlockFinished, this, [this](bool unlocked) {
+        if (m_issued && m_operation == Unlock) m_ok = unlocked;
+    });
+    connect(m_model, &PicoEaseModel::LogAppended, this, [this](QString text, PicoEaseModel::LogType type) {
+        if (m_issued && m_operation == Send && type == PicoEaseModel::ReturnData && text != "Done")
+            m_answer.append(text);
+    });
+    connect(m_model, &PicoEaseModel::ManualCommandFinish, this, [this]() {
+        if (m_issued && m_operation == Send) m_ok = true;
+    });
+    // The model stays busy until it is disconnected, the flow learns of it now
+    connect(m_model, &PicoEaseModel::SerialPortUnexpectedDisconnection, this, [this]() {
+        if (m_flow) {
+            m_ok = false;
+            resume();
+        }
+    });
+}
+
+PicoEaseAsync::~PicoEaseAsync()
+{
+    if (m_model) m_model->RemoveCommandEndedHook(m_hookId);
+    // A flow waiting for a command is never resumed, its locals are destroyed
+    if (m_flow) m_flow.destroy();
+}
+
+template <typename T>
+PicoEaseAsync::Awaiter<T> PicoEaseAsync::start(Operation operation, T (PicoEaseAsync::*result)() const)
+{
+    Q_ASSERT(!m_flow);
+    m_operation = operation;
+    m_issued = false;
+    m_ok = false;
+    return Awaiter<T>(this, result);
+}
+
+PicoEaseAsync::Awaiter<bool> PicoEaseAsync::unlock()
+{
+    return start(Unlock, &PicoEaseAsync::unlocked);
+}
+
+PicoEaseAsync::Awaiter<QByteArrayView> PicoEaseAsync::readMemory(qint64 address, qint64 length)
+{
+    m_address = address;
+    m_length = length;
+    return start(Read, &PicoEaseAsync::bytesRead);
+}
+
+PicoEaseAsync::Awaiter<QStringList> PicoEaseAsync::sendRaw(QString command)
+{
+    m_command = command;
+    return start(Send, &PicoEaseAsync::answer);
+}
+
+bool PicoEaseAsync::suspend(std::coroutine_handle<> flow)
+{
+    if (m_operation == Read) m_readBuffer.resize(0);
+    if (m_flow || !m_model->IsConnected()) return false;
+    if (m_model->IsBusy()) {
+        // Issued when the command of the user ended
+        m_flow = flow;
+        return true;
+    }
+    if (!issue()) return false;
+    m_flow = flow;
+    return true;
+}
+
+bool PicoEaseAsync::issue()
+{
+    switch (m_operation) {
+    case Unlock:
+        m_issued = m_model->IssueBulkCommand(PicoEaseModel::BCUnlockTarget);
+        break;
+    case Read:
+        // Capacity is kept, reads up to the size of one before allocate nothing
+        m_issued = m_length > 0 && m_model->IssueDumpInto(m_address, m_length, &m_readBuffer);
+        break;
+    case Send:
+        // Answer lines are collected from here on
+        m_answer.clear();
+        m_issued = !m_command.trimmed().isEmpty();
+        if (m_issued) m_model->SendPicoEaseCommand(m_command.trimmed() + '\n');
+        break;
+    case None:
+        break;
+    }
+    return m_issued;
+}
+
+void PicoEaseAsync::commandEnded()
+{
+    // Only one command runs at a time, an issued operation is the one ended
+    if (!m_flow) return;
+    if (m_issued) {
+        resume();
+        return;
+    }
+    // The command, which held the operation back, ended. Another one started
+    // meanwhile, e.g. of the user or of another flow, holds it back further.
+    if (m_model->IsConnected() && m_model->IsBusy()) return;
+    if (m_model->IsConnected() && issue()) return;
+    resume();
+}
+
+void PicoEaseAsync::resume()
+{
+    // The flow may await the next command before this returns
+    m_issued = false;
+    std::exchange(m_flow, nullptr).resume();
+}
@@ -0,0 +1,101 @@
+#ifndef PICOEASEASYNC_H
+#define PICOEASEASYNC_H
+
+#include <QObject>
+#include <QPointer>
+#include <QByteArray>
+#include <QStringList>
+#include <coroutine>
+#include <exception>
+
+class PicoEaseModel;
+
+// Return type of flows, coroutines which co_await commands of a
+// PicoEaseAsync. A flow runs as soon as it is called, up to its first
+// command, and frees itself when it returns.
+struct PicoEaseFlow
+{
+    struct promise_type
+    {
+        PicoEaseFlow get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+// Commands of a PicoEaseModel to co_await in a flow, e.g.
+//
+//   PicoEaseFlow Station::run()
+//   {
+//       if (!co_await m_async->unlock()) co_return;
+//       auto data = co_await m_async->readMemory(0x8000, 0x1000);
+//       ...
+//   }
+//
+// The flow goes on from a command ended hook of the model, once it handled the
+// lines received and started queued commands, so the next command follows
+// without a round trip through the event loop. Commands of the user running
+// meanwhile go first, as do those of other PicoEaseAsync on the same model. A
+// command, which cannot be issued, e.g. without a connection, fails at once.
+// One command at a time is awaited.
+class PicoEaseAsync : public QObject
+{
+    Q_OBJECT
+public:
+    PicoEaseAsync(PicoEaseModel *model, QObject *parent = nullptr);
+    ~PicoEaseAsync();
+
+    template <typename T>
+    class Awaiter
+    {
+    public:
+        Awaiter(PicoEaseAsync *async, T (PicoEaseAsync::*result)() const) : m_async(async), m_result(result) {}
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> flow) { return m_async->suspend(flow); }
+        T await_resume() const { return (m_async->*m_result)(); }
+
+    private:
+        PicoEaseAsync *m_async;
+        T (PicoEaseAsync::*m_result)() const;
+    };
+
+    // Whether the target is unlocked
+    Awaiter<bool> unlock();
+    // The bytes read, shorter than length if the read failed. The model
+    // decodes them straight into a buffer of this, so they stay valid until
+    // the next read, which reuses its memory.
+    Awaiter<QByteArrayView> readMemory(qint64 address, qint64 length);
+    // Answer lines up to "Done", empty if the command was not answered
+    Awaiter<QStringList> sendRaw(QString command);
+
+private:
+    enum Operation { None, Unlock, Read, Send };
+
+    template <typename T>
+    Awaiter<T> start(Operation operation, T (PicoEaseAsync::*result)() const);
+    bool suspend(std::coroutine_handle<> flow); ///< false if it failed at once and the flow goes on
+    bool issue();
+    void commandEnded();
+    void resume();
+
+    bool unlocked() const { return m_ok; }
+    QByteArrayView bytesRead() const { return m_readBuffer; }
+    QStringList answer() const { return m_ok ? m_answer : QStringList(); }
+
+    QPointer<PicoEaseModel> m_model;
+    int m_hookId;
+    std::coroutine_handle<> m_flow;               ///< Waiting for the end of m_operation
+    Operation m_operation;
+    bool m_issued;                                ///< m_operation went to the model, its end resumes m_flow
+    bool m_ok;
+
+    qint64 m_address;
+    qint64 m_length;
+    QString m_command;
+    QByteArray m_readBuffer;                      ///< Bytes of the last read, filled by the model
+    QStringList m_answer;
+};
+
+#endif // PICOEASEASYNC_H
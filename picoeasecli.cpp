@@ -0,0 +1,266 @@
+// Command line front end of PicoEaseModel for scripts, CI rigs and factory
+// stations. It needs QtCore and QtSerialPort only, so it starts without
+// loading any GUI library, and prints its results as one JSON object.
+
+#include "picoeasemodel.h"
+#include "imageverifier.h"
+#include "scriptrunner.h"
+#include "sparseimage.h"
+#include "checksum.h"
+#include "chunks.h"
+#include <QCommandLineParser>
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QScopedPointer>
+#include <QSerialPortInfo>
+#include <QTextStream>
+#include <cstdio>
+
+enum ExitCode { ExitOk, ExitFailed, ExitUsage };
+
+static void printResult(const QJsonObject &result)
+{
+    QTextStream(stdout) << QJsonDocument(result).toJson(QJsonDocument::Compact) << Qt::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    // Latencies are measured from here
+    QElapsedTimer clock;
+    clock.start();
+
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("PicoEaseUI"); // shares the page cache with the GUI
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Unlocks, dumps and verifies targets of a PicoEASE, results are printed as JSON.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("command", "unlock, dump, verify, run, bench-write or ports");
+    QCommandLineOption portOption({ "p", "port" }, "Serial port of the PicoEASE.", "name");
+    QCommandLineOption offsetOption("offset", "Target address (hex).", "address", "0");
+    QCommandLineOption lengthOption("length", "Bytes to dump (hex).", "length");
+    QCommandLineOption outOption({ "o", "out" }, "File the dump is written to, as it arrives.", "file");
+    QCommandLineOption fileOption({ "f", "file" }, "Image to verify against.", "file");
+    QCommandLineOption blockOption("block", "Block size of the CRCs of verify (hex).", "size", "1000");
+    QCommandLineOption scriptOption({ "s", "script" }, "Script to run, - reads it from stdin.", "file");
+    QCommandLineOption cacheOption("cache", "Target type, whose cached pages are not dumped again.", "target");
+    QCommandLineOption recordsOption("records", "Record sizes bench-write tries, comma separated.", "sizes", "16,32,64,128,255");
+    QCommandLineOption windowsOption("windows", "Windows bench-write tries, comma separated.", "counts", "1,2,4,8,16,32");
+    QCommandLineOption latencyOption("latency", "Latency of the answers of the emulator in ms.", "ms");
+    QCommandLineOption verboseOption({ "v", "verbose" }, "Print the log of PicoEASE to stderr.");
+    parser.addOptions({ portOption, offsetOption, lengthOption, outOption, fileOption, blockOption,
+                        scriptOption, cacheOption, recordsOption, windowsOption, latencyOption, verboseOption });
+    parser.process(app);
+
+    auto args = parser.positionalArguments();
+    QString command = args.value(0);
+    QJsonObject result { { "command", command } };
+    auto fail = [&result, &clock](QString error) {
+        result["ok"] = false;
+        result["error"] = error;
+        result["total_ms"] = clock.elapsed();
+        printResult(result);
+    };
+
+    if (command == "ports") {
+        QJsonArray ports;
+        for (auto &&info : QSerialPortInfo::availablePorts())
+            ports.append(QJsonObject { { "name", info.portName() }, { "description", info.description() } });
+        ports.append(QJsonObject { { "name", PicoEaseModel::EmulatorPortName }, { "description", "Emulator" } });
+        result["ok"] = true;
+        result["ports"] = ports;
+        printResult(result);
+        return ExitOk;
+    }
+    if (command != "unlock" && command != "dump" && command != "verify" && command != "run" && command != "bench-write") {
+        fail(QString("Unknown command \"%1\"").arg(command));
+        return ExitUsage;
+    }
+    if (!parser.isSet(portOption)) {
+        fail("No --port given");
+        return ExitUsage;
+    }
+
+    qint64 offset = parser.value(offsetOption).toLongLong(nullptr, 16);
+    qint64 length = parser.value(lengthOption).toLongLong(nullptr, 16);
+    QFile out(parser.value(outOption));
+    QFile image(parser.value(fileOption));
+    if (command == "dump" && (length <= 0 || !parser.isSet(outOption))) {
+        fail("dump needs --length and --out");
+        return ExitUsage;
+    }
+    // Every record size is written with every window, random bytes of length
+    QVector<QPair<int, int>> benchRuns;
+    for (auto &&records : parser.value(recordsOption).split(',', Qt::SkipEmptyParts))
+        for (auto &&window : parser.value(windowsOption).split(',', Qt::SkipEmptyParts))
+            if (records.toInt() > 0 && records.toInt() <= 255 && window.toInt() > 0)
+                benchRuns.append({ records.toInt(), window.toInt() });
+    if (command == "bench-write" && (length <= 0 || benchRuns.isEmpty())) {
+        fail("bench-write needs --length and record sizes of 1 to 255 and windows above 0");
+        return ExitUsage;
+    }
+    if (command == "verify" && !parser.isSet(fileOption)) {
+        fail("verify needs --file");
+        return ExitUsage;
+    }
+    if (command == "run" && !parser.isSet(scriptOption)) {
+        fail("run needs --script");
+        return ExitUsage;
+    }
+    QFile script(parser.value(scriptOption));
+    if (command == "run" && !(script.fileName() == "-" ? script.open(stdin, QIODevice::ReadOnly)
+                                                       : script.open(QIODevice::ReadOnly))) {
+        fail(QString("Cannot open %1: %2").arg(script.fileName(), script.errorString()));
+        return ExitFailed;
+    }
+    if (command == "dump" && !out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        fail(QString("Cannot open %1: %2").arg(out.fileName(), out.errorString()));
+        return ExitFailed;
+    }
+    if (command == "verify" && !image.open(QIODevice::ReadOnly)) {
+        fail(QString("Cannot open %1: %2").arg(image.fileName(), image.errorString()));
+        return ExitFailed;
+    }
+    image.close(); // Chunks opens it for every read
+
+    PicoEaseModel model;
+    // Only the first end is printed, e.g. a port lost also fails the command
+    // running
+    bool finished = false;
+    auto finish = [&result, &clock, &finished](bool ok, QString error) {
+        if (finished) return;
+        finished = true;
+        result["ok"] = ok;
+        if (!error.isEmpty())
+            result["error"] = error;
+        result["total_ms"] = clock.elapsed();
+        printResult(result);
+        QCoreApplication::exit(ok ? ExitOk : ExitFailed);
+    };
+    if (parser.isSet(verboseOption)) {
+        QObject::connect(&model, &PicoEaseModel::LogAppended, [](QString text, PicoEaseModel::LogType) {
+            QTextStream(stderr) << text << Qt::endl;
+        });
+    }
+    QObject::connect(&model, &PicoEaseModel::SerialPortUnexpectedDisconnection, [&finish]() {
+        finish(false, "Serial port error");
+    });
+
+    if (parser.isSet(latencyOption))
+        model.SetEmulatorLatency(parser.value(latencyOption).toInt());
+    if (!model.ConnectPicoEaseSerialPort(parser.value(portOption))) {
+        fail(QString("Cannot open port %1").arg(parser.value(portOption)));
+        return ExitFailed;
+    }
+    result["connect_ms"] = clock.elapsed();
+
+    // Commands are sent right away, the event loop only runs for their answers
+    quint32 crc = 0xffffffff;
+    qint64 written = 0;
+    QBuffer source;
+    QScopedPointer<Chunks> chunks;
+    ImageVerifier verifier(&model);
+    ScriptRunner runner(&model);
+    QJsonArray steps;
+    if (command == "unlock") {
+        QObject::connect(&model, &PicoEaseModel::UnlockFinished, [&finish](bool unlocked) {
+            finish(unlocked, unlocked ? QString() : "Target is still locked");
+        });
+        model.IssueBulkCommand(PicoEaseModel::BCUnlockTarget);
+    } else if (command == "dump") {
+        QObject::connect(&model, &PicoEaseModel::DumpDataReceived, [&](QByteArray data) {
+            if (written == 0)
+                result["first_byte_ms"] = clock.elapsed();
+            crc = Checksum::crc32(crc, data.constData(), data.size());
+            written += out.write(data);
+        });
+        QObject::connect(&model, &PicoEaseModel::UpdateDumpContentToUi, [&](QSharedPointer<SparseImage>, size_t) {
+            out.close();
+            result["bytes"] = written;
+            result["crc32"] = QString("%1").arg(crc ^ 0xffffffff, 8, 16, QChar('0')).toUpper();
+            finish(written == length, written == length ? QString() : QString("%1 of %2 bytes read").arg(written).arg(length));
+        });
+        model.SetDumpCacheTarget(parser.value(cacheOption));
+        model.IssueBulkCommand(PicoEaseModel::BCDumpRom, { { "offset", QString::number(offset, 16) },
+                                                           { "length", QString::number(length, 16) } });
+    } else if (command == "run") {
+        QObject::connect(&runner, &ScriptRunner::stepFinished, [&steps](QString step, bool ok, QString message, qint64 ms) {
+            QJsonObject entry { { "step", step }, { "ok", ok }, { "ms", ms } };
+            if (!message.isEmpty())
+                entry["result"] = message;
+            steps.append(entry);
+        });
+        QObject::connect(&runner, &ScriptRunner::finished, [&](bool ok, int, qint64 ms) {
+            result["steps"] = steps;
+            result["script_ms"] = ms;
+            finish(ok, ok ? QString() : "Stopped at a failed step");
+        });
+        QString error;
+        if (!runner.enqueue(QString::fromUtf8(script.readAll()), &error)) {
+            fail(error);
+            return ExitUsage;
+        }
+        // Scripts of nothing but comments and variables have no steps to wait for
+        if (!runner.isRunning()) {
+            result["steps"] = steps;
+            finish(true, QString());
+            return ExitOk;
+        }
+    } else if (command == "bench-write") {
+        // Runs start from the event loop, after the model is done with the one
+        // before, so a failure is printed once the loop runs
+        QByteArray data(length, Qt::Uninitialized);
+        QRandomGenerator random(1);
+        for (auto &byte : data)
+            byte = char(random.bounded(256));
+        source.setData(data);
+        chunks.reset(new Chunks(source, nullptr));
+        QJsonArray runs;
+        QElapsedTimer runTimer;
+        int run = 0;
+        auto startRun = [&]() {
+            runTimer.start();
+            if (!model.IssueWriteRom(chunks.data(), 0, length, offset, benchRuns.at(run).first, benchRuns.at(run).second))
+                finish(false, "Write cannot be issued");
+        };
+        QObject::connect(&model, &PicoEaseModel::WriteRomFinished, [&](bool ok) {
+            qint64 ms = std::max<qint64>(runTimer.elapsed(), 1);
+            runs.append(QJsonObject { { "record_size", benchRuns.at(run).first }, { "window", benchRuns.at(run).second },
+                                      { "ok", ok }, { "ms", ms }, { "kib_s", length * 1000.0 / 1024 / ms } });
+            result["runs"] = runs;
+            if (!ok) {
+                finish(false, "Write failed");
+            } else if (++run == benchRuns.size()) {
+                result["bytes"] = length;
+                finish(true, QString());
+            } else {
+                QMetaObject::invokeMethod(&model, startRun, Qt::QueuedConnection);
+            }
+        });
+        QMetaObject::invokeMethod(&model, startRun, Qt::QueuedConnection);
+        return app.exec();
+    } else {
+        QObject::connect(&verifier, &ImageVerifier::finished,
+                         [&](bool ok, QString message, QVector<QPair<qint64, qint64>> differences) {
+            QJsonArray ranges;
+            for (auto &&range : differences)
+                ranges.append(QJsonObject { { "address", QString::number(offset + range.first, 16) },
+                                            { "length", range.second } });
+            result["message"] = message;
+            result["differences"] = ranges;
+            finish(ok, QString());
+        });
+        chunks.reset(new Chunks(image, nullptr));
+        if (!verifier.verify(chunks.data(), offset, parser.value(blockOption).toLongLong(nullptr, 16))) {
+            fail("Verify cannot be issued");
+            return ExitFailed;
+        }
+    }
+    return app.exec();
+}
@@ -0,0 +1,171 @@
+#include "picoeaseemulator.h"
+#include "picoeasemodel.h"
+#include "checksum.h"
+#include <QTimer>
+#include <algorithm>
+#include <string.h>
+
+// Written target memory is kept in pages of this size
+constexpr qint64 emulatorPageSize = 0x1000;
+// Longer reads are refused, their answer would be held in memory at once
+constexpr qint64 maxReadLength = 0x1000000;
+// Data bytes per record of read answers
+constexpr int readRecordSize = 16;
+// About one USB full speed frame
+constexpr int defaultLatencyMs = 1;
+
+PicoEaseEmulator::PicoEaseEmulator(QObject *parent)
+    : QIODevice(parent), m_latency(defaultLatencyMs), m_writing(false), m_writeFailed(false), m_writeUpper(0)
+{
+}
+
+QByteArray PicoEaseEmulator::memory(qint64 address, qint64 length) const
+{
+    QByteArray data(length, char(0xff));
+    qint64 done = 0;
+    while (done < length) {
+        qint64 page = (address + done) / emulatorPageSize;
+        qint64 ofs = (address + done) % emulatorPageSize;
+        qint64 count = std::min(emulatorPageSize - ofs, length - done);
+        auto it = m_pages.constFind(page);
+        if (it != m_pages.constEnd())
+            memcpy(data.data() + done, it->constData() + ofs, count);
+        done += count;
+    }
+    return data;
+}
+
+void PicoEaseEmulator::store(qint64 address, const QByteArray &data)
+{
+    qint64 done = 0;
+    while (done < data.size()) {
+        qint64 page = (address + done) / emulatorPageSize;
+        qint64 ofs = (address + done) % emulatorPageSize;
+        qint64 count = std::min(emulatorPageSize - ofs, data.size() - done);
+        auto &bytes = m_pages[page];
+        if (bytes.isEmpty())
+            bytes = QByteArray(emulatorPageSize, char(0xff));
+        memcpy(bytes.data() + ofs, data.constData() + done, count);
+        done += count;
+    }
+}
+
+void PicoEaseEmulator::close()
+{
+    m_input.clear();
+    m_output.clear();
+    m_writing = false;
+    QIODevice::close();
+}
+
+qint64 PicoEaseEmulator::bytesAvailable() const
+{
+    return m_output.size() + QIODevice::bytesAvailable();
+}
+
+qint64 PicoEaseEmulator::readData(char *data, qint64 maxSize)
+{
+    qint64 count = std::min<qint64>(maxSize, m_output.size());
+    memcpy(data, m_output.constData(), count);
+    m_output.remove(0, count);
+    return count;
+}
+
+qint64 PicoEaseEmulator::writeData(const char *data, qint64 maxSize)
+{
+    m_input.append(data, maxSize);
+    qsizetype eolPos;
+    while ((eolPos = m_input.indexOf('\n')) != -1) {
+        auto line = m_input.left(eolPos).trimmed();
+        m_input.remove(0, eolPos + 1);
+        if (line.isEmpty()) continue;
+        if (m_writing)
+            handleRecord(line);
+        else
+            handleCommand(line);
+    }
+    return maxSize;
+}
+
+void PicoEaseEmulator::handleCommand(const QByteArray &line)
+{
+    auto args = line.simplified().split(' ');
+    if (args[0] == "A" && args.size() == 3) {
+        qint64 address = args[1].toLongLong(nullptr, 16);
+        qint64 length = args[2].toLongLong(nullptr, 16);
+        if (length > maxReadLength) {
+            answer("E Too long\r\nDone\r\n");
+            return;
+        }
+        auto data = memory(address, length);
+        QByteArray lines;
+        for (qint64 done = 0; done < length; done += readRecordSize) {
+            int count = (int)std::min<qint64>(readRecordSize, length - done);
+            lines += PicoEaseModel::EncodeIntelHexRecord(0x00, quint16(address + done), data.constData() + done, count) + "\r\n";
+        }
+        lines += PicoEaseModel::EncodeIntelHexRecord(0x01, 0, nullptr, 0) + "\r\n";
+        answer(lines + "Done\r\n");
+    } else if (args[0] == "C" && args.size() == 4) {
+        qint64 address = args[1].toLongLong(nullptr, 16);
+        qint64 length = args[2].toLongLong(nullptr, 16);
+        qint64 block = args[3].toLongLong(nullptr, 16);
+        if (length <= 0 || block <= 0 || block > maxReadLength) {
+            answer("E Bad block\r\nDone\r\n");
+            return;
+        }
+        QByteArray lines;
+        for (qint64 done = 0; done < length; done += block) {
+            auto data = memory(address + done, std::min(block, length - done));
+            quint32 crc = Checksum::crc32(0xffffffff, data.constData(), data.size()) ^ 0xffffffff;
+            lines += QByteArray::number(crc, 16).rightJustified(8, '0').toUpper() + "\r\n";
+        }
+        answer(lines + "Done\r\n");
+    } else if (args[0] == "B") {
+        answer("Lock:0\r\nDone\r\n");
+    } else if (args[0] == "W" && args.size() == 3) {
+        m_writing = true;
+        m_writeFailed = false;
+        m_writeUpper = 0;
+        answer("K\r\n");
+    } else {
+        answer("Unknown command\r\nDone\r\n");
+    }
+}
+
+void PicoEaseEmulator::handleRecord(const QByteArray &line)
+{
+    auto bytes = QByteArray::fromHex(line.mid(1));
+    uchar sum = 0;
+    for (char c : bytes)
+        sum += uchar(c);
+    bool valid = line.startsWith(':') && bytes.size() >= 5 && bytes.size() == uchar(bytes[0]) + 5 && sum == 0;
+    if (valid && bytes[3] == 0x01) {
+        m_writing = false;
+        answer("Done\r\n");
+        return;
+    }
+    if (m_writeFailed) return;
+
+    quint16 offset = valid ? quint16((uchar(bytes[1]) << 8) | uchar(bytes[2])) : 0;
+    if (valid && bytes[3] == 0x00) {
+        store((m_writeUpper << 16) + offset, bytes.mid(4, uchar(bytes[0])));
+    } else if (valid && bytes[3] == 0x04 && bytes[0] == 2) {
+        m_writeUpper = (uchar(bytes[4]) << 8) | uchar(bytes[5]);
+    } else {
+        m_writeFailed = true;
+        answer(valid ? "E Unsupported record\r\n" : "E Bad record\r\n");
+        return;
+    }
+    answer("K\r\n");
+}
+
+void PicoEaseEmulator::answer(const QByteArray &lines)
+{
+    // Timers of equal intervals fire in the order they were started, so the
+    // answers keep theirs
+    QTimer::singleShot(m_latency, this, [this, lines]() {
+        if (!isOpen()) return;
+        m_output += lines;
+        emit readyRead();
+    });
+}
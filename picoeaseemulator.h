@@ -0,0 +1,54 @@
+#ifndef PICOEASEEMULATOR_H
+#define PICOEASEEMULATOR_H
+
+#include <QIODevice>
+#include <QHash>
+
+// Stands in for a PicoEASE with a target attached, so commands can be tried
+// and timed without hardware. It speaks the protocol of the serial port:
+//
+//   A <address> <length>   read, answered by Intel HEX data records
+//   B                      unlock, answered by "Lock:0"
+//   C <address> <length> <block>
+//                          CRC-32 of every block, one line of 8 hex digits each
+//   W <address> <length>   write, acknowledged by "K". Intel HEX records
+//                          follow, each acknowledged by "K" or refused by
+//                          "E <reason>", after which records are ignored.
+//                          The end record finishes the write.
+//
+// Every command ends with "Done". Answers arrive after a latency, like the
+// ones of the USB link. Target memory reads 0xff until it is written.
+class PicoEaseEmulator : public QIODevice
+{
+    Q_OBJECT
+public:
+    PicoEaseEmulator(QObject *parent = nullptr);
+
+    void setLatency(int ms) { m_latency = ms; }
+    QByteArray memory(qint64 address, qint64 length) const;
+
+    void close() override;
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    void handleCommand(const QByteArray &line);
+    void handleRecord(const QByteArray &line);
+    void answer(const QByteArray &lines);
+    void store(qint64 address, const QByteArray &data);
+
+    QByteArray m_input;                       ///< Partial line
+    QByteArray m_output;                      ///< Answers not read yet
+    QHash<qint64, QByteArray> m_pages;        ///< Written target memory, by page
+    int m_latency;
+
+    bool m_writing;                           ///< Records are expected
+    bool m_writeFailed;                       ///< Records are ignored up to the end record
+    qint64 m_writeUpper;                      ///< Upper address half from extended address records
+};
+
+#endif // PICOEASEEMULATOR_H
@@ -1,15 +1,28 @@
 
 #include "picoeasemodel.h"
+#include "chunks.h"
 #include <limits>
-#include <QBrush>
+#include <algorithm>
+#include <utility>
 #include <QDebug>
+#include <QStandardPaths>
 
 #define vLogPrint(x, argchain) AppendToLog(QStringLiteral(__FUNCTION__": ") + (x).argchain, System)
 #define LogPrint(x) AppendToLog((x), System)
 
-PicoEaseModel::PicoEaseModel(QObject* parent) : QObject(parent) {
+// Bytes read from the source of a write at once
+constexpr qint64 writeBufferSize = 0x1000;
+// Progress of writes is reported at most this often
+constexpr int writeProgressIntervalMs = 100;
+
+const QString PicoEaseModel::EmulatorPortName = QStringLiteral("PicoEASE Emulator");
+
+PicoEaseModel::PicoEaseModel(QObject* parent) : QObject(parent), m_io(&m_port), m_lastReadToken(0),
+    m_lastHookId(0), m_receiving(0), m_commandEndedPending(false),
+    m_pageCache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/pages") {
     connect(&m_port, &QIODevice::readyRead, this, &PicoEaseModel::SerialPortDataReceived);
     connect(&m_port, &QSerialPort::errorOccurred, this, &PicoEaseModel::SerialPortError);
+    connect(&m_emulator, &QIODevice::readyRead, this, &PicoEaseModel::SerialPortDataReceived);
 
     // AppendToLog("[TEST] System", System);
     // AppendToLog("[TEST] BulkCmd", BulkCmd);
@@ -18,15 +31,18 @@ PicoEaseModel::PicoEaseModel(QObject* parent) : QObject(parent) {
     ClearInternalState();
 }
 
-void PicoEaseModel::ClearLogs()
-{
-    m_logModel.removeRows(0, m_logModel.rowCount(), QModelIndex());
-}
-
 bool PicoEaseModel::ConnectPicoEaseSerialPort(QString portName)
 {
-    if (m_port.isOpen()) return false;
+    if (m_io->isOpen()) return false;
+
+    if (portName == EmulatorPortName) {
+        m_io = &m_emulator;
+        AppendToLog(tr("Connected to %1").arg(portName), System);
+        emit UpdateProgressMessage(tr("Ready"));
+        return m_emulator.open(QIODevice::ReadWrite);
+    }
 
+    m_io = &m_port;
     m_port.setPortName(portName);
     AppendToLog(tr("Connected to port %1").arg(portName), System);
 
@@ -47,18 +63,65 @@ bool PicoEaseModel::ConnectPicoEaseSerialPort(QString portName)
 
 void PicoEaseModel::DisconnectPicoEaseSerialPort()
 {
-    if (m_port.isOpen()) {
-        AppendToLog(tr("Disconnected from port %1").arg(m_port.portName()), System);
-        m_port.close();
+    if (m_io->isOpen()) {
+        AppendToLog(tr("Disconnected from port %1").arg(m_io == &m_emulator ? EmulatorPortName : m_port.portName()), System);
+        m_io->close();
+    }
+
+    // Background reads being done or queued fail, like a command of the user
+    bool commandEnded = IsBusy();
+    auto memoryReads = m_memoryReads;
+    if (IsBackgroundReadRunning()) {
+        memoryReads.prepend({ m_bulkCommandArgs["token"].toULongLong(), m_bulkCommandArgs["address"].toLongLong(), 0 });
+    }
+    m_memoryReads.clear();
+    bool writing = (m_busy && !m_manualCommand && m_currentBulkCommand == BCWriteRom) ||
+                   m_deferredBulkCommand == BCWriteRom;
+    QMap<QString, QVariant> checkArgs;
+    if (m_busy && !m_manualCommand && m_currentBulkCommand == BCBlockCrc) {
+        checkArgs = m_bulkCommandArgs;
+    } else if (m_deferredBulkCommand == BCBlockCrc) {
+        checkArgs = m_deferredBulkCommandArgs;
     }
 
-    // Clean states
+    // Clean states, lines still buffered belong to the commands ended here
+    if (m_receiving == 0) m_recvBuffer.clear();
+    m_writeSource.clear();
+    m_dumpTarget = nullptr;
+    m_dumpChecking = false;
     m_manualCommand = false;
     m_busy = false;
+    m_currentBulkCommand = BCNone;
+    if (!m_deferredManualCommand.isEmpty() || m_deferredBulkCommand != BCNone) {
+        m_deferredManualCommand.clear();
+        m_deferredBulkCommand = BCNone;
+        emit BulkCommandLockUi(false);
+    }
+
+    for (auto &&read : memoryReads) {
+        emit MemoryReadFinished(read.token, read.address, QByteArray());
+    }
+    if (writing) {
+        emit WriteRomFinished(false);
+    }
+    if (!checkArgs.isEmpty()) {
+        emit BlockCrcFinished(checkArgs["offset"].toString().toLongLong(nullptr, 16),
+                              checkArgs["block"].toString().toLongLong(nullptr, 16), {});
+    }
+    if (commandEnded) {
+        CommandEnded();
+    }
 }
 
 void PicoEaseModel::SendPicoEaseCommand(QString cmd)
 {
+    // Waits for a background read being done, ahead of the queued ones
+    if (IsBackgroundReadRunning() && m_deferredManualCommand.isEmpty() && !cmd.isEmpty()) {
+        emit BulkCommandLockUi(true);
+        m_deferredManualCommand = cmd;
+        return;
+    }
+
     if (m_busy || cmd.isEmpty()) {
         emit ManualCommandFinish();
         return;
@@ -69,11 +132,26 @@ void PicoEaseModel::SendPicoEaseCommand(QString cmd)
     AppendToLog(cmd.trimmed(), ManualCmd);
     m_manualCommand = true;
     m_busy = true;
-    m_port.write(cmd.toLatin1());
+    m_io->write(cmd.toLatin1());
+}
+
+bool PicoEaseModel::IsBusy() const
+{
+    // Background reads do not count, commands of the user run right after them
+    return (m_busy && (m_manualCommand || m_currentBulkCommand != BCReadMemory)) ||
+           !m_deferredManualCommand.isEmpty() || m_deferredBulkCommand != BCNone;
 }
 
 bool PicoEaseModel::IssueBulkCommand(BulkCommandType type, QMap<QString, QVariant> args)
 {
+    // Waits for a background read being done, ahead of the queued ones
+    if (IsBackgroundReadRunning() && m_deferredBulkCommand == BCNone && type != BCReadMemory) {
+        emit BulkCommandLockUi(true);
+        m_deferredBulkCommand = type;
+        m_deferredBulkCommandArgs = args;
+        return true;
+    }
+
     if (m_busy) {
         return false;
     }
@@ -84,15 +162,85 @@ bool PicoEaseModel::IssueBulkCommand(BulkCommandType type, QMap<QString, QVarian
         break;
     }
     case BCDumpRom: {
-        WriteBulkCommand(QString("A %1 %2\n").arg(args["offset"].toString(),
-                                                  args["length"].toString()));
-        m_memDumpBuffer.reserve(args["length"].toString().toInt(nullptr, 16));
+        m_memDumpLength = args["length"].toString().toLongLong(nullptr, 16);
+        if (m_dumpTarget) {
+            m_dumpTarget->resize(0);
+            m_dumpTarget->reserve(m_memDumpLength);
+        } else {
+            m_memDump.reset(new SparseImage);
+        }
+        args["cacheTarget"] = m_dumpCacheTarget;
+        m_dumpChecking = !m_dumpCacheTarget.isEmpty() && m_memDumpLength > 0;
+        if (m_dumpChecking) {
+            // Pages are read after their CRCs told, which ones are cached
+            m_blockCrcs.clear();
+            m_blockCrcCount = (m_memDumpLength + PageCache::PageSize - 1) / PageCache::PageSize;
+            m_dumpCachedPages.clear();
+            m_dumpPage = 0;
+            m_dumpCacheHits = 0;
+            m_dumpRunData.clear();
+            WriteBulkCommand(QString("C %1 %2 %3\n").arg(args["offset"].toString(), args["length"].toString())
+                                                      .arg(PageCache::PageSize, 0, 16));
+        } else {
+            WriteBulkCommand(QString("A %1 %2\n").arg(args["offset"].toString(),
+                                                      args["length"].toString()));
+        }
         emit UpdateProgressMessage(
             tr("Reading memory at %1 length %2").arg(args["offset"].toString(),
                                                      args["length"].toString()));
         emit UpdateProgressBar(true, 0, 1);
         break;
     }
+    case BCWriteRom: {
+        // Records are sent once PicoEASE acknowledged the command, one that
+        // does not know it would take them for commands
+        if (!m_writeSource || m_writeRanges.isEmpty()) return false;
+        m_writeLength = 0;
+        for (auto &&range : m_writeRanges) {
+            m_writeLength += range.second;
+        }
+        m_writeRange = 0;
+        m_writePos = m_writeRanges.first().first;
+        m_writeEnd = m_writePos + m_writeRanges.first().second;
+        m_writeAddress = m_writeBase + m_writePos;
+        m_writeAcked = 0;
+        m_writeUpper = -1;
+        m_writeBuffer.clear();
+        m_writeBufferPos = m_writePos;
+        m_writeInFlight.clear();
+        m_writeRecordSize = std::clamp(args["recordSize"].toInt(), 1, 255);
+        m_writeWindow = std::max(args["window"].toInt(), 1);
+        m_writeStarted = false;
+        m_writeEndSent = false;
+        m_writeError.clear();
+        WriteBulkCommand(QString("W %1 %2\n").arg(args["offset"].toString(),
+                                                  args["length"].toString()));
+        emit UpdateProgressMessage(
+            tr("Writing memory at %1 length %2").arg(args["offset"].toString(),
+                                                     args["length"].toString()));
+        emit UpdateProgressBar(true, 0, 1);
+        m_writeTimer.start();
+        m_writeProgressTime = 0;
+        break;
+    }
+    case BCBlockCrc: {
+        // PicoEASE answers with the CRC-32 of every block, so only blocks
+        // which differ need to be read
+        qint64 length = args["length"].toString().toLongLong(nullptr, 16);
+        qint64 block = args["block"].toString().toLongLong(nullptr, 16);
+        if (length <= 0 || block <= 0) return false;
+        WriteBulkCommand(QString("C %1 %2 %3\n").arg(args["offset"].toString(),
+                                                     args["length"].toString(),
+                                                     args["block"].toString()));
+        m_blockCrcs.clear();
+        m_blockCrcCount = (length + block - 1) / block;
+        emit UpdateProgressMessage(
+            tr("Checking memory at %1 length %2").arg(args["offset"].toString(),
+                                                      args["length"].toString()));
+        emit UpdateProgressBar(true, 0, m_blockCrcCount);
+        break;
+    }
+    case BCReadMemory:
     case BCNone:
     default:
         return false;
@@ -105,6 +253,128 @@ bool PicoEaseModel::IssueBulkCommand(BulkCommandType type, QMap<QString, QVarian
     return true;
 }
 
+bool PicoEaseModel::IssueWriteRom(Chunks *source, qint64 pos, qint64 length, qint64 address, int recordSize, int window)
+{
+    if (length <= 0) return false;
+    return IssueWriteRom(source, { { pos, length } }, address - pos, recordSize, window);
+}
+
+bool PicoEaseModel::IssueWriteRom(Chunks *source, const QVector<QPair<qint64, qint64>> &ranges, qint64 address,
+                                  int recordSize, int window)
+{
+    // There is one source, of the write being done or deferred
+    if (!source || ranges.isEmpty() || m_writeSource)
+        return false;
+
+    // The command announces the span of all ranges
+    qint64 begin = ranges.first().first;
+    qint64 end = ranges.last().first + ranges.last().second;
+    m_writeSource = source;
+    m_writeRanges = ranges;
+    m_writeBase = address;
+    bool ret = IssueBulkCommand(BCWriteRom, { {"offset", QString::number(address + begin, 16)},
+                                              {"length", QString::number(end - begin, 16)},
+                                              {"recordSize", recordSize},
+                                              {"window", window} });
+    if (!ret) m_writeSource.clear();
+    return ret;
+}
+
+bool PicoEaseModel::IssueDumpInto(qint64 address, qint64 length, QByteArray *buffer)
+{
+    // Kept while the dump is deferred, it is issued again then
+    if (IsBusy()) return false;
+    m_dumpTarget = buffer;
+    if (IssueBulkCommand(BCDumpRom, { {"offset", QString::number(address, 16)},
+                                      {"length", QString::number(length, 16)} })) return true;
+    m_dumpTarget = nullptr;
+    return false;
+}
+
+int PicoEaseModel::AddCommandEndedHook(std::function<void()> hook)
+{
+    m_commandEndedHooks.append({ ++m_lastHookId, std::move(hook) });
+    return m_lastHookId;
+}
+
+void PicoEaseModel::RemoveCommandEndedHook(int id)
+{
+    m_commandEndedHooks.removeIf([id](const auto &hook) { return hook.first == id; });
+}
+
+void PicoEaseModel::CommandEnded()
+{
+    if (m_receiving > 0) {
+        m_commandEndedPending = true;
+        return;
+    }
+    // Hooks may add or remove hooks, e.g. by destroying a PicoEaseAsync
+    QList<int> ids;
+    for (auto &&hook : m_commandEndedHooks) ids.append(hook.first);
+    for (int id : ids) {
+        auto it = std::find_if(m_commandEndedHooks.cbegin(), m_commandEndedHooks.cend(),
+                               [id](const auto &hook) { return hook.first == id; });
+        if (it == m_commandEndedHooks.cend()) continue;
+        auto hook = it->second;
+        hook();
+    }
+}
+
+quint64 PicoEaseModel::RequestMemoryRead(qint64 address, qint64 length)
+{
+    // Answered by MemoryReadFinished(), with empty data if it cannot be read
+    quint64 token = ++m_lastReadToken;
+    if (!m_io->isOpen() || length <= 0) {
+        QMetaObject::invokeMethod(this, [this, token, address]() {
+            emit MemoryReadFinished(token, address, QByteArray());
+        }, Qt::QueuedConnection);
+        return token;
+    }
+    m_memoryReads.append({ token, address, length });
+    StartNextQueuedCommand();
+    return token;
+}
+
+bool PicoEaseModel::IsBackgroundReadRunning()
+{
+    return m_busy && !m_manualCommand && m_currentBulkCommand == BCReadMemory;
+}
+
+void PicoEaseModel::StartNextQueuedCommand()
+{
+    // Commands of the user, deferred while a background read was done, go first
+    if (m_busy) return;
+    if (!m_deferredManualCommand.isEmpty()) {
+        auto cmd = m_deferredManualCommand;
+        m_deferredManualCommand.clear();
+        SendPicoEaseCommand(cmd);
+        return;
+    }
+    if (m_deferredBulkCommand != BCNone) {
+        auto type = m_deferredBulkCommand;
+        m_deferredBulkCommand = BCNone;
+        if (IssueBulkCommand(type, m_deferredBulkCommandArgs)) return;
+        emit BulkCommandLockUi(false);
+        if (type == BCWriteRom) {
+            m_writeSource.clear();
+            emit WriteRomFinished(false);
+        } else if (type == BCBlockCrc) {
+            emit BlockCrcFinished(m_deferredBulkCommandArgs["offset"].toString().toLongLong(nullptr, 16),
+                                  m_deferredBulkCommandArgs["block"].toString().toLongLong(nullptr, 16), {});
+        }
+    }
+
+    // Background reads neither lock the UI nor show progress
+    if (m_memoryReads.isEmpty()) return;
+
+    auto read = m_memoryReads.takeFirst();
+    m_busy = true;
+    m_currentBulkCommand = BCReadMemory;
+    m_bulkCommandArgs = { {"token", read.token}, {"address", read.address}, {"length", read.length} };
+    m_memoryRead.clear();
+    WriteBulkCommand(QString("A %1 %2\n").arg(read.address, 0, 16).arg(read.length, 0, 16));
+}
+
 void PicoEaseModel::SerialPortError(QSerialPort::SerialPortError err)
 {
     switch (err) {
@@ -131,15 +401,23 @@ void PicoEaseModel::SerialPortError(QSerialPort::SerialPortError err)
 
 void PicoEaseModel::SerialPortDataReceived()
 {
-    auto recvdData = m_port.readAll();
+    auto recvdData = m_io->readAll();
     m_recvBuffer.append(recvdData);
 
+    // Hooks wait for the lines received, so a flow they resume, which e.g.
+    // disconnects, does not leave lines to a closed model
+    m_receiving += 1;
     qsizetype eolPos;
-    while ((eolPos = m_recvBuffer.indexOf("\r\n")) != -1) {
+    while (m_io->isOpen() && (eolPos = m_recvBuffer.indexOf("\r\n")) != -1) {
         auto line = QByteArrayView(m_recvBuffer.data(), eolPos);
         HandleReturnData(line);
         m_recvBuffer.remove(0, eolPos + 2);
     }
+    m_receiving -= 1;
+    if (!m_io->isOpen() && m_receiving == 0) m_recvBuffer.clear();
+    if (m_receiving == 0 && std::exchange(m_commandEndedPending, false)) {
+        CommandEnded();
+    }
 }
 
 void PicoEaseModel::ClearInternalState()
@@ -147,34 +425,41 @@ void PicoEaseModel::ClearInternalState()
     m_busy = false;
     m_manualCommand = false;
     m_recvBuffer.clear();
-    m_memDumpBuffer.clear();
+    m_memoryReads.clear();
+    m_memoryRead.clear();
+    m_deferredManualCommand.clear();
+    m_deferredBulkCommand = BCNone;
+    m_writeSource.clear();
+    m_writeBuffer.clear();
+    m_writeInFlight.clear();
+    m_writeStarted = false;
+    m_writeEndSent = false;
+    m_blockCrcs.clear();
+    m_blockCrcCount = 0;
+    m_dumpChecking = false;
+    m_dumpCachedPages.clear();
+    m_dumpRunData.clear();
+    m_memDump.reset();
+    m_dumpTarget = nullptr;
+    m_memDumpLength = 0;
     m_currentBulkCommand = BCNone;
 }
 
 void PicoEaseModel::AppendToLog(QString text, LogType type)
 {
-    QColor color;
-    switch (type) {
-    case System: color = { 255, 255, 255 }; break;
-    case BulkCmd: color = { 160, 160, 255 }; break;
-    case ManualCmd: color = { 160, 255, 160 }; break;
-    case ReturnData: color = { 160, 160, 160 }; break;
-        break;
-    }
-
-    m_logModel.insertRow(m_logModel.rowCount());
-    auto index = m_logModel.index(m_logModel.rowCount() - 1);
-    m_logModel.setData(index, text);
-    m_logModel.setData(index, color, Qt::ForegroundRole);
-
-    if (m_logAutoscrollSignalEnabled) {
-        emit LogViewAutoscroll(); // This is stupid
-    }
+    emit LogAppended(text, type);
 }
 
 void PicoEaseModel::HandleReturnData(QByteArrayView retData)
 {
-    AppendToLog(QString::fromLatin1(retData), ReturnData);
+    // Background reads would flood the log with their records, writes with
+    // their acknowledgements, block checks with their CRCs
+    bool quiet = !m_manualCommand && (m_currentBulkCommand == BCReadMemory ||
+                                      (m_currentBulkCommand == BCWriteRom && retData == "K") ||
+                                      ((m_currentBulkCommand == BCBlockCrc || m_dumpChecking) && retData.size() == 8));
+    if (!quiet) {
+        AppendToLog(QString::fromLatin1(retData), ReturnData);
+    }
 
     if (retData == "Done") {
         if (m_manualCommand) {
@@ -182,6 +467,8 @@ void PicoEaseModel::HandleReturnData(QByteArrayView retData)
             m_busy = false;
             emit ManualCommandFinish();
             emit BulkCommandLockUi(false);
+            StartNextQueuedCommand();
+            CommandEnded();
         } else {
             BulkCommandFinish();
         }
@@ -195,7 +482,20 @@ void PicoEaseModel::HandleReturnData(QByteArrayView retData)
             BulkCommandHandleUnlockDevice(retData);
             break;
         case BCDumpRom:
-            BulkCommandHandleDumpRom(retData);
+            if (m_dumpChecking) {
+                BulkCommandHandleBlockCrc(retData);
+            } else {
+                BulkCommandHandleDumpRom(retData);
+            }
+            break;
+        case BCReadMemory:
+            BulkCommandHandleReadMemory(retData);
+            break;
+        case BCWriteRom:
+            BulkCommandHandleWriteRom(retData);
+            break;
+        case BCBlockCrc:
+            BulkCommandHandleBlockCrc(retData);
             break;
         case BCNone:
         default:
@@ -204,40 +504,117 @@ void PicoEaseModel::HandleReturnData(QByteArrayView retData)
     }
 }
 
-void PicoEaseModel::BulkCommandHandleDumpRom(QByteArrayView d)
+static int HexDigit(char c)
 {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+bool PicoEaseModel::DecodeIntelHexRecord(QByteArrayView d, QByteArray &data, bool append)
+{
+    // Decoded in place, records appended to a buffer with room allocate nothing
+    qsizetype begin = append ? data.size() : 0;
+    if (!append) data.clear();
     if (d.isEmpty() || d[0] != ':') {
         vLogPrint(tr("Invalid Intel HEX: %1"), arg(d.toByteArray()));
-        return;
+        return false;
     }
 
     // Remove colon and get real bytes
     d = d.sliced(1);
-    auto bytes = QByteArray::fromHex(d.toByteArray());
+    auto byteAt = [d](qsizetype idx) {
+        int high = HexDigit(d[2 * idx]), low = HexDigit(d[2 * idx + 1]);
+        return (high < 0 || low < 0) ? -1 : (high << 4 | low);
+    };
 
-    if (bytes.length() < 5) {
+    if (d.size() < 10) {
         vLogPrint(tr("Intel HEX record too short: %1"), arg(d.toByteArray()));
-        return;
+        return false;
+    }
+    int count = byteAt(0);
+    int type = byteAt(3);
+    if (count < 0 || type < 0) {
+        vLogPrint(tr("Malformed Intel HEX: invalid digits: %1"), arg(d.toByteArray()));
+        return false;
     }
 
-    switch (bytes[3]) {
-    case 0x00: // Data
-        if (bytes.length() != bytes[0] + 5) {
+    switch (type) {
+    case 0x00: { // Data
+        if (d.size() != (count + 5) * 2) {
             vLogPrint(tr("Malformed Intel HEX: invalid length: %1"), arg(d.toByteArray()));
-            return;
+            return false;
+        }
+        data.resize(begin + count);
+        char *dst = data.data() + begin;
+        for (int idx = 0; idx < count; idx++) {
+            int value = byteAt(4 + idx);
+            if (value < 0) {
+                data.resize(begin);
+                vLogPrint(tr("Malformed Intel HEX: invalid digits: %1"), arg(d.toByteArray()));
+                return false;
+            }
+            dst[idx] = char(value);
         }
-        m_memDumpBuffer.append(bytes.data() + 4, bytes[0]);
-        emit UpdateProgressBar(true, m_memDumpBuffer.size(), m_memDumpBuffer.capacity());
         break;
+    }
 
     case 0x01: break; // EOF
     case 0x02: break; // New Segment
     default:
         vLogPrint(tr("Unexpected Intel HEX readout record type: %1"), arg(d.toByteArray()));
+        return false;
+    }
+    return true;
+}
+
+QByteArray PicoEaseModel::EncodeIntelHexRecord(int type, quint16 address, const char *data, int length)
+{
+    QByteArray bytes;
+    bytes.reserve(length + 5);
+    bytes.append(char(length));
+    bytes.append(char(address >> 8));
+    bytes.append(char(address));
+    bytes.append(char(type));
+    if (length > 0) bytes.append(data, length);
+
+    uchar sum = 0;
+    for (char c : bytes) sum += uchar(c);
+    bytes.append(char(-sum));
+    return ':' + bytes.toHex().toUpper();
+}
+
+void PicoEaseModel::BulkCommandHandleDumpRom(QByteArrayView d)
+{
+    if (m_dumpTarget) {
+        qsizetype begin = m_dumpTarget->size();
+        if (!DecodeIntelHexRecord(d, *m_dumpTarget, true) || m_dumpTarget->size() == begin)
+            return;
+        emit UpdateProgressBar(true, m_dumpTarget->size(), m_memDumpLength);
+        if (!m_bulkCommandArgs["cacheTarget"].toString().isEmpty()) {
+            m_dumpRunData.append(m_dumpTarget->constData() + begin, m_dumpTarget->size() - begin);
+        }
+        return;
+    }
+
+    QByteArray data;
+    if (!DecodeIntelHexRecord(d, data) || data.isEmpty())
         return;
+
+    m_memDump->append(data);
+    emit DumpDataReceived(data);
+    emit UpdateProgressBar(true, m_memDump->size(), m_memDumpLength);
+    if (!m_bulkCommandArgs["cacheTarget"].toString().isEmpty()) {
+        m_dumpRunData.append(data);
     }
 }
 
+void PicoEaseModel::BulkCommandHandleReadMemory(QByteArrayView d)
+{
+    DecodeIntelHexRecord(d, m_memoryRead, true);
+}
+
 void PicoEaseModel::BulkCommandHandleUnlockDevice(QByteArrayView d)
 {
     auto str = QString::fromLatin1(d);
@@ -247,34 +624,235 @@ void PicoEaseModel::BulkCommandHandleUnlockDevice(QByteArrayView d)
     }
 }
 
+void PicoEaseModel::BulkCommandHandleWriteRom(QByteArrayView d)
+{
+    if (d == "K") {
+        if (!m_writeStarted) {
+            m_writeStarted = true;
+        } else if (!m_writeInFlight.isEmpty()) {
+            m_writeAcked += m_writeInFlight.dequeue();
+        }
+    } else if (d.startsWith('E')) {
+        if (m_writeError.isEmpty()) m_writeError = QString::fromLatin1(d.sliced(1)).trimmed();
+    } else {
+        return;
+    }
+
+    // Acknowledgements come for every record, the UI is updated less often
+    if (m_writeTimer.elapsed() - m_writeProgressTime >= writeProgressIntervalMs) {
+        m_writeProgressTime = m_writeTimer.elapsed();
+        emit UpdateProgressBar(true, m_writeAcked, m_writeLength);
+    }
+    SendWriteRecords();
+}
+
+void PicoEaseModel::BulkCommandHandleBlockCrc(QByteArrayView d)
+{
+    bool ok = false;
+    quint32 crc = d.size() == 8 ? QByteArray(d.data(), d.size()).toUInt(&ok, 16) : 0;
+    if (!ok) return;
+    m_blockCrcs.append(crc);
+    emit UpdateProgressBar(true, m_blockCrcs.size(), m_blockCrcCount);
+}
+
+void PicoEaseModel::SendWriteRecords()
+{
+    if (!m_writeStarted || m_writeEndSent) return;
+
+    QByteArray lines;
+    while (m_writeError.isEmpty() && m_writeInFlight.size() < m_writeWindow) {
+        if (m_writePos >= m_writeEnd) {
+            if (m_writeRange + 1 >= m_writeRanges.size()) break;
+            m_writeRange++;
+            m_writePos = m_writeRanges.at(m_writeRange).first;
+            m_writeEnd = m_writePos + m_writeRanges.at(m_writeRange).second;
+            m_writeAddress = m_writeBase + m_writePos;
+            continue;
+        }
+        if (!m_writeSource) {
+            m_writeError = tr("Source data was closed");
+            break;
+        }
+
+        qint64 upper = m_writeAddress >> 16;
+        if (upper != m_writeUpper) {
+            const char half[2] = { char(upper >> 8), char(upper) };
+            lines += EncodeIntelHexRecord(0x04, 0, half, 2) + '\n';
+            m_writeInFlight.enqueue(0);
+            m_writeUpper = upper;
+            continue;
+        }
+
+        // Records do not cross 64 KiB boundaries, their address would wrap
+        int count = int(std::min<qint64>({ m_writeRecordSize, m_writeEnd - m_writePos,
+                                           0x10000 - (m_writeAddress & 0xffff) }));
+        if (m_writePos < m_writeBufferPos || m_writePos + count > m_writeBufferPos + m_writeBuffer.size()) {
+            m_writeBufferPos = m_writePos;
+            m_writeBuffer = m_writeSource->data(m_writePos, std::min(writeBufferSize, m_writeEnd - m_writePos));
+            if (m_writeBuffer.size() < count) {
+                m_writeError = tr("Source data ended early");
+                break;
+            }
+        }
+        lines += EncodeIntelHexRecord(0x00, quint16(m_writeAddress),
+                                      m_writeBuffer.constData() + (m_writePos - m_writeBufferPos), count) + '\n';
+        m_writeInFlight.enqueue(count);
+        m_writePos += count;
+        m_writeAddress += count;
+    }
+
+    // PicoEASE answers the end record with "Done" after the records before it,
+    // after an error it ends the write right away
+    bool sent = m_writePos >= m_writeEnd && m_writeRange + 1 >= m_writeRanges.size();
+    if (!m_writeError.isEmpty() || sent) {
+        lines += EncodeIntelHexRecord(0x01, 0, nullptr, 0) + '\n';
+        m_writeEndSent = true;
+    }
+    if (!lines.isEmpty()) m_io->write(lines);
+}
+
 void PicoEaseModel::BulkCommandFinish()
 {
     Q_ASSERT(m_currentBulkCommand != BCNone && m_busy);
 
-    switch (m_currentBulkCommand) {
+    // Dumps through the cache go on with the pages, which are not cached
+    if (m_currentBulkCommand == BCDumpRom && ContinueCachedDump()) {
+        return;
+    }
+
+    auto command = m_currentBulkCommand;
+    m_busy = false;
+    m_currentBulkCommand = BCNone;
+
+    switch (command) {
     case BCNone:
         break;
     case BCUnlockTarget:
-        if (m_bulkCommandArgs.key("unlocked", 0).toInt() == 1) {
+        if (m_bulkCommandArgs.value("unlocked").toBool()) {
             AppendToLog("Unlock SUCCESSFUL.", System);
         } else {
             AppendToLog("Unlock may be UNSUCCESSFUL.", System);
         }
+        emit UnlockFinished(m_bulkCommandArgs.value("unlocked").toBool());
         break;
     case BCDumpRom:
-        emit UpdateDumpContentToUi(m_memDumpBuffer, m_bulkCommandArgs["offset"].toString().toULongLong(nullptr, 16));
+        if (m_dumpTarget) {
+            m_dumpTarget = nullptr;
+            break;
+        }
+        emit UpdateDumpContentToUi(m_memDump, m_bulkCommandArgs["offset"].toString().toULongLong(nullptr, 16));
+        m_memDump.reset();
+        break;
+    case BCReadMemory:
+        emit MemoryReadFinished(m_bulkCommandArgs["token"].toULongLong(), m_bulkCommandArgs["address"].toLongLong(),
+                                m_memoryRead);
+        m_memoryRead.clear();
+        break;
+    case BCWriteRom: {
+        // The time taken is logged, so record sizes and windows can be compared
+        qint64 length = m_writeLength;
+        if (m_writeError.isEmpty() && m_writeAcked < length) {
+            m_writeError = tr("%1 of %2 bytes acknowledged").arg(m_writeAcked).arg(length);
+        }
+        if (m_writeError.isEmpty()) {
+            qint64 ms = std::max<qint64>(m_writeTimer.elapsed(), 1);
+            AppendToLog(tr("Wrote %1 bytes in %2 ms, %3 KiB/s").arg(length).arg(ms)
+                            .arg(length * 1000.0 / 1024 / ms, 0, 'f', 1), System);
+        } else {
+            AppendToLog(tr("Write FAILED: %1").arg(m_writeError), System);
+        }
+        m_writeSource.clear();
+        m_writeBuffer.clear();
+        m_writeInFlight.clear();
+        emit WriteRomFinished(m_writeError.isEmpty());
+        break;
+    }
+    case BCBlockCrc: {
+        if (m_blockCrcs.size() != m_blockCrcCount) {
+            AppendToLog(tr("Block check FAILED: %1 of %2 CRCs received").arg(m_blockCrcs.size()).arg(m_blockCrcCount), System);
+            m_blockCrcs.clear();
+        }
+        emit BlockCrcFinished(m_bulkCommandArgs["offset"].toString().toLongLong(nullptr, 16),
+                              m_bulkCommandArgs["block"].toString().toLongLong(nullptr, 16), m_blockCrcs);
+        m_blockCrcs.clear();
         break;
     }
+    }
 
-    m_busy = false;
-    m_currentBulkCommand = BCNone;
-    emit BulkCommandLockUi(false);
-    emit UpdateProgressMessage(tr("Ready"));
-    emit UpdateProgressBar(false, 0, 1);
+    if (command != BCReadMemory) {
+        emit BulkCommandLockUi(false);
+        emit UpdateProgressMessage(tr("Ready"));
+        emit UpdateProgressBar(false, 0, 1);
+    }
+    StartNextQueuedCommand();
+    if (command != BCReadMemory) {
+        CommandEnded();
+    }
+}
+
+bool PicoEaseModel::ContinueCachedDump()
+{
+    auto target = m_bulkCommandArgs["cacheTarget"].toString();
+    if (target.isEmpty()) return false;
+
+    qint64 offset = m_bulkCommandArgs["offset"].toString().toLongLong(nullptr, 16);
+    qint64 pages = (m_memDumpLength + PageCache::PageSize - 1) / PageCache::PageSize;
+    if (m_dumpChecking) {
+        // Without CRCs, e.g. from an older PicoEASE, all pages are read
+        m_dumpChecking = false;
+        m_dumpCachedPages = QVector<QByteArray>(pages);
+        if (m_blockCrcs.size() == pages) {
+            for (qint64 page = 0; page < pages; page++) {
+                qint64 length = std::min(PageCache::PageSize, m_memDumpLength - page * PageCache::PageSize);
+                auto data = m_pageCache.lookup(target, offset + page * PageCache::PageSize, m_blockCrcs.at(page));
+                if (data.size() == length) m_dumpCachedPages[page] = data;
+            }
+        }
+        m_blockCrcs.clear();
+    } else {
+        // Pages just read go to the cache, of a short answer only the whole
+        // ones. It ends the dump.
+        bool complete = m_dumpRunData.size() >= m_dumpRunLength;
+        qint64 usable = complete ? m_dumpRunLength
+                                 : m_dumpRunData.size() / PageCache::PageSize * PageCache::PageSize;
+        for (qint64 stored = 0; stored < usable; stored += PageCache::PageSize) {
+            m_pageCache.store(target, m_dumpRunAddress + stored,
+                              m_dumpRunData.mid(stored, std::min(PageCache::PageSize, usable - stored)));
+        }
+        m_dumpRunData.clear();
+        if (!complete) return false;
+    }
+
+    // Cached pages are appended up to the next one, which is not
+    while (m_dumpPage < pages && !m_dumpCachedPages.at(m_dumpPage).isEmpty()) {
+        if (m_dumpTarget) {
+            m_dumpTarget->append(m_dumpCachedPages.at(m_dumpPage));
+        } else {
+            m_memDump->append(m_dumpCachedPages.at(m_dumpPage));
+            emit DumpDataReceived(m_dumpCachedPages.at(m_dumpPage));
+        }
+        m_dumpCachedPages[m_dumpPage].clear();
+        m_dumpPage++;
+        m_dumpCacheHits++;
+    }
+    emit UpdateProgressBar(true, m_dumpTarget ? m_dumpTarget->size() : m_memDump->size(), m_memDumpLength);
+    if (m_dumpPage >= pages) {
+        AppendToLog(tr("%1 of %2 pages taken from the cache").arg(m_dumpCacheHits).arg(pages), System);
+        return false;
+    }
+
+    qint64 first = m_dumpPage;
+    while (m_dumpPage < pages && m_dumpCachedPages.at(m_dumpPage).isEmpty()) {
+        m_dumpPage++;
+    }
+    m_dumpRunAddress = offset + first * PageCache::PageSize;
+    m_dumpRunLength = std::min(m_dumpPage * PageCache::PageSize, m_memDumpLength) - first * PageCache::PageSize;
+    WriteBulkCommand(QString("A %1 %2\n").arg(m_dumpRunAddress, 0, 16).arg(m_dumpRunLength, 0, 16));
+    return true;
 }
 
 void PicoEaseModel::WriteBulkCommand(QString s)
 {
     AppendToLog(s.trimmed(), BulkCmd);
-    m_port.write(s.toLatin1().trimmed());
+    m_io->write(s.toLatin1());
 }
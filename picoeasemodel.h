@@ -3,7 +3,16 @@
 
 #include <QObject>
 #include <QSerialPort>
-#include "coloredstringlistmodel.h"
+#include <QSharedPointer>
+#include <QPointer>
+#include <QQueue>
+#include <QElapsedTimer>
+#include <functional>
+#include "sparseimage.h"
+#include "picoeaseemulator.h"
+#include "pagecache.h"
+
+class Chunks;
 
 class PicoEaseModel : public QObject
 {
@@ -11,23 +20,74 @@ class PicoEaseModel : public QObject
 public:
     PicoEaseModel(QObject* parent = nullptr);
 
-    QStringListModel* LogModel() { return &m_logModel; }
-    void SetLogAutoscrollSignalEnabled(bool enabled) { m_logAutoscrollSignalEnabled = enabled; }
-    void ClearLogs();
+    static const QString EmulatorPortName; ///< Connects to a PicoEaseEmulator instead of a serial port
+
+    enum LogType { System, BulkCmd, ManualCmd, ReturnData, };
 
     bool ConnectPicoEaseSerialPort(QString portName);
     void DisconnectPicoEaseSerialPort();
+    bool IsConnected() const { return m_io->isOpen(); }
 
     void SendPicoEaseCommand(QString cmd);
+    /// A command of the user runs or waits for a background read, so another
+    /// one would be refused
+    bool IsBusy() const;
 
     enum BulkCommandType {
         BCNone,
         BCUnlockTarget,
         BCDumpRom,
+        BCReadMemory,
+        BCWriteRom,
+        BCBlockCrc,
     };
 
     bool IssueBulkCommand(BulkCommandType type, QMap<QString, QVariant> args = QMap<QString, QVariant>());
 
+    /// Dumps ask for the CRC-32 of every page first and take the pages cached
+    /// for this target type from disk, an empty target disables the cache
+    void SetDumpCacheTarget(QString target) { m_dumpCacheTarget = target; }
+    /// Latency of the answers of the emulator, e.g. to time writes over
+    /// links slower than USB
+    void SetEmulatorLatency(int ms) { m_emulator.setLatency(ms); }
+
+    /// Reads target memory in the background, e.g. pages of a live view or
+    /// watched ranges. Reads are queued behind other commands and answered by
+    /// MemoryReadFinished(), which echoes the token returned. It comes from
+    /// the event loop, also for reads failing at once, so the token is known by
+    /// then. Commands of the user, which are issued while a background read is
+    /// done, run right after it, ahead of queued reads.
+    quint64 RequestMemoryRead(qint64 address, qint64 length);
+
+    /// Writes length bytes of source from pos on to target memory at address.
+    /// They are streamed as Intel HEX records of recordSize data bytes, at most
+    /// window of them unacknowledged, so the link does not idle waiting for
+    /// each acknowledgement. source must stay unchanged until WriteRomFinished().
+    bool IssueWriteRom(Chunks *source, qint64 pos, qint64 length, qint64 address,
+                       int recordSize = 32, int window = 8);
+    /// Writes the ranges (position and length, ascending) of source in one go,
+    /// each to address plus its position
+    bool IssueWriteRom(Chunks *source, const QVector<QPair<qint64, qint64>> &ranges, qint64 address,
+                       int recordSize = 32, int window = 8);
+
+    /// Dumps like BCDumpRom, through the page cache, but decodes the records
+    /// straight into buffer, which is resized to the bytes read and keeps its
+    /// capacity. No image is built and no DumpDataReceived() nor
+    /// UpdateDumpContentToUi() is emitted. buffer must stay alive until the
+    /// command ended, which only the command ended hooks tell.
+    bool IssueDumpInto(qint64 address, qint64 length, QByteArray *buffer);
+
+    /// Hooks are called when a command of the user ended, also by a
+    /// disconnect, after its signals. While answers are handled, they wait for
+    /// the last line received and queued commands to start. PicoEaseAsync
+    /// issues the next command of a flow from one, so it follows without a
+    /// detour through the event loop. Returns the id to remove the hook by.
+    int AddCommandEndedHook(std::function<void()> hook);
+    void RemoveCommandEndedHook(int id);
+
+    /// Intel HEX record without line end
+    static QByteArray EncodeIntelHexRecord(int type, quint16 address, const char *data, int length);
+
 signals:
     void SerialPortUnexpectedDisconnection();
 
@@ -35,9 +95,15 @@ signals:
     void BulkCommandLockUi(bool setLocked);
     void UpdateProgressMessage(QString);
     void UpdateProgressBar(bool enabled, int value, int maximum);
-    void LogViewAutoscroll();
+    void LogAppended(QString text, PicoEaseModel::LogType type); ///< Shown by whoever wants a log, e.g. MainWindow
 
-    void UpdateDumpContentToUi(QByteArray content, size_t offset);
+    void UpdateDumpContentToUi(QSharedPointer<SparseImage> content, size_t offset);
+    void DumpDataReceived(QByteArray data); ///< Bytes of a dump in order as they arrive, e.g. to stream them to a file
+    void MemoryReadFinished(quint64 token, qint64 address, QByteArray data); ///< data is empty if the read failed
+    void UnlockFinished(bool unlocked);
+    void WriteRomFinished(bool ok); ///< Ends writes issued by IssueWriteRom(), also if they never ran
+    /// CRC-32 of each block of BCBlockCrc, crcs is empty if it failed
+    void BlockCrcFinished(qint64 address, qint64 blockSize, QVector<quint32> crcs);
 
 private slots:
     void SerialPortError(QSerialPort::SerialPortError);
@@ -45,36 +111,92 @@ private slots:
 
 private:
     void ClearInternalState();
+    void CommandEnded(); ///< Calls the hooks, once SerialPortDataReceived() handled its lines
 
-    enum LogType { System, BulkCmd, ManualCmd, ReturnData, };
     void AppendToLog(QString text, LogType type);
     void HandleReturnData(QByteArrayView retData);
+    /// data gets the bytes of data records, appended to it if append is set
+    bool DecodeIntelHexRecord(QByteArrayView d, QByteArray &data, bool append = false);
+    bool IsBackgroundReadRunning();
+    void StartNextQueuedCommand(); ///< Deferred user commands first, then background reads
 
     // Bulk commands (Commands that are issued programatically, typically used to
     // read/write much more data than typing in commands manually, but not all of them are)
     // Related functions
     // Return data handlers for different functions
     void BulkCommandHandleDumpRom(QByteArrayView d);
+    void BulkCommandHandleReadMemory(QByteArrayView d);
     void BulkCommandHandleUnlockDevice(QByteArrayView d);
+    void BulkCommandHandleWriteRom(QByteArrayView d);
+    void BulkCommandHandleBlockCrc(QByteArrayView d);
+    void SendWriteRecords(); ///< Fills the window of unacknowledged records
     // Finish handler
     void BulkCommandFinish();
+    bool ContinueCachedDump(); ///< Reads the next pages of a dump not cached, false if there are none
     void WriteBulkCommand(QString s); ///< This merely commands PicoEASE and logs to window
 
 private:
     QSerialPort m_port;
-    ColoredStringListModel m_logModel;
+    PicoEaseEmulator m_emulator;
+    QIODevice *m_io; ///< m_port or m_emulator, whichever is connected
     QByteArray m_recvBuffer;
 
-    QByteArray m_memDumpBuffer;
+    QSharedPointer<SparseImage> m_memDump; ///< Dump being read, erased regions are kept as fill extents
+    QByteArray *m_dumpTarget; ///< Buffer of IssueDumpInto() replacing m_memDump, nullptr if none
+    qint64 m_memDumpLength; ///< Bytes requested by the dump command
+
+    PageCache m_pageCache;
+    QString m_dumpCacheTarget;
+    bool m_dumpChecking; ///< Dump is getting the CRCs of its pages
+    QVector<QByteArray> m_dumpCachedPages; ///< Pages of the dump found in the cache, empty if not
+    qint64 m_dumpPage; ///< Next page of the dump to append
+    qint64 m_dumpCacheHits;
+    qint64 m_dumpRunAddress; ///< Pages not cached, being read
+    qint64 m_dumpRunLength;
+    QByteArray m_dumpRunData;
+
+    struct MemoryRead { quint64 token; qint64 address; qint64 length; };
+    QList<MemoryRead> m_memoryReads; ///< Queued background reads
+    quint64 m_lastReadToken; ///< Of the last RequestMemoryRead()
+    QByteArray m_memoryRead; ///< Background read being received
+    QString m_deferredManualCommand; ///< Issued while a background read was done
+    BulkCommandType m_deferredBulkCommand; ///< Issued while a background read was done
+    QMap<QString, QVariant> m_deferredBulkCommandArgs;
+
+    QPointer<Chunks> m_writeSource; ///< Data of the write being done
+    QVector<QPair<qint64, qint64>> m_writeRanges; ///< Positions and lengths in m_writeSource
+    qint64 m_writeBase; ///< Target address of position 0 of m_writeSource
+    qint64 m_writeLength; ///< Bytes of all m_writeRanges
+    int m_writeRange; ///< Range being sent
+    qint64 m_writePos; ///< Next byte of m_writeSource to send
+    qint64 m_writeEnd; ///< End of the range being sent
+    qint64 m_writeAddress; ///< Target address of m_writePos
+    qint64 m_writeAcked; ///< Bytes acknowledged by PicoEASE
+    qint64 m_writeUpper; ///< Upper address half last sent, -1 if none
+    QByteArray m_writeBuffer; ///< Read ahead from m_writeSource
+    qint64 m_writeBufferPos; ///< Position of m_writeBuffer in m_writeSource
+    QQueue<int> m_writeInFlight; ///< Data bytes of each unacknowledged line
+    int m_writeRecordSize;
+    int m_writeWindow;
+    bool m_writeStarted; ///< PicoEASE acknowledged the write command, records may follow
+    bool m_writeEndSent;
+    QString m_writeError; ///< Reason PicoEASE refused a record
+    QElapsedTimer m_writeTimer;
+    qint64 m_writeProgressTime; ///< m_writeTimer time of the last progress update
+
+    QVector<quint32> m_blockCrcs; ///< Received by BCBlockCrc so far
+    qint64 m_blockCrcCount; ///< Blocks requested by BCBlockCrc
 
     bool m_busy; ///< Is PicoEASE busy running a command (bulk OR manual)
     bool m_manualCommand; ///< Is PicoEASE executing a manual command. (busy && !manual) == bulk
 
+    QList<QPair<int, std::function<void()>>> m_commandEndedHooks; ///< By id
+    int m_lastHookId;
+    int m_receiving; ///< SerialPortDataReceived() calls handling lines
+    bool m_commandEndedPending; ///< The hooks are called when these are done
+
     BulkCommandType m_currentBulkCommand;
     QMap<QString, QVariant> m_bulkCommandArgs; ///< Just something in case we need
-
-    // Junk
-    bool m_logAutoscrollSignalEnabled;
 };
 
 #endif // PICOEASEMODEL_H
@@ -0,0 +1,323 @@
+#include "bindiff.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define BINDIFF_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define BINDIFF_NEON
+#endif
+
+#define BUFFER_SIZE 0x100000
+#define SYNC_LENGTH 16          // equal bytes, which end a difference
+#define RESYNC_WINDOW 0x1000    // largest insertion or removal found by resync
+
+
+// ***************************************** Kernels
+
+qint64 BinDiff::mismatch(const char *a, const char *b, qint64 len)
+{
+    qint64 idx = 0;
+#if defined(BINDIFF_SSE2)
+    // 4 vectors per step, the differing one is only looked for on a hit
+    for (; idx + 64 <= len; idx += 64)
+    {
+        __m128i eq[4];
+        for (int q = 0; q < 4; q++)
+            eq[q] = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + idx + 16 * q)),
+                                   _mm_loadu_si128((const __m128i *)(b + idx + 16 * q)));
+        __m128i all = _mm_and_si128(_mm_and_si128(eq[0], eq[1]), _mm_and_si128(eq[2], eq[3]));
+        if (_mm_movemask_epi8(all) == 0xffff)
+            continue;
+        for (int q = 0; q < 4; q++)
+        {
+            uint mask = (uint)_mm_movemask_epi8(eq[q]) ^ 0xffff;
+            if (mask)
+                return idx + 16 * q + qCountTrailingZeroBits(mask);
+        }
+    }
+#elif defined(BINDIFF_NEON)
+    for (; idx + 64 <= len; idx += 64)
+    {
+        uint8x16_t all = vceqq_u8(vld1q_u8((const uint8_t *)(a + idx)), vld1q_u8((const uint8_t *)(b + idx)));
+        for (int q = 1; q < 4; q++)
+            all = vandq_u8(all, vceqq_u8(vld1q_u8((const uint8_t *)(a + idx + 16 * q)),
+                                         vld1q_u8((const uint8_t *)(b + idx + 16 * q))));
+        if (vminvq_u8(all) != 0xff)
+            break;
+    }
+#endif
+    for (; idx < len; idx++)
+        if (a[idx] != b[idx])
+            return idx;
+    return len;
+}
+
+qint64 BinDiff::match(const char *a, const char *b, qint64 len)
+{
+    qint64 idx = 0;
+#if defined(BINDIFF_SSE2)
+    for (; idx + 64 <= len; idx += 64)
+    {
+        __m128i eq[4];
+        for (int q = 0; q < 4; q++)
+            eq[q] = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + idx + 16 * q)),
+                                   _mm_loadu_si128((const __m128i *)(b + idx + 16 * q)));
+        __m128i any = _mm_or_si128(_mm_or_si128(eq[0], eq[1]), _mm_or_si128(eq[2], eq[3]));
+        if (_mm_movemask_epi8(any) == 0)
+            continue;
+        for (int q = 0; q < 4; q++)
+        {
+            uint mask = (uint)_mm_movemask_epi8(eq[q]);
+            if (mask)
+                return idx + 16 * q + qCountTrailingZeroBits(mask);
+        }
+    }
+#elif defined(BINDIFF_NEON)
+    for (; idx + 64 <= len; idx += 64)
+    {
+        uint8x16_t any = vceqq_u8(vld1q_u8((const uint8_t *)(a + idx)), vld1q_u8((const uint8_t *)(b + idx)));
+        for (int q = 1; q < 4; q++)
+            any = vorrq_u8(any, vceqq_u8(vld1q_u8((const uint8_t *)(a + idx + 16 * q)),
+                                         vld1q_u8((const uint8_t *)(b + idx + 16 * q))));
+        if (vmaxvq_u8(any) != 0)
+            break;
+    }
+#endif
+    for (; idx < len; idx++)
+        if (a[idx] == b[idx])
+            return idx;
+    return len;
+}
+
+QVector<QPair<qint64, qint64>> BinDiff::changes(const char *a, const char *b, qint64 len)
+{
+    QVector<QPair<qint64, qint64>> runs;
+    qint64 pos = 0;
+    while (pos < len)
+    {
+        pos += mismatch(a + pos, b + pos, len - pos);
+        if (pos >= len)
+            break;
+        qint64 end = pos + match(a + pos, b + pos, len - pos);
+        runs.append(qMakePair(pos, end - pos));
+        pos = end;
+    }
+    return runs;
+}
+
+
+// ***************************************** Compare
+
+// Buffered reader, so the many short reads around differences do not copy
+// a new buffer out of Chunks each time
+struct DiffReader
+{
+    Chunks &chunks;
+    qint64 size;
+    QByteArray buffer;
+    qint64 bufferPos;
+
+    DiffReader(Chunks &chunks) : chunks(chunks), size(chunks.size()), bufferPos(0) {}
+
+    // Data at pos, *available bytes of it are buffered. These are at least
+    // need, unless the image ends before.
+    const char *data(qint64 pos, qint64 need, qint64 *available)
+    {
+        qint64 bufferEnd = bufferPos + buffer.size();
+        if ((pos < bufferPos) || ((pos + std::min(need, size - pos)) > bufferEnd))
+        {
+            buffer = chunks.data(pos, std::max<qint64>(need, BUFFER_SIZE));
+            bufferPos = pos;
+            bufferEnd = pos + buffer.size();
+        }
+        *available = bufferEnd - pos;
+        return buffer.constData() + (pos - bufferPos);
+    }
+};
+
+// Length of the difference at posA and posB without shifting the images.
+// Runs of equal bytes reaching the end of both images end it as well.
+static qint64 alignedEnd(DiffReader &a, DiffReader &b, qint64 posA, qint64 posB)
+{
+    qint64 limit = std::min(a.size - posA, b.size - posB);
+    qint64 offset = 1;
+    while (offset < limit)
+    {
+        qint64 availableA, availableB;
+        const char *dataA = a.data(posA + offset, SYNC_LENGTH, &availableA);
+        const char *dataB = b.data(posB + offset, SYNC_LENGTH, &availableB);
+        qint64 len = std::min(std::min(availableA, availableB), limit - offset);
+        qint64 starts = (offset + len == limit) ? len : len - SYNC_LENGTH + 1;
+        qint64 idx = 0;
+        while (idx < starts)
+        {
+            idx += BinDiff::match(dataA + idx, dataB + idx, starts - idx);
+            if (idx >= starts)
+                break;
+            qint64 run = BinDiff::mismatch(dataA + idx, dataB + idx, len - idx);
+            if ((run >= SYNC_LENGTH) || (offset + idx + run == limit))
+                return offset + idx;
+            idx += run;
+        }
+        offset += starts;
+    }
+    return limit;
+}
+
+static void append(QVector<BinDiff::Range> &ranges, const BinDiff::Range &range)
+{
+    if (!ranges.isEmpty())
+    {
+        BinDiff::Range &last = ranges.last();
+        if ((last.posA + last.lenA == range.posA) && (last.posB + last.lenB == range.posB))
+        {
+            last.lenA += range.lenA;
+            last.lenB += range.lenB;
+            return;
+        }
+    }
+    ranges.append(range);
+}
+
+bool BinDiff::compare(Chunks &a, Chunks &b, bool resync, QVector<Range> &ranges,
+                      const Chunks::ProgressFunction &progress)
+{
+    ranges.clear();
+    DiffReader readerA(a);
+    DiffReader readerB(b);
+
+    // Blocks, whose hashes are equal in both trees, are equal while the
+    // images are not shifted against each other. Trees of another size than
+    // the images read are not used.
+    QVector<qint64> differing;
+    bool skipBlocks = a.merkleTreeEnabled() && b.merkleTreeEnabled();
+    if (skipBlocks)
+    {
+        MerkleTree treeA = a.merkleTree();
+        MerkleTree treeB = b.merkleTree();
+        skipBlocks = (treeA.size() == readerA.size) && (treeB.size() == readerB.size);
+        if (skipBlocks)
+            differing = MerkleTree::differingBlocks(treeA, treeB);
+    }
+
+    qint64 posA = 0;
+    qint64 posB = 0;
+    qint64 reported = -BUFFER_SIZE;
+    while ((posA < readerA.size) && (posB < readerB.size))
+    {
+        if (progress && (posA - reported >= BUFFER_SIZE))
+        {
+            if (!progress(posA))
+                return false;
+            reported = posA;
+        }
+
+        // skip equal blocks up to the next differing one, which is compared
+        // up to its end
+        qint64 blockEnd = -1;
+        if (skipBlocks && (posA == posB))
+        {
+            qint64 block = posA / MerkleTree::BlockSize;
+            auto it = std::lower_bound(differing.cbegin(), differing.cend(), block);
+            if ((it == differing.cend()) || (*it > block))
+            {
+                qint64 next = (it == differing.cend()) ? readerA.size : *it * MerkleTree::BlockSize;
+                posA = posB = std::min(next, std::min(readerA.size, readerB.size));
+                continue;
+            }
+            blockEnd = (block + 1) * MerkleTree::BlockSize;
+        }
+
+        // skip the equal part
+        qint64 availableA, availableB;
+        const char *dataA = readerA.data(posA, 1, &availableA);
+        const char *dataB = readerB.data(posB, 1, &availableB);
+        qint64 len = std::min(availableA, availableB);
+        if (blockEnd >= 0)
+            len = std::min(len, blockEnd - posA);
+        if (len <= 0)
+            break;
+        qint64 equal = mismatch(dataA, dataB, len);
+        posA += equal;
+        posB += equal;
+        if (equal == len)
+            continue;
+
+        // Shifts are tried in the order of their size, at equal size the
+        // replacement first, then an insertion into b or a removal from a
+        Range range{posA, -1, posB, -1};
+        if (resync)
+        {
+            const char *winA = readerA.data(posA, RESYNC_WINDOW + SYNC_LENGTH, &availableA);
+            const char *winB = readerB.data(posB, RESYNC_WINDOW + SYNC_LENGTH, &availableB);
+            for (qint64 shift = 1; (shift <= RESYNC_WINDOW) && (range.lenA < 0); shift++)
+            {
+                const qint64 candidates[3][2] = { { shift, shift }, { 0, shift }, { shift, 0 } };
+                for (auto &candidate : candidates)
+                {
+                    if ((availableA - candidate[0] < SYNC_LENGTH) || (availableB - candidate[1] < SYNC_LENGTH))
+                        continue;
+                    if (mismatch(winA + candidate[0], winB + candidate[1], SYNC_LENGTH) == SYNC_LENGTH)
+                    {
+                        range.lenA = candidate[0];
+                        range.lenB = candidate[1];
+                        break;
+                    }
+                }
+            }
+        }
+        if (range.lenA < 0)
+            range.lenA = range.lenB = alignedEnd(readerA, readerB, posA, posB);
+        append(ranges, range);
+        posA += range.lenA;
+        posB += range.lenB;
+    }
+    if ((posA < readerA.size) || (posB < readerB.size))
+        append(ranges, Range{posA, readerA.size - posA, posB, readerB.size - posB});
+    return true;
+}
+
+
+// ***************************************** Navigation
+
+qint64 BinDiff::mapToB(const QVector<Range> &ranges, qint64 posA)
+{
+    auto it = std::upper_bound(ranges.cbegin(), ranges.cend(), posA,
+                               [](qint64 pos, const Range &range) { return pos < range.posA; });
+    if (it == ranges.cbegin())
+        return posA;
+    const Range &range = *(it - 1);
+    if (posA < range.posA + range.lenA)
+        return range.posB + std::min(posA - range.posA, range.lenB);
+    return range.posB + range.lenB + (posA - range.posA - range.lenA);
+}
+
+qint64 BinDiff::mapToA(const QVector<Range> &ranges, qint64 posB)
+{
+    auto it = std::upper_bound(ranges.cbegin(), ranges.cend(), posB,
+                               [](qint64 pos, const Range &range) { return pos < range.posB; });
+    if (it == ranges.cbegin())
+        return posB;
+    const Range &range = *(it - 1);
+    if (posB < range.posB + range.lenB)
+        return range.posA + std::min(posB - range.posB, range.lenA);
+    return range.posA + range.lenA + (posB - range.posB - range.lenB);
+}
+
+int BinDiff::nextRange(const QVector<Range> &ranges, qint64 pos, bool inB)
+{
+    auto it = std::upper_bound(ranges.cbegin(), ranges.cend(), pos, [inB](qint64 pos, const Range &range) {
+        return pos < (inB ? range.posB : range.posA);
+    });
+    return (it == ranges.cend()) ? -1 : int(it - ranges.cbegin());
+}
+
+int BinDiff::previousRange(const QVector<Range> &ranges, qint64 pos, bool inB)
+{
+    auto it = std::lower_bound(ranges.cbegin(), ranges.cend(), pos, [inB](const Range &range, qint64 pos) {
+        return (inB ? range.posB : range.posA) < pos;
+    });
+    return int(it - ranges.cbegin()) - 1;
+}
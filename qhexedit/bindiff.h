@@ -0,0 +1,64 @@
+#ifndef BINDIFF_H
+#define BINDIFF_H
+
+/** \cond docNever */
+
+/*! BinDiff compares two images held by Chunks and lists the ranges, in which
+ * they differ.
+ *
+ * Both images are read block by block side by side. Equal parts are skipped
+ * with a SIMD compare (SSE2 or NEON, 64 bytes per step). If both Chunks keep
+ * a MerkleTree, blocks with equal hashes at equal positions are skipped
+ * without being read, so comparing again after a few edits only reads the
+ * blocks these touched. A difference ends,
+ * where both images are equal again for at least SYNC_LENGTH bytes, so a
+ * single byte, which happens to be equal, does not split it.
+ *
+ * Without resynchronization the images are compared byte by byte at equal
+ * positions, a length difference is one range at the end. With it, bytes
+ * inserted into or removed from one image are detected, as long as the
+ * images get equal again within RESYNC_WINDOW bytes: the ranges then have
+ * different lengths in both images and everything behind them is compared
+ * shifted.
+ */
+
+#include <QtCore>
+
+#include "chunks.h"
+
+class BinDiff
+{
+public:
+    struct Range
+    {
+        qint64 posA;
+        qint64 lenA;
+        qint64 posB;
+        qint64 lenB;
+    };
+
+    // Fills ranges with the differences of a and b, sorted by position.
+    // Returns false if progress (called with positions in a) cancels.
+    static bool compare(Chunks &a, Chunks &b, bool resync, QVector<Range> &ranges,
+                        const Chunks::ProgressFunction &progress=Chunks::ProgressFunction());
+
+    // Kernels: index of the first differing (first equal) byte, len if none
+    static qint64 mismatch(const char *a, const char *b, qint64 len);
+    static qint64 match(const char *a, const char *b, qint64 len);
+
+    // Runs of differing bytes in two buffers of len bytes, as position and length
+    static QVector<QPair<qint64, qint64>> changes(const char *a, const char *b, qint64 len);
+
+    // Position in the other image, which corresponds to pos
+    static qint64 mapToB(const QVector<Range> &ranges, qint64 posA);
+    static qint64 mapToA(const QVector<Range> &ranges, qint64 posB);
+
+    // Index of the first range starting behind (last range starting in front
+    // of) pos in image a or b, -1 if there is none
+    static int nextRange(const QVector<Range> &ranges, qint64 pos, bool inB=false);
+    static int previousRange(const QVector<Range> &ranges, qint64 pos, bool inB=false);
+};
+
+/** \endcond docNever */
+
+#endif // BINDIFF_H
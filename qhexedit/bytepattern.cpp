@@ -0,0 +1,550 @@
+#include "bytepattern.h"
+#include <algorithm>
+#include <ctype.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#define MAX_POSITIONS 4096
+#define MAX_REPEAT 1024
+#define MAX_DFA_STATES 4096
+#define MAX_DFA_POSITIONS 256                   // larger patterns are simulated, subsets of them take too long
+
+
+// ***************************************** Private data
+
+struct BytePatternPrivate
+{
+    QString error;
+    int positions = 0;
+    int words = 0;                              // quint64 words per position set
+    int minLength = 0;
+    int maxLength = 0;
+
+    std::vector<quint64> first;                 // positions, which may start a match
+    std::vector<quint64> last;                  // positions, which may end a match
+    std::vector<quint64> follow;                // positions * words, successors of each position
+    std::vector<quint64> byteMask;              // 256 * words, positions accepting a byte value
+
+    // Deterministic form, empty if the automaton got too big. Built by the
+    // first Matcher, so it costs the search worker and not the caller.
+    mutable std::once_flag dfaOnce;
+    mutable std::vector<qint32> dfa;            // states * 256 transitions, state 0 is the start
+    mutable std::vector<char> accepting;
+
+    // next = (follow(active) | (restart ? first : 0)) & byteMask[b]
+    void step(const quint64 *active, quint64 *next, uchar b, bool restart) const
+    {
+        std::fill(next, next + words, 0);
+        for (int w=0; w < words; w++)
+        {
+            quint64 bits = active[w];
+            while (bits)
+            {
+                int p = w * 64 + qCountTrailingZeroBits(bits);
+                bits &= bits - 1;
+                const quint64 *f = &follow[(size_t)p * words];
+                for (int i=0; i < words; i++)
+                    next[i] |= f[i];
+            }
+        }
+        const quint64 *m = &byteMask[(size_t)b * words];
+        for (int i=0; i < words; i++)
+            next[i] = (next[i] | (restart ? first[i] : 0)) & m[i];
+    }
+
+    bool isAccepting(const quint64 *active) const
+    {
+        for (int i=0; i < words; i++)
+            if (active[i] & last[i])
+                return true;
+        return false;
+    }
+
+    bool isEmpty(const quint64 *active) const
+    {
+        for (int i=0; i < words; i++)
+            if (active[i])
+                return false;
+        return true;
+    }
+};
+
+
+// ***************************************** Parser
+
+namespace {
+
+// Glushkov sets of a parsed sub expression
+struct Fragment
+{
+    bool nullable = true;
+    std::vector<int> first;
+    std::vector<int> last;
+    int minLength = 0;
+    int maxLength = 0;
+};
+
+class Parser
+{
+public:
+    explicit Parser(const QByteArray &text) : _text(text), _idx(0) {}
+
+    bool parse(Fragment &result)
+    {
+        result = parseAlternatives();
+        skipSpace();
+        if (_error.isEmpty() && _idx < _text.size())
+            fail(QObject::tr("Unexpected '%1'").arg(QChar(_text.at(_idx))));
+        if (_error.isEmpty() && result.nullable)
+            fail(QObject::tr("Pattern matches empty data"));
+        return _error.isEmpty();
+    }
+
+    QString error() const { return _error; }
+
+    std::vector<uchar> values;                  // per position
+    std::vector<uchar> masks;                   // per position
+    std::vector<std::vector<int>> follow;       // per position
+
+private:
+    void fail(const QString &msg)
+    {
+        if (_error.isEmpty())
+            _error = QObject::tr("%1 at column %2").arg(msg).arg(_idx + 1);
+    }
+
+    void skipSpace()
+    {
+        while (_idx < _text.size() && isspace((uchar)_text.at(_idx)))
+            _idx += 1;
+    }
+
+    char peek()
+    {
+        skipSpace();
+        return _idx < _text.size() ? _text.at(_idx) : '\0';
+    }
+
+    static int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    Fragment leaf(uchar value, uchar mask)
+    {
+        int p = (int)values.size();
+        if (p >= MAX_POSITIONS)
+        {
+            fail(QObject::tr("Pattern too large"));
+            return Fragment();
+        }
+        values.push_back(value & mask);
+        masks.push_back(mask);
+        follow.emplace_back();
+        Fragment f;
+        f.nullable = false;
+        f.first.push_back(p);
+        f.last.push_back(p);
+        f.minLength = 1;
+        f.maxLength = 1;
+        return f;
+    }
+
+    Fragment concat(const Fragment &a, const Fragment &b)
+    {
+        for (int p : a.last)
+            follow[p].insert(follow[p].end(), b.first.begin(), b.first.end());
+        Fragment f;
+        f.nullable = a.nullable && b.nullable;
+        f.first = a.first;
+        if (a.nullable)
+            f.first.insert(f.first.end(), b.first.begin(), b.first.end());
+        f.last = b.last;
+        if (b.nullable)
+            f.last.insert(f.last.end(), a.last.begin(), a.last.end());
+        f.minLength = a.minLength + b.minLength;
+        f.maxLength = a.maxLength + b.maxLength;
+        return f;
+    }
+
+    static Fragment alternate(const Fragment &a, const Fragment &b)
+    {
+        Fragment f;
+        f.nullable = a.nullable || b.nullable;
+        f.first = a.first;
+        f.first.insert(f.first.end(), b.first.begin(), b.first.end());
+        f.last = a.last;
+        f.last.insert(f.last.end(), b.last.begin(), b.last.end());
+        f.minLength = std::min(a.minLength, b.minLength);
+        f.maxLength = std::max(a.maxLength, b.maxLength);
+        return f;
+    }
+
+    Fragment parseAlternatives()
+    {
+        Fragment f = parseSequence();
+        while (_error.isEmpty() && peek() == '|')
+        {
+            _idx += 1;
+            f = alternate(f, parseSequence());
+        }
+        return f;
+    }
+
+    Fragment parseSequence()
+    {
+        Fragment f;
+        while (_error.isEmpty())
+        {
+            char c = peek();
+            if (c == '\0' || c == '|' || c == ')')
+                break;
+            f = concat(f, parseRepeat());
+        }
+        return f;
+    }
+
+    Fragment parseRepeat()
+    {
+        int atomStart = _idx;
+        Fragment atom = parseAtom();
+        if (!_error.isEmpty() || peek() != '{')
+            return atom;
+        int atomEnd = _idx;
+
+        // Parse {n} or {n,m}
+        _idx += 1;
+        int lower = parseNumber();
+        int upper = lower;
+        if (peek() == ',')
+        {
+            _idx += 1;
+            upper = parseNumber();
+        }
+        if (peek() != '}')
+            fail(QObject::tr("Expected '}'"));
+        _idx += 1;
+        if (!_error.isEmpty())
+            return atom;
+        if (upper < lower || upper > MAX_REPEAT)
+        {
+            fail(QObject::tr("Invalid repeat count"));
+            return atom;
+        }
+
+        // Every copy of the atom needs its own positions, so the atom's text is
+        // parsed again for each repetition. Copies beyond lower are optional.
+        int repeatEnd = _idx;
+        Fragment f;
+        for (int n=0; (n < upper) && _error.isEmpty(); n++)
+        {
+            Fragment copy = atom;
+            if (n > 0)
+            {
+                _idx = atomStart;
+                copy = parseAtom();
+                _idx = atomEnd;
+            }
+            if (n >= lower)
+            {
+                copy.nullable = true;
+                copy.minLength = 0;
+            }
+            f = concat(f, copy);
+        }
+        _idx = repeatEnd;
+        return f;
+    }
+
+    int parseNumber()
+    {
+        skipSpace();
+        int start = _idx;
+        int value = 0;
+        while (_idx < _text.size() && _text.at(_idx) >= '0' && _text.at(_idx) <= '9' && value <= MAX_REPEAT)
+            value = value * 10 + (_text.at(_idx++) - '0');
+        if (_idx == start)
+            fail(QObject::tr("Expected a number"));
+        return value;
+    }
+
+    Fragment parseAtom()
+    {
+        char c = peek();
+        if (c == '(')
+        {
+            _idx += 1;
+            Fragment f = parseAlternatives();
+            if (peek() != ')')
+                fail(QObject::tr("Expected ')'"));
+            _idx += 1;
+            return f;
+        }
+        if (c == '"')
+            return parseString();
+        return parseByte();
+    }
+
+    Fragment parseString()
+    {
+        _idx += 1;
+        Fragment f;
+        bool closed = false;
+        while (_error.isEmpty() && _idx < _text.size())
+        {
+            char c = _text.at(_idx++);
+            if (c == '"')
+            {
+                closed = true;
+                break;
+            }
+            if (c == '\\' && _idx < _text.size())
+                c = _text.at(_idx++);
+            f = concat(f, leaf((uchar)c, 0xff));
+        }
+        if (!closed)
+            fail(QObject::tr("Unterminated string"));
+        return f;
+    }
+
+    Fragment parseByte()
+    {
+        // Two nibbles, each a hex digit or '?', or a lone '?' for any byte
+        uchar value = 0;
+        uchar mask = 0;
+        for (int n=0; n < 2; n++)
+        {
+            char c = _idx < _text.size() ? _text.at(_idx) : '\0';
+            int nibble = hexValue(c);
+            if (c == '?')
+            {
+                _idx += 1;
+                if (n == 0)
+                {
+                    char next = _idx < _text.size() ? _text.at(_idx) : '\0';
+                    if (next != '?' && hexValue(next) < 0)
+                        return leaf(0, 0);
+                }
+            }
+            else if (nibble >= 0)
+            {
+                _idx += 1;
+                value |= nibble << (4 - 4 * n);
+                mask |= 0xf << (4 - 4 * n);
+            }
+            else
+            {
+                fail(c ? QObject::tr("Unexpected '%1'").arg(QChar(c)) : QObject::tr("Unexpected end of pattern"));
+                return Fragment();
+            }
+        }
+
+        // Optional explicit mask
+        if (_idx < _text.size() && _text.at(_idx) == '&')
+        {
+            _idx += 1;
+            int hi = _idx < _text.size() ? hexValue(_text.at(_idx)) : -1;
+            int lo = _idx + 1 < _text.size() ? hexValue(_text.at(_idx + 1)) : -1;
+            if (hi < 0 || lo < 0)
+            {
+                fail(QObject::tr("Expected a hex mask"));
+                return Fragment();
+            }
+            _idx += 2;
+            mask &= (uchar)((hi << 4) | lo);
+        }
+        return leaf(value, mask);
+    }
+
+    QByteArray _text;
+    int _idx;
+    QString _error;
+};
+
+void setBits(std::vector<quint64> &set, size_t offset, const std::vector<int> &positions)
+{
+    for (int p : positions)
+        set[offset + p / 64] |= Q_UINT64_C(1) << (p % 64);
+}
+
+} // namespace
+
+
+// ***************************************** Compilation
+
+static void buildDfa(const BytePatternPrivate &d)
+{
+    if (d.positions > MAX_DFA_POSITIONS)
+        return;
+
+    // Subset construction over position sets. The start state is the empty set,
+    // every transition restarts the pattern, which makes the automaton unanchored.
+    typedef std::vector<quint64> Set;
+    std::map<Set, qint32> ids;
+    std::vector<Set> states;
+
+    Set start(d.words, 0);
+    ids[start] = 0;
+    states.push_back(start);
+
+    Set next(d.words);
+    for (size_t s=0; s < states.size(); s++)
+    {
+        Set current = states[s];
+        d.accepting.push_back(d.isAccepting(current.data()));
+        for (int b=0; b < 256; b++)
+        {
+            d.step(current.data(), next.data(), (uchar)b, true);
+            auto it = ids.find(next);
+            qint32 id;
+            if (it != ids.end())
+                id = it->second;
+            else
+            {
+                if (states.size() >= MAX_DFA_STATES)
+                {
+                    d.dfa.clear();
+                    d.accepting.clear();
+                    return;
+                }
+                id = (qint32)states.size();
+                ids[next] = id;
+                states.push_back(next);
+            }
+            d.dfa.push_back(id);
+        }
+    }
+}
+
+BytePattern::BytePattern()
+{
+}
+
+BytePattern::BytePattern(const QString &pattern)
+    : _pattern(pattern)
+{
+    QSharedPointer<BytePatternPrivate> d(new BytePatternPrivate);
+    Parser parser(pattern.toLatin1());
+    Fragment root;
+    if (!parser.parse(root))
+        d->error = parser.error();
+    else
+    {
+        d->positions = (int)parser.values.size();
+        d->words = (d->positions + 63) / 64;
+        d->minLength = root.minLength;
+        d->maxLength = root.maxLength;
+        d->first.assign(d->words, 0);
+        d->last.assign(d->words, 0);
+        d->follow.assign((size_t)d->positions * d->words, 0);
+        d->byteMask.assign((size_t)256 * d->words, 0);
+        setBits(d->first, 0, root.first);
+        setBits(d->last, 0, root.last);
+        for (int p=0; p < d->positions; p++)
+        {
+            setBits(d->follow, (size_t)p * d->words, parser.follow[p]);
+            for (int b=0; b < 256; b++)
+                if ((b & parser.masks[p]) == parser.values[p])
+                    d->byteMask[(size_t)b * d->words + p / 64] |= Q_UINT64_C(1) << (p % 64);
+        }
+    }
+    _d = d;
+}
+
+bool BytePattern::isValid() const
+{
+    return _d && _d->error.isEmpty();
+}
+
+QString BytePattern::errorString() const
+{
+    return _d ? _d->error : QString();
+}
+
+QString BytePattern::pattern() const
+{
+    return _pattern;
+}
+
+int BytePattern::minLength() const
+{
+    return _d ? _d->minLength : 0;
+}
+
+int BytePattern::maxLength() const
+{
+    return _d ? _d->maxLength : 0;
+}
+
+bool BytePattern::matches(const char *data, qint64 len) const
+{
+    if (!isValid() || len < _d->minLength || len > _d->maxLength)
+        return false;
+
+    // Anchored simulation, the pattern is not restarted after the first byte
+    std::vector<quint64> active(_d->words), next(_d->words);
+    const quint64 *m = &_d->byteMask[(size_t)(uchar)data[0] * _d->words];
+    for (int i=0; i < _d->words; i++)
+        active[i] = _d->first[i] & m[i];
+    for (qint64 idx=1; (idx < len) && !_d->isEmpty(active.data()); idx++)
+    {
+        _d->step(active.data(), next.data(), (uchar)data[idx], false);
+        active.swap(next);
+    }
+    return _d->isAccepting(active.data());
+}
+
+
+// ***************************************** Matcher
+
+BytePattern::Matcher::Matcher(const BytePattern &pattern)
+    : _d(pattern._d)
+{
+    if (_d && _d->error.isEmpty())
+        std::call_once(_d->dfaOnce, buildDfa, std::cref(*_d));
+    reset();
+}
+
+void BytePattern::Matcher::reset()
+{
+    _state = 0;
+    _active = QVector<quint64>(_d ? _d->words : 0, 0);
+}
+
+qint64 BytePattern::Matcher::feed(const char *data, qint64 len)
+{
+    if (!_d || !_d->error.isEmpty())
+        return -1;
+
+    if (!_d->dfa.empty())
+    {
+        const qint32 *dfa = _d->dfa.data();
+        const char *accepting = _d->accepting.data();
+        int state = _state;
+        for (qint64 idx=0; idx < len; idx++)
+        {
+            state = dfa[state * 256 + (uchar)data[idx]];
+            if (accepting[state])
+            {
+                _state = state;
+                return idx + 1;
+            }
+        }
+        _state = state;
+        return -1;
+    }
+
+    QVector<quint64> next(_d->words);
+    for (qint64 idx=0; idx < len; idx++)
+    {
+        _d->step(_active.constData(), next.data(), (uchar)data[idx], true);
+        _active.swap(next);
+        if (_d->isAccepting(_active.constData()))
+            return idx + 1;
+    }
+    return -1;
+}
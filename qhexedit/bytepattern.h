@@ -0,0 +1,73 @@
+#ifndef BYTEPATTERN_H
+#define BYTEPATTERN_H
+
+/** \cond docNever */
+
+/*! BytePattern is a compiled byte pattern, used by Chunks and QHexEdit to search
+ * for data which can not be expressed by a plain QByteArray.
+ *
+ * The pattern language knows these elements, separated by optional whitespace:
+ *
+ *   E8          a byte
+ *   ?? or ?     any byte
+ *   4? / ?F     a byte with one nibble given, the other one is a wildcard
+ *   E8&F0       a byte compared under a mask, here any of E0..EF
+ *   "MZ"        the ASCII bytes of a string (\" and \\ escape)
+ *   (E8 | E9)   alternatives, groups can be nested
+ *   x{n} x{n,m} bounded repeat of the preceding byte, string or group
+ *
+ * Example: E8 ?? ?? ?? ?? (48|4C) 8B ?{0,4} C3
+ *
+ * The pattern is compiled once into a Glushkov automaton. If the deterministic
+ * form of that automaton stays small, the first Matcher builds it, so this
+ * happens in the thread searching, and every byte costs one table lookup.
+ * Otherwise matching falls back to a bit parallel simulation of the position
+ * automaton. In both cases the Matcher keeps its state between
+ * feed() calls, so data can be streamed in blocks of any size.
+ */
+
+#include <QtCore>
+
+struct BytePatternPrivate;
+
+class BytePattern
+{
+public:
+    BytePattern();
+    explicit BytePattern(const QString &pattern);
+
+    bool isValid() const;
+    QString errorString() const;
+    QString pattern() const;
+
+    int minLength() const;
+    int maxLength() const;
+
+    // Returns true if the whole range data[0..len) matches the pattern
+    bool matches(const char *data, qint64 len) const;
+
+    class Matcher
+    {
+    public:
+        explicit Matcher(const BytePattern &pattern);
+        void reset();
+
+        // Feeds len bytes into the automaton. Returns the index behind the byte,
+        // which completes the first match in data, or -1 if no match ends in data.
+        // The state is kept, so feeding may be continued behind a returned match.
+        qint64 feed(const char *data, qint64 len);
+
+    private:
+        QSharedPointer<const BytePatternPrivate> _d;
+        int _state;
+        QVector<quint64> _active;
+    };
+
+private:
+    QString _pattern;
+    QSharedPointer<const BytePatternPrivate> _d;
+};
+
+/** \endcond docNever */
+
+#endif // BYTEPATTERN_H
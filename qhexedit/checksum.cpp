@@ -0,0 +1,227 @@
+#include "checksum.h"
+#include <QCryptographicHash>
+#include <string.h>
+#include <memory>
+#include <vector>
+
+#define BUFFER_SIZE 0x100000
+
+
+// ***************************************** Tables
+
+// table[k][b] is the crc of byte b followed by k zero bytes, so 8 bytes are
+// looked up independently and xored in one step
+struct Crc32Tables
+{
+    quint32 table[8][256];
+
+    Crc32Tables()
+    {
+        for (int b = 0; b < 256; b++)
+        {
+            quint32 crc = b;
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+            table[0][b] = crc;
+        }
+        for (int k = 1; k < 8; k++)
+            for (int b = 0; b < 256; b++)
+                table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+    }
+};
+
+struct Crc16Tables
+{
+    quint16 table[8][256];
+
+    Crc16Tables()
+    {
+        for (int b = 0; b < 256; b++)
+        {
+            quint16 crc = (quint16)(b << 8);
+            for (int bit = 0; bit < 8; bit++)
+                crc = (quint16)((crc << 1) ^ ((crc & 0x8000) ? 0x1021 : 0));
+            table[0][b] = crc;
+        }
+        for (int k = 1; k < 8; k++)
+            for (int b = 0; b < 256; b++)
+                table[k][b] = (quint16)((table[k - 1][b] << 8) ^ table[0][table[k - 1][b] >> 8]);
+    }
+};
+
+static const Crc32Tables &crc32Tables()
+{
+    static const Crc32Tables tables;
+    return tables;
+}
+
+static const Crc16Tables &crc16Tables()
+{
+    static const Crc16Tables tables;
+    return tables;
+}
+
+
+// ***************************************** Kernels
+
+quint32 Checksum::crc32(quint32 crc, const char *data, qint64 len)
+{
+    const quint32 (*t)[256] = crc32Tables().table;
+    const uchar *p = (const uchar *)data;
+    for (; len >= 8; len -= 8, p += 8)
+    {
+        quint32 lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | ((quint32)p[3] << 24));
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+            ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+    for (; len > 0; len--, p++)
+        crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xff];
+    return crc;
+}
+
+quint16 Checksum::crc16Ccitt(quint16 crc, const char *data, qint64 len)
+{
+    const quint16 (*t)[256] = crc16Tables().table;
+    const uchar *p = (const uchar *)data;
+    for (; len >= 8; len -= 8, p += 8)
+    {
+        crc = t[7][p[0] ^ (crc >> 8)] ^ t[6][p[1] ^ (crc & 0xff)] ^ t[5][p[2]] ^ t[4][p[3]]
+            ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+    for (; len > 0; len--, p++)
+        crc = (quint16)((crc << 8) ^ t[0][(crc >> 8) ^ *p]);
+    return crc;
+}
+
+static quint64 byteSum(const char *data, qint64 len)
+{
+    quint64 sum = 0;
+    const uchar *p = (const uchar *)data;
+    for (qint64 idx = 0; idx < len; idx++)
+        sum += p[idx];
+    return sum;
+}
+
+static uchar byteXor(const char *data, qint64 len)
+{
+    quint64 word = 0;
+    qint64 idx = 0;
+    for (; idx + 8 <= len; idx += 8)
+    {
+        quint64 v;
+        memcpy(&v, data + idx, 8);
+        word ^= v;
+    }
+    for (; idx < len; idx++)
+        word ^= (uchar)data[idx];
+    word ^= word >> 32;
+    word ^= word >> 16;
+    word ^= word >> 8;
+    return (uchar)word;
+}
+
+static QByteArray merkleRoot(Chunks &chunks, qint64 pos, qint64 end)
+{
+    if ((pos == 0) && (end == chunks.size()) && chunks.merkleTreeEnabled())
+        return chunks.digest();
+    MerkleTree tree;
+    tree.reset(end - pos);
+    return tree.update([&chunks, pos](qint64 blockPos, qint64 len) { return chunks.data(pos + blockPos, len); });
+}
+
+static QByteArray bigEndian(quint64 value, int size)
+{
+    QByteArray result(size, Qt::Uninitialized);
+    for (int idx = size - 1; idx >= 0; idx--, value >>= 8)
+        result[idx] = (char)value;
+    return result;
+}
+
+
+// ***************************************** Checksum
+
+QString Checksum::name(Algorithm algorithm)
+{
+    switch (algorithm)
+    {
+    case Sum8: return "Sum 8";
+    case Sum16: return "Sum 16";
+    case Sum32: return "Sum 32";
+    case Xor8: return "XOR 8";
+    case Crc16Ccitt: return "CRC-16/CCITT";
+    case Crc32: return "CRC-32";
+    case Md5: return "MD5";
+    case Sha1: return "SHA-1";
+    case Sha256: return "SHA-256";
+    case Merkle: return "Merkle SHA-256";
+    default: return QString();
+    }
+}
+
+QVector<QByteArray> Checksum::compute(Chunks &chunks, qint64 pos, qint64 count,
+                                      const QVector<Algorithm> &algorithms,
+                                      const Chunks::ProgressFunction &progress)
+{
+    bool needSum = false, needXor = false, needCrc16 = false, needCrc32 = false, needBlocks = false;
+    std::vector<std::unique_ptr<QCryptographicHash>> hashes(AlgorithmCount);
+    for (Algorithm algorithm : algorithms)
+    {
+        switch (algorithm)
+        {
+        case Sum8: case Sum16: case Sum32: needSum = true; break;
+        case Xor8: needXor = true; break;
+        case Crc16Ccitt: needCrc16 = true; break;
+        case Crc32: needCrc32 = true; break;
+        case Md5: hashes[Md5].reset(new QCryptographicHash(QCryptographicHash::Md5)); break;
+        case Sha1: hashes[Sha1].reset(new QCryptographicHash(QCryptographicHash::Sha1)); break;
+        case Sha256: hashes[Sha256].reset(new QCryptographicHash(QCryptographicHash::Sha256)); break;
+        default: break;
+        }
+        needBlocks = needBlocks || (algorithm != Merkle);
+    }
+
+    qint64 end = chunks.size();
+    if ((count >= 0) && ((pos + count) < end))
+        end = pos + count;
+    quint64 sum = 0;
+    uchar xorValue = 0;
+    quint16 crc16 = 0xffff;
+    quint32 crc32Value = 0xffffffff;
+    for (qint64 blockPos = pos; needBlocks && (blockPos < end); blockPos += BUFFER_SIZE)
+    {
+        if (progress && !progress(blockPos))
+            return QVector<QByteArray>();
+        QByteArray block = chunks.data(blockPos, std::min<qint64>(BUFFER_SIZE, end - blockPos));
+        if (block.isEmpty())
+            break;
+        if (needSum)
+            sum += byteSum(block.constData(), block.size());
+        if (needXor)
+            xorValue ^= byteXor(block.constData(), block.size());
+        if (needCrc16)
+            crc16 = crc16Ccitt(crc16, block.constData(), block.size());
+        if (needCrc32)
+            crc32Value = crc32(crc32Value, block.constData(), block.size());
+        for (auto &hash : hashes)
+            if (hash)
+                hash->addData(QByteArrayView(block));
+    }
+
+    QVector<QByteArray> results;
+    for (Algorithm algorithm : algorithms)
+    {
+        switch (algorithm)
+        {
+        case Sum8: results.append(bigEndian(sum, 1)); break;
+        case Sum16: results.append(bigEndian(sum, 2)); break;
+        case Sum32: results.append(bigEndian(sum, 4)); break;
+        case Xor8: results.append(bigEndian(xorValue, 1)); break;
+        case Crc16Ccitt: results.append(bigEndian(crc16, 2)); break;
+        case Crc32: results.append(bigEndian(~crc32Value, 4)); break;
+        case Md5: case Sha1: case Sha256: results.append(hashes[algorithm]->result()); break;
+        case Merkle: results.append(merkleRoot(chunks, pos, end)); break;
+        default: results.append(QByteArray()); break;
+        }
+    }
+    return results;
+}
@@ -0,0 +1,59 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+/** \cond docNever */
+
+/*! Checksum computes checksums and hashes over ranges of Chunks, as they are
+ * needed to verify flash contents: additive sums, CRCs and cryptographic
+ * hashes.
+ *
+ * All selected algorithms are fed from one pass over the range, which is
+ * read block by block, so ranges of any size never have to be in memory.
+ * The CRCs use slicing-by-8 tables, which process 8 bytes per step, the
+ * hashes are done by QCryptographicHash.
+ *
+ * The Merkle root of a whole image comes from the tree, which Chunks keeps
+ * when enabled, so it is only hashed again where the image was edited.
+ *
+ * Results are the bytes of the checksum in big endian order, as they are
+ * usually printed.
+ */
+
+#include <QtCore>
+
+#include "chunks.h"
+
+class Checksum
+{
+public:
+    enum Algorithm
+    {
+        Sum8,           // sum of all bytes, truncated to 8 bit
+        Sum16,          // sum of all bytes, truncated to 16 bit
+        Sum32,          // sum of all bytes, truncated to 32 bit
+        Xor8,           // all bytes xored
+        Crc16Ccitt,     // poly 0x1021, init 0xffff, not reflected (CCITT-FALSE)
+        Crc32,          // poly 0x04c11db7, reflected (zlib, Ethernet)
+        Md5,
+        Sha1,
+        Sha256,
+        Merkle,         // root of the MerkleTree, incremental when Chunks keeps the tree
+        AlgorithmCount
+    };
+
+    static QString name(Algorithm algorithm);
+
+    // Computes all algorithms over count bytes from pos on (-1 to the end),
+    // returns no results if progress cancels
+    static QVector<QByteArray> compute(Chunks &chunks, qint64 pos, qint64 count,
+                                       const QVector<Algorithm> &algorithms,
+                                       const Chunks::ProgressFunction &progress=Chunks::ProgressFunction());
+
+    // Kernels, crc is the running value without the final xor
+    static quint32 crc32(quint32 crc, const char *data, qint64 len);
+    static quint16 crc16Ccitt(quint16 crc, const char *data, qint64 len);
+};
+
+/** \endcond docNever */
+
+#endif // CHECKSUM_H
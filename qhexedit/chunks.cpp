@@ -1,5 +1,7 @@
 #include "chunks.h"
+#include "sparseimage.h"
 #include <limits.h>
+#include <algorithm>
 
 #define NORMAL 0
 #define HIGHLIGHTED 1
@@ -23,6 +25,7 @@ Chunks::Chunks(QIODevice &ioDevice, QObject *parent): QObject(parent)
 
 bool Chunks::setIODevice(QIODevice &ioDevice)
 {
+    QMutexLocker locker(&_mutex);
     _ioDevice = &ioDevice;
     bool ok = _ioDevice->open(QIODevice::ReadOnly);
     if (ok)   // Try to open IODevice
@@ -38,14 +41,35 @@ bool Chunks::setIODevice(QIODevice &ioDevice)
     }
     _chunks.clear();
     _pos = 0;
+    invalidateTree(0, -1);
+    locker.unlock();
+    emit rangeChanged(0, -1);
     return ok;
 }
 
+bool Chunks::setBuffer(QBuffer &buffer, const QByteArray &data)
+{
+    // Workers may still read buffer through this, e.g. when it is the current
+    // device, so its content is only replaced while they wait
+    QMutexLocker locker(&_mutex);
+    buffer.setData(data);
+    return setIODevice(buffer);
+}
+
+void Chunks::reload(qint64 pos, qint64 length)
+{
+    QMutexLocker locker(&_mutex);
+    invalidateTree(pos, length);
+    locker.unlock();
+    emit rangeChanged(pos, length);
+}
+
 
 // ***************************************** Getting data out of Chunks
 
 QByteArray Chunks::data(qint64 pos, qint64 maxSize, QByteArray *highlighted)
 {
+    QMutexLocker locker(&_mutex);
     qint64 ioDelta = 0;
     int chunkIdx = 0;
 
@@ -129,10 +153,36 @@ QByteArray Chunks::data(qint64 pos, qint64 maxSize, QByteArray *highlighted)
     return buffer;
 }
 
+qint64 Chunks::fillLength(qint64 pos, char *value)
+{
+    QMutexLocker locker(&_mutex);
+    SparseImage *image = qobject_cast<SparseImage *>(_ioDevice);
+    if (!image || (pos < 0) || (pos >= _size))
+        return 0;
+
+    // Copied chunks hide the device, the ones in front of pos shift it like
+    // in data(). The fill ends at the next copied chunk.
+    qint64 ioDelta = 0;
+    qint64 limit = _size;
+    for (int idx=0; idx < _chunks.size(); idx++)
+    {
+        const Chunk &chunk = _chunks.at(idx);
+        if (chunk.absPos > pos)
+        {
+            limit = chunk.absPos;
+            break;
+        }
+        if (pos < (chunk.absPos + chunk.data.size()))
+            return 0;
+        ioDelta += CHUNK_SIZE - chunk.data.size();
+    }
+    return std::min(image->fillLength(pos + ioDelta, value), limit - pos);
+}
+
 bool Chunks::write(QIODevice &iODevice, qint64 pos, qint64 count)
 {
     if (count == -1)
-        count = _size;
+        count = size();
     bool ok = iODevice.open(QIODevice::WriteOnly);
     if (ok)
     {
@@ -151,11 +201,34 @@ bool Chunks::write(QIODevice &iODevice, qint64 pos, qint64 count)
 
 void Chunks::setDataChanged(qint64 pos, bool dataChanged)
 {
+    QMutexLocker locker(&_mutex);
     if ((pos < 0) || (pos >= _size))
         return;
     int chunkIdx = getChunkIndex(pos);
     qint64 posInBa = pos - _chunks[chunkIdx].absPos;
     _chunks[chunkIdx].dataChanged[(int)posInBa] = char(dataChanged);
+    locker.unlock();
+    emit rangeChanged(pos, 1);
+}
+
+void Chunks::setDataChanged(qint64 pos, const QByteArray &dataChanged)
+{
+    QMutexLocker locker(&_mutex);
+    if ((pos < 0) || ((pos + dataChanged.size()) > _size))
+        return;
+    qint64 done = 0;
+    while (done < dataChanged.size())
+    {
+        Chunk &chunk = _chunks[getChunkIndex(pos + done)];
+        qint64 posInBa = pos + done - chunk.absPos;
+        qint64 count = std::min<qint64>(dataChanged.size() - done, chunk.dataChanged.size() - posInBa);
+        if (count <= 0)
+            break;
+        chunk.dataChanged.replace(posInBa, count, dataChanged.constData() + done, count);
+        done += count;
+    }
+    locker.unlock();
+    emit rangeChanged(pos, dataChanged.size());
 }
 
 bool Chunks::dataChanged(qint64 pos)
@@ -165,24 +238,131 @@ bool Chunks::dataChanged(qint64 pos)
     return bool(highlighted.at(0));
 }
 
+QVector<QPair<qint64, qint64>> Chunks::changedRanges()
+{
+    // Only copied chunks have highlighted bytes. Once a chunk is longer or
+    // shorter than read, inserts or removals moved all bytes behind it.
+    QMutexLocker locker(&_mutex);
+    QVector<QPair<qint64, qint64>> ranges;
+    qint64 ioSize = _ioDevice->size();
+    qint64 ioDelta = 0;
+    qint64 moved = -1;
+    for (const Chunk &chunk : _chunks)
+    {
+        qint64 readSize = std::min<qint64>(CHUNK_SIZE, ioSize - (chunk.absPos - ioDelta));
+        if (chunk.data.size() != readSize)
+        {
+            moved = chunk.absPos;
+            break;
+        }
+        ioDelta += chunk.data.size() - CHUNK_SIZE;
+
+        const char *flags = chunk.dataChanged.constData();
+        qint64 count = chunk.dataChanged.size();
+        for (qint64 idx = 0; idx < count; )
+        {
+            if (!flags[idx])
+            {
+                idx++;
+                continue;
+            }
+            qint64 start = idx;
+            while ((idx < count) && flags[idx])
+                idx++;
+            qint64 pos = chunk.absPos + start;
+            if (!ranges.isEmpty() && (ranges.last().first + ranges.last().second == pos))
+                ranges.last().second += idx - start;
+            else
+                ranges.append(qMakePair(pos, idx - start));
+        }
+    }
+    if ((moved >= 0) && (moved < _size))
+    {
+        if (!ranges.isEmpty() && (ranges.last().first + ranges.last().second == moved))
+            ranges.last().second = _size - ranges.last().first;
+        else
+            ranges.append(qMakePair(moved, _size - moved));
+    }
+    return ranges;
+}
+
 
 // ***************************************** Search API
 
-qint64 Chunks::indexOf(const QByteArray &ba, qint64 from)
+qint64 Chunks::indexOf(const QByteArray &ba, qint64 from, const ProgressFunction &progress)
 {
     qint64 result = -1;
     QByteArray buffer;
 
-    for (qint64 pos=from; (pos < _size) && (result < 0); pos += BUFFER_SIZE)
+    qint64 pos = from;
+    while ((pos < size()) && (result < 0))
     {
+        if (progress && !progress(pos))
+            break;
+
+        // Inside a fill a match starts at its beginning, if ba is fill bytes
+        // only, else not before the first other byte of ba is behind it
+        char fill;
+        qint64 fillLen = fillLength(pos, &fill);
+        if ((fillLen > 0) && !ba.isEmpty())
+        {
+            qint64 same = 0;
+            while ((same < ba.size()) && (ba.at(same) == fill))
+                same++;
+            if ((same == ba.size()) && (fillLen >= same))
+            {
+                result = pos;
+                break;
+            }
+            if ((same < ba.size()) && (fillLen > same))
+            {
+                pos += fillLen - same;
+                continue;
+            }
+        }
+
         buffer = data(pos, BUFFER_SIZE + ba.size() - 1);
         int findPos = buffer.indexOf(ba);
         if (findPos >= 0)
             result = pos + (qint64)findPos;
+        pos += BUFFER_SIZE;
     }
     return result;
 }
 
+qint64 Chunks::indexOf(const BytePattern &pattern, qint64 from, qint64 *length, const ProgressFunction &progress)
+{
+    if (!pattern.isValid())
+        return -1;
+
+    // The matcher keeps its state from buffer to buffer, so matches crossing
+    // buffer boundaries need no overlapping reads.
+    BytePattern::Matcher matcher(pattern);
+    for (qint64 pos=from; pos < size(); pos += BUFFER_SIZE)
+    {
+        if (progress && !progress(pos))
+            break;
+        QByteArray buffer = data(pos, BUFFER_SIZE);
+        qint64 matchEnd = matcher.feed(buffer.constData(), buffer.size());
+        if (matchEnd < 0)
+            continue;
+
+        // The automaton only knows, where a match ends. Look for its start
+        // within the longest possible match, leftmost first.
+        matchEnd += pos;
+        qint64 windowPos = std::max(from, matchEnd - (qint64)pattern.maxLength());
+        QByteArray window = data(windowPos, matchEnd - windowPos);
+        for (qint64 idx=0; idx <= window.size() - pattern.minLength(); idx++)
+            if (pattern.matches(window.constData() + idx, window.size() - idx))
+            {
+                if (length)
+                    *length = window.size() - idx;
+                return windowPos + idx;
+            }
+    }
+    return -1;
+}
+
 qint64 Chunks::lastIndexOf(const QByteArray &ba, qint64 from)
 {
     qint64 result = -1;
@@ -206,6 +386,7 @@ qint64 Chunks::lastIndexOf(const QByteArray &ba, qint64 from)
 
 bool Chunks::insert(qint64 pos, char b)
 {
+    QMutexLocker locker(&_mutex);
     if ((pos < 0) || (pos > _size))
         return false;
     int chunkIdx;
@@ -220,11 +401,15 @@ bool Chunks::insert(qint64 pos, char b)
         _chunks[idx].absPos += 1;
     _size += 1;
     _pos = pos;
+    invalidateTree(pos, -1);
+    locker.unlock();
+    emit rangeChanged(pos, -1);
     return true;
 }
 
 bool Chunks::overwrite(qint64 pos, char b)
 {
+    QMutexLocker locker(&_mutex);
     if ((pos < 0) || (pos >= _size))
         return false;
     int chunkIdx = getChunkIndex(pos);
@@ -232,11 +417,15 @@ bool Chunks::overwrite(qint64 pos, char b)
     _chunks[chunkIdx].data[(int)posInBa] = b;
     _chunks[chunkIdx].dataChanged[(int)posInBa] = char(1);
     _pos = pos;
+    invalidateTree(pos, 1);
+    locker.unlock();
+    emit rangeChanged(pos, 1);
     return true;
 }
 
 bool Chunks::removeAt(qint64 pos)
 {
+    QMutexLocker locker(&_mutex);
     if ((pos < 0) || (pos >= _size))
         return false;
     int chunkIdx = getChunkIndex(pos);
@@ -247,9 +436,153 @@ bool Chunks::removeAt(qint64 pos)
         _chunks[idx].absPos -= 1;
     _size -= 1;
     _pos = pos;
+    invalidateTree(pos, -1);
+    locker.unlock();
+    emit rangeChanged(pos, -1);
+    return true;
+}
+
+bool Chunks::insert(qint64 pos, const QByteArray &ba)
+{
+    // All bytes go into one chunk, chunks may grow beyond CHUNK_SIZE
+    QMutexLocker locker(&_mutex);
+    if ((pos < 0) || (pos > _size))
+        return false;
+    if (ba.isEmpty())
+        return true;
+    int chunkIdx;
+    if (pos == _size)
+        chunkIdx = getChunkIndex(pos-1);
+    else
+        chunkIdx = getChunkIndex(pos);
+    qint64 posInBa = pos - _chunks[chunkIdx].absPos;
+    _chunks[chunkIdx].data.insert(posInBa, ba);
+    _chunks[chunkIdx].dataChanged.insert(posInBa, QByteArray(ba.size(), char(1)));
+    for (int idx=chunkIdx+1; idx < _chunks.size(); idx++)
+        _chunks[idx].absPos += ba.size();
+    _size += ba.size();
+    _pos = pos;
+    invalidateTree(pos, -1);
+    locker.unlock();
+    emit rangeChanged(pos, -1);
     return true;
 }
 
+bool Chunks::overwrite(qint64 pos, const QByteArray &ba)
+{
+    QMutexLocker locker(&_mutex);
+    if ((pos < 0) || ((pos + ba.size()) > _size))
+        return false;
+    qint64 done = 0;
+    while (done < ba.size())
+    {
+        Chunk &chunk = _chunks[getChunkIndex(pos + done)];
+        qint64 posInBa = pos + done - chunk.absPos;
+        qint64 count = std::min<qint64>(ba.size() - done, chunk.data.size() - posInBa);
+        if (count <= 0)
+            break;
+        chunk.data.replace(posInBa, count, ba.constData() + done, count);
+        chunk.dataChanged.replace(posInBa, count, QByteArray(count, char(1)));
+        done += count;
+    }
+    _pos = pos;
+    invalidateTree(pos, ba.size());
+    locker.unlock();
+    emit rangeChanged(pos, ba.size());
+    return done == ba.size();
+}
+
+bool Chunks::removeAt(qint64 pos, qint64 len)
+{
+    QMutexLocker locker(&_mutex);
+    if ((pos < 0) || (len < 0) || ((pos + len) > _size))
+        return false;
+    qint64 left = len;
+    while (left > 0)
+    {
+        int chunkIdx = getChunkIndex(pos);
+        Chunk &chunk = _chunks[chunkIdx];
+        qint64 posInBa = pos - chunk.absPos;
+        qint64 count = std::min<qint64>(left, chunk.data.size() - posInBa);
+        if (count <= 0)
+            break;
+        chunk.data.remove(posInBa, count);
+        chunk.dataChanged.remove(posInBa, count);
+        for (int idx=chunkIdx+1; idx < _chunks.size(); idx++)
+            _chunks[idx].absPos -= count;
+        _size -= count;
+        left -= count;
+    }
+    _pos = pos;
+    invalidateTree(pos, -1);
+    locker.unlock();
+    emit rangeChanged(pos, -1);
+    return left == 0;
+}
+
+
+// ***************************************** Block hashes
+
+void Chunks::setMerkleTreeEnabled(bool enabled)
+{
+    QMutexLocker locker(&_mutex);
+    if (enabled && !_merkleEnabled)
+        _merkle.reset(_size);
+    _merkleEnabled = enabled;
+}
+
+bool Chunks::merkleTreeEnabled()
+{
+    QMutexLocker locker(&_mutex);
+    return _merkleEnabled;
+}
+
+QByteArray Chunks::digest()
+{
+    // A copy of the tree is hashed, data() and fillLength() lock for one block
+    // at a time. Edits meanwhile are marked in the copy before it is taken
+    // over, so the blocks they touch are hashed again.
+    QMutexLocker locker(&_mutex);
+    while (_merkleEnabled && _merkle.isDirty())
+    {
+        MerkleTree tree = _merkle;
+        qsizetype firstEdit = _treeEdits.size();
+        _digests += 1;
+        locker.unlock();
+        tree.update([this](qint64 pos, qint64 len) { return data(pos, len); },
+                    [this](qint64 pos, char *value) { return fillLength(pos, value); });
+        locker.relock();
+        _digests -= 1;
+        for (qsizetype idx = firstEdit; idx < _treeEdits.size(); idx++)
+            tree.invalidate(_treeEdits.at(idx).pos, _treeEdits.at(idx).length, _treeEdits.at(idx).size);
+        if (_digests == 0)
+            _treeEdits.clear();
+        _merkle = tree;
+    }
+    return _merkleEnabled ? _merkle.rootHash() : QByteArray();
+}
+
+MerkleTree Chunks::merkleTree()
+{
+    // Hashed by digest() without the lock, edits meanwhile make it hash again
+    QMutexLocker locker(&_mutex);
+    while (_merkleEnabled && _merkle.isDirty())
+    {
+        locker.unlock();
+        digest();
+        locker.relock();
+    }
+    return _merkle;
+}
+
+void Chunks::invalidateTree(qint64 pos, qint64 length)
+{
+    if (_merkleEnabled)
+        _merkle.invalidate(pos, length, _size);
+    if (_digests > 0)
+        _treeEdits.append(TreeEdit{pos, length, _size});
+}
+
 
 // ***************************************** Utility functions
 
@@ -260,11 +593,13 @@ char Chunks::operator[](qint64 pos)
 
 qint64 Chunks::pos()
 {
+    QMutexLocker locker(&_mutex);
     return _pos;
 }
 
 qint64 Chunks::size()
 {
+    QMutexLocker locker(&_mutex);
     return _size;
 }
 
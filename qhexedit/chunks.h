@@ -15,9 +15,29 @@
  * kilobytes) and notes all changes there. Parallel to that chunk, there is a second chunk,
  * which keep track of which bytes are changed and which not.
  *
+ * Chunks may be read from worker threads (e.g. background searches) while the
+ * GUI thread edits it. Every public accessor serializes on an internal mutex;
+ * long running operations only hold it for one buffer at a time.
+ *
+ * Optionally Chunks keeps a MerkleTree of its 4 KiB blocks. Edits mark the
+ * blocks they touch dirty, so digest() only hashes these again. BinDiff
+ * compares the trees of two images to skip the blocks they share.
+ *
+ * When the QIODevice is a SparseImage, fillLength() passes its fill extents
+ * through, as far as they are not edited. Plain searches skip them and the
+ * MerkleTree hashes a block of a fill only once per fill value.
+ *
+ * Devices, which get their bytes later on (e.g. paged in from a target), call
+ * for reload() of these. Their positions are taken as those of Chunks, so it
+ * is meant for data, which is not edited.
+ *
  */
 
 #include <QtCore>
+#include <functional>
+
+#include "bytepattern.h"
+#include "merkletree.h"
 
 struct Chunk
 {
@@ -30,21 +50,31 @@ class Chunks: public QObject
 {
 Q_OBJECT
 public:
+    // Called by long running operations with the position reached so far,
+    // return false to abort the operation.
+    typedef std::function<bool(qint64 pos)> ProgressFunction;
+
     // Constructors and file settings
     Chunks(QObject *parent);
     Chunks(QIODevice &ioDevice, QObject *parent);
     bool setIODevice(QIODevice &ioDevice);
+    bool setBuffer(QBuffer &buffer, const QByteArray &data); // new content of buffer, swapped under the lock
+    void reload(qint64 pos, qint64 length);     // the device changed these bytes, length -1 up to the end
 
     // Getting data out of Chunks
     QByteArray data(qint64 pos=0, qint64 count=-1, QByteArray *highlighted=0);
+    qint64 fillLength(qint64 pos, char *value); // bytes equal to *value from pos on, 0 if unknown
     bool write(QIODevice &iODevice, qint64 pos=0, qint64 count=-1);
 
     // Set and get highlighting infos
     void setDataChanged(qint64 pos, bool dataChanged);
+    void setDataChanged(qint64 pos, const QByteArray &dataChanged);
     bool dataChanged(qint64 pos);
+    QVector<QPair<qint64, qint64>> changedRanges(); // position and length of highlighted runs
 
     // Search API
-    qint64 indexOf(const QByteArray &ba, qint64 from);
+    qint64 indexOf(const QByteArray &ba, qint64 from, const ProgressFunction &progress=ProgressFunction());
+    qint64 indexOf(const BytePattern &pattern, qint64 from, qint64 *length=0, const ProgressFunction &progress=ProgressFunction());
     qint64 lastIndexOf(const QByteArray &ba, qint64 from);
 
     // Char manipulations
@@ -52,19 +82,41 @@ public:
     bool overwrite(qint64 pos, char b);
     bool removeAt(qint64 pos);
 
+    // Range manipulations, done chunk by chunk instead of byte by byte
+    bool insert(qint64 pos, const QByteArray &ba);
+    bool overwrite(qint64 pos, const QByteArray &ba);
+    bool removeAt(qint64 pos, qint64 len);
+
+    // Block hashes, kept across edits while enabled
+    void setMerkleTreeEnabled(bool enabled);
+    bool merkleTreeEnabled();
+    QByteArray digest();                        // root hash, empty when disabled
+    MerkleTree merkleTree();                    // up to date copy, e.g. for MerkleTree::differingBlocks()
+
     // Utility functions
     char operator[](qint64 pos);
     qint64 pos();
     qint64 size();
 
+signals:
+    // Emitted after an edit, length -1 means up to the end because the
+    // bytes behind pos moved
+    void rangeChanged(qint64 pos, qint64 length);
 
 private:
     int getChunkIndex(qint64 absPos);
+    void invalidateTree(qint64 pos, qint64 length);
 
     QIODevice * _ioDevice;
     qint64 _pos;
     qint64 _size;
     QList<Chunk> _chunks;
+    QRecursiveMutex _mutex;
+    MerkleTree _merkle;
+    bool _merkleEnabled = false;
+    struct TreeEdit { qint64 pos; qint64 length; qint64 size; };
+    QVector<TreeEdit> _treeEdits;               // invalidations while digest() hashes a copy
+    int _digests = 0;                           // digest() calls hashing a copy
 
 #ifdef MODUL_TEST
 public:
@@ -1,5 +1,6 @@
 #include "commands.h"
 #include <QUndoCommand>
+#include <algorithm>
 
 
 // Helper class to store single byte commands
@@ -91,6 +92,165 @@ void CharCommand::redo()
     }
 }
 
+// Helper class to store byte array commands
+class ArrayCommand : public QUndoCommand
+{
+public:
+    enum ACmd {insert, removeAt, overwrite};
+
+    ArrayCommand(Chunks * chunks, ACmd cmd, qint64 baPos, const QByteArray &newBa=QByteArray(), qint64 len=0,
+                 QUndoCommand *parent=0);
+
+    void undo();
+    void redo();
+
+private:
+    Chunks * _chunks;
+    ACmd _cmd;
+    qint64 _baPos;
+    qint64 _len;
+    QByteArray _newBa;
+    QByteArray _oldBa;
+    QByteArray _wasChanged;
+};
+
+ArrayCommand::ArrayCommand(Chunks * chunks, ACmd cmd, qint64 baPos, const QByteArray &newBa, qint64 len, QUndoCommand *parent)
+    : QUndoCommand(parent)
+    , _chunks(chunks)
+    , _cmd(cmd)
+    , _baPos(baPos)
+    , _len(len)
+    , _newBa(newBa)
+{
+}
+
+void ArrayCommand::undo()
+{
+    switch (_cmd)
+    {
+        case insert:
+            _chunks->removeAt(_baPos, _newBa.size());
+            break;
+        case overwrite:
+            _chunks->overwrite(_baPos, _oldBa);
+            _chunks->setDataChanged(_baPos, _wasChanged);
+            break;
+        case removeAt:
+            _chunks->insert(_baPos, _oldBa);
+            _chunks->setDataChanged(_baPos, _wasChanged);
+            break;
+    }
+}
+
+void ArrayCommand::redo()
+{
+    switch (_cmd)
+    {
+        case insert:
+            _chunks->insert(_baPos, _newBa);
+            break;
+        case overwrite:
+            _oldBa = _chunks->data(_baPos, _newBa.size(), &_wasChanged);
+            _chunks->overwrite(_baPos, _newBa);
+            break;
+        case removeAt:
+            _oldBa = _chunks->data(_baPos, _len, &_wasChanged);
+            _chunks->removeAt(_baPos, _len);
+            break;
+    }
+}
+
+// Helper class to store bulk transforms
+class TransformCommand : public QUndoCommand
+{
+public:
+    TransformCommand(Chunks * chunks, qint64 pos, qint64 len, const Transform &transform,
+                     QUndoCommand *parent=0);
+
+    bool apply(const Chunks::ProgressFunction &progress); // first redo, false if aborted and restored
+    void undo();
+    void redo();
+
+private:
+    void restore(int blocks);               // undo of the first blocks
+
+    Chunks * _chunks;
+    qint64 _pos;
+    qint64 _len;
+    Transform _transform;
+    bool _applied;                          // done by apply(), the push skips its redo
+    QVector<QByteArray> _oldBlocks;         // compressed replaced bytes, Fill only
+    QVector<QByteArray> _wasChanged;        // compressed highlighting per block
+};
+
+TransformCommand::TransformCommand(Chunks * chunks, qint64 pos, qint64 len, const Transform &transform,
+                                   QUndoCommand *parent)
+    : QUndoCommand(parent)
+    , _chunks(chunks)
+    , _pos(pos)
+    , _len(len)
+    , _transform(transform)
+    , _applied(false)
+{
+}
+
+bool TransformCommand::apply(const Chunks::ProgressFunction &progress)
+{
+    // One block is read, kept for undo and written at a time, Chunks locks
+    // for each, so this may run in a worker
+    _oldBlocks.clear();
+    _wasChanged.clear();
+    for (qint64 done = 0; done < _len; done += TRANSFORM_BLOCK)
+    {
+        if (progress && !progress(done))
+        {
+            restore(_wasChanged.size());
+            return false;
+        }
+        QByteArray wasChanged;
+        QByteArray block = _chunks->data(_pos + done, std::min<qint64>(TRANSFORM_BLOCK, _len - done), &wasChanged);
+        _wasChanged.append(qCompress(wasChanged));
+        if (!_transform.isInvertible())
+            _oldBlocks.append(qCompress(block));
+        _transform.apply(block.data(), block.size(), done);
+        _chunks->overwrite(_pos + done, block);
+    }
+    _applied = true;
+    return true;
+}
+
+void TransformCommand::restore(int blocks)
+{
+    Transform inverse = _transform.inverse();
+    for (int idx = 0; idx < blocks; idx++)
+    {
+        qint64 done = (qint64)idx * TRANSFORM_BLOCK;
+        QByteArray block;
+        if (_transform.isInvertible())
+        {
+            block = _chunks->data(_pos + done, std::min<qint64>(TRANSFORM_BLOCK, _len - done));
+            inverse.apply(block.data(), block.size(), done);
+        }
+        else
+            block = qUncompress(_oldBlocks.at(idx));
+        _chunks->overwrite(_pos + done, block);
+        _chunks->setDataChanged(_pos + done, qUncompress(_wasChanged.at(idx)));
+    }
+}
+
+void TransformCommand::undo()
+{
+    restore(_wasChanged.size());
+}
+
+void TransformCommand::redo()
+{
+    if (_applied)
+        _applied = false;
+    else
+        apply(Chunks::ProgressFunction());
+}
+
 UndoStack::UndoStack(Chunks * chunks, QObject * parent)
     : QUndoStack(parent)
 {
@@ -112,14 +272,9 @@ void UndoStack::insert(qint64 pos, const QByteArray &ba)
 {
     if ((pos >= 0) && (pos <= _chunks->size()))
     {
-        QString txt = QString(tr("Inserting %1 bytes")).arg(ba.size());
-        beginMacro(txt);
-        for (int idx=0; idx < ba.size(); idx++)
-        {
-            QUndoCommand *cc = new CharCommand(_chunks, CharCommand::insert, pos + idx, ba.at(idx));
-            this->push(cc);
-        }
-        endMacro();
+        QUndoCommand *ac = new ArrayCommand(_chunks, ArrayCommand::insert, pos, ba);
+        ac->setText(QString(tr("Inserting %1 bytes")).arg(ba.size()));
+        this->push(ac);
     }
 }
 
@@ -134,14 +289,10 @@ void UndoStack::removeAt(qint64 pos, qint64 len)
         }
         else
         {
-            QString txt = QString(tr("Delete %1 chars")).arg(len);
-            beginMacro(txt);
-            for (qint64 cnt=0; cnt<len; cnt++)
-            {
-                QUndoCommand *cc = new CharCommand(_chunks, CharCommand::removeAt, pos, char(0));
-                push(cc);
-            }
-            endMacro();
+            len = std::min(len, _chunks->size() - pos);
+            QUndoCommand *ac = new ArrayCommand(_chunks, ArrayCommand::removeAt, pos, QByteArray(), len);
+            ac->setText(QString(tr("Delete %1 chars")).arg(len));
+            push(ac);
         }
     }
 }
@@ -160,9 +311,40 @@ void UndoStack::overwrite(qint64 pos, int len, const QByteArray &ba)
     if ((pos >= 0) && (pos < _chunks->size()))
     {
         QString txt = QString(tr("Overwrite %1 chars")).arg(len);
-        beginMacro(txt);
-        removeAt(pos, len);
-        insert(pos, ba);
-        endMacro();
+        if ((len == ba.size()) && ((pos + len) <= _chunks->size()))
+        {
+            QUndoCommand *ac = new ArrayCommand(_chunks, ArrayCommand::overwrite, pos, ba);
+            ac->setText(txt);
+            push(ac);
+        }
+        else
+        {
+            beginMacro(txt);
+            removeAt(pos, len);
+            insert(pos, ba);
+            endMacro();
+        }
+    }
+}
+
+void UndoStack::transform(qint64 pos, qint64 len, const Transform &transform)
+{
+    QUndoCommand *tc = applyTransform(pos, len, transform, Chunks::ProgressFunction());
+    if (tc)
+        push(tc);
+}
+
+QUndoCommand *UndoStack::applyTransform(qint64 pos, qint64 len, const Transform &transform,
+                                        const Chunks::ProgressFunction &progress)
+{
+    if ((pos < 0) || (len <= 0) || ((pos + len) > _chunks->size()))
+        return NULL;
+    TransformCommand *tc = new TransformCommand(_chunks, pos, len, transform);
+    if (!tc->apply(progress))
+    {
+        delete tc;
+        return NULL;
     }
+    tc->setText(QString(tr("%1 %2 bytes")).arg(transform.name()).arg(len));
+    return tc;
 }
@@ -6,6 +6,7 @@
 #include <QUndoStack>
 
 #include "chunks.h"
+#include "transform.h"
 
 /*! CharCommand is a class to provid undo/redo functionality in QHexEdit.
 A QUndoCommand represents a single editing action on a document. CharCommand
@@ -20,9 +21,15 @@ If you for example insert a new byt "34" this means for the editor doing 3
 steps: insert a "00", overwrite it with "03" and the overwrite it with "34". These
 3 steps are combined into a single step, insert a "34".
 
-The byte array oriented commands are just put into a set of single byte commands,
-which are pooled together with the macroBegin() and macroEnd() functionality of
-Qt's QUndoStack.
+The byte array oriented commands are done by ArrayCommand, which changes the
+whole range in Chunks at once and keeps the replaced bytes for undo. This keeps
+pasting or deleting megabytes a single step, in time as well as on the stack.
+
+TransformCommand applies a Transform to a range block by block. Transforms,
+which have an inverse, are undone by it and keep no bytes. Only Fill keeps the
+replaced bytes; these and the highlighting flags are stored compressed.
+applyTransform() does the first pass in the calling thread, e.g. a worker, and
+the command, when pushed, skips its first redo.
 */
 
 class UndoStack : public QUndoStack
@@ -36,6 +43,11 @@ public:
     void removeAt(qint64 pos, qint64 len=1);
     void overwrite(qint64 pos, char c);
     void overwrite(qint64 pos, int len, const QByteArray &ba);
+    void transform(qint64 pos, qint64 len, const Transform &transform);
+    // Transforms the range right away, progress gets the bytes done and may
+    // abort, which restores the range. Returns the command to push() or NULL.
+    QUndoCommand *applyTransform(qint64 pos, qint64 len, const Transform &transform,
+                                 const Chunks::ProgressFunction &progress);
 
 private:
     Chunks * _chunks;
@@ -0,0 +1,63 @@
+#include "glyphcache.h"
+#include <QtMath>
+
+#define FIRST_GLYPH 0x20
+#define LAST_GLYPH 0x7e
+#define GLYPH_COUNT (LAST_GLYPH - FIRST_GLYPH + 1)
+
+
+GlyphCache::GlyphCache()
+    : _charWidth(0)
+    , _charHeight(0)
+    , _ascent(0)
+    , _dpr(1)
+{
+}
+
+void GlyphCache::setFont(const QFont &font, int charWidth, int charHeight, int ascent, qreal devicePixelRatio)
+{
+    if ((font == _font) && (charWidth == _charWidth) && (charHeight == _charHeight)
+        && (ascent == _ascent) && qFuzzyCompare(devicePixelRatio, _dpr))
+        return;
+    _font = font;
+    _charWidth = charWidth;
+    _charHeight = charHeight;
+    _ascent = ascent;
+    _dpr = devicePixelRatio;
+    _atlases.clear();
+}
+
+void GlyphCache::append(QVector<QPainter::PixmapFragment> &fragments, char c, qreal x, qreal y) const
+{
+    // Fragments are placed by their center, source rects are in device pixels
+    int idx = (uchar)c - FIRST_GLYPH;
+    fragments.append(QPainter::PixmapFragment::create(
+        QPointF(x + _charWidth / 2.0, y - _ascent + _charHeight / 2.0),
+        QRectF(idx * _charWidth * _dpr, 0, _charWidth * _dpr, _charHeight * _dpr),
+        1 / _dpr, 1 / _dpr));
+}
+
+void GlyphCache::draw(QPainter &painter, QVector<QPainter::PixmapFragment> &fragments, const QColor &color)
+{
+    if (!fragments.isEmpty())
+        painter.drawPixmapFragments(fragments.constData(), fragments.size(), atlas(color));
+    fragments.clear();
+}
+
+const QPixmap &GlyphCache::atlas(const QColor &color)
+{
+    auto it = _atlases.find(color.rgba());
+    if (it != _atlases.end())
+        return *it;
+
+    QPixmap pixmap(qCeil(GLYPH_COUNT * _charWidth * _dpr), qCeil(_charHeight * _dpr));
+    pixmap.setDevicePixelRatio(_dpr);
+    pixmap.fill(Qt::transparent);
+    QPainter painter(&pixmap);
+    painter.setFont(_font);
+    painter.setPen(color);
+    for (int idx=0; idx < GLYPH_COUNT; idx++)
+        painter.drawText(QPointF(idx * _charWidth, _ascent), QString(QChar(FIRST_GLYPH + idx)));
+    painter.end();
+    return *_atlases.insert(color.rgba(), pixmap);
+}
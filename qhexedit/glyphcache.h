@@ -0,0 +1,49 @@
+#ifndef GLYPHCACHE_H
+#define GLYPHCACHE_H
+
+/** \cond docNever */
+
+/*! GlyphCache pre-renders the printable ASCII characters (which include the hex
+ * digits) of the editor font into one pixmap per text color. QHexEdit then
+ * draws characters as pixmap fragments, collecting the fragments of a whole
+ * frame and handing them to QPainter::drawPixmapFragments() in one call per
+ * color, instead of shaping text for every single byte.
+ *
+ * The atlases are rendered at the device pixel ratio of the widget, so the
+ * fragments stay sharp on high DPI screens.
+ */
+
+#include <QFont>
+#include <QHash>
+#include <QPainter>
+#include <QPixmap>
+#include <QVector>
+
+class GlyphCache
+{
+public:
+    GlyphCache();
+
+    // Drops all atlases, if the font or its metrics changed
+    void setFont(const QFont &font, int charWidth, int charHeight, int ascent, qreal devicePixelRatio);
+
+    // Appends the fragment for printable char c with its baseline at (x, y)
+    void append(QVector<QPainter::PixmapFragment> &fragments, char c, qreal x, qreal y) const;
+
+    // Draws the collected fragments in color and clears them for reuse
+    void draw(QPainter &painter, QVector<QPainter::PixmapFragment> &fragments, const QColor &color);
+
+private:
+    const QPixmap &atlas(const QColor &color);
+
+    QFont _font;
+    int _charWidth;
+    int _charHeight;
+    int _ascent;
+    qreal _dpr;
+    QHash<QRgb, QPixmap> _atlases;
+};
+
+/** \endcond docNever */
+
+#endif // GLYPHCACHE_H
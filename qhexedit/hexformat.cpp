@@ -0,0 +1,453 @@
+#include "hexformat.h"
+#include <algorithm>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define HEXFORMAT_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define HEXFORMAT_NEON
+#endif
+
+#define BYTES_PER_LINE 16
+#define READABLE_TAIL (1 + 3 * BYTES_PER_LINE + 2 + BYTES_PER_LINE + 1 + 1) // line without address
+#define STREAM_BLOCK (BYTES_PER_LINE * 0x1000)
+
+static const char lowerDigits[] = "0123456789abcdef";
+static const char upperDigits[] = "0123456789ABCDEF";
+
+static int hexDigitCount(qint64 value)
+{
+    int count = 1;
+    while ((value >>= 4) != 0)
+        count += 1;
+    return count;
+}
+
+
+// ***************************************** Kernels
+
+void HexFormat::encode(const char *data, qint64 len, char *out, bool upperCase)
+{
+    const char *digits = upperCase ? upperDigits : lowerDigits;
+    qint64 idx = 0;
+#if defined(HEXFORMAT_SSE2)
+    // Nibbles are spread to one byte each, digits above 9 get the distance
+    // from '9' + 1 to 'a' (or 'A') added
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i letter = _mm_set1_epi8(digits[10] - '0' - 10);
+    for (; idx + 16 <= len; idx += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + idx));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        __m128i lo = _mm_and_si128(v, mask);
+        __m128i first = _mm_unpacklo_epi8(hi, lo);
+        __m128i second = _mm_unpackhi_epi8(hi, lo);
+        first = _mm_add_epi8(_mm_add_epi8(first, zero), _mm_and_si128(_mm_cmpgt_epi8(first, nine), letter));
+        second = _mm_add_epi8(_mm_add_epi8(second, zero), _mm_and_si128(_mm_cmpgt_epi8(second, nine), letter));
+        _mm_storeu_si128((__m128i *)(out + 2 * idx), first);
+        _mm_storeu_si128((__m128i *)(out + 2 * idx + 16), second);
+    }
+#elif defined(HEXFORMAT_NEON)
+    // Table lookup of both nibbles, the store interleaves them
+    const uint8x16_t table = vld1q_u8((const uint8_t *)digits);
+    const uint8x16_t mask = vdupq_n_u8(0x0f);
+    for (; idx + 16 <= len; idx += 16)
+    {
+        uint8x16_t v = vld1q_u8((const uint8_t *)(data + idx));
+        uint8x16x2_t hex;
+        hex.val[0] = vqtbl1q_u8(table, vshrq_n_u8(v, 4));
+        hex.val[1] = vqtbl1q_u8(table, vandq_u8(v, mask));
+        vst2q_u8((uint8_t *)(out + 2 * idx), hex);
+    }
+#endif
+    for (; idx < len; idx++)
+    {
+        uchar b = (uchar)data[idx];
+        out[2 * idx] = digits[b >> 4];
+        out[2 * idx + 1] = digits[b & 0x0f];
+    }
+}
+
+void HexFormat::printable(const char *data, qint64 len, char *out)
+{
+    qint64 idx = 0;
+#if defined(HEXFORMAT_SSE2)
+    // Compared as signed bytes, 0x80 and above are negative and drop out
+    const __m128i low = _mm_set1_epi8(0x1f);
+    const __m128i high = _mm_set1_epi8(0x7f);
+    const __m128i dot = _mm_set1_epi8('.');
+    for (; idx + 16 <= len; idx += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + idx));
+        __m128i ok = _mm_and_si128(_mm_cmpgt_epi8(v, low), _mm_cmplt_epi8(v, high));
+        _mm_storeu_si128((__m128i *)(out + idx), _mm_or_si128(_mm_and_si128(ok, v), _mm_andnot_si128(ok, dot)));
+    }
+#elif defined(HEXFORMAT_NEON)
+    const uint8x16_t low = vdupq_n_u8(0x20);
+    const uint8x16_t high = vdupq_n_u8(0x7e);
+    const uint8x16_t dot = vdupq_n_u8('.');
+    for (; idx + 16 <= len; idx += 16)
+    {
+        uint8x16_t v = vld1q_u8((const uint8_t *)(data + idx));
+        uint8x16_t ok = vandq_u8(vcgeq_u8(v, low), vcleq_u8(v, high));
+        vst1q_u8((uint8_t *)(out + idx), vbslq_u8(ok, v, dot));
+    }
+#endif
+    for (; idx < len; idx++)
+    {
+        char ch = data[idx];
+        out[idx] = ((ch < 0x20) || (ch > 0x7e)) ? '.' : ch;
+    }
+}
+
+
+// ***************************************** Formats
+
+QByteArray HexFormat::toHex(const QByteArray &ba, bool upperCase)
+{
+    QByteArray result(ba.size() * 2, Qt::Uninitialized);
+    encode(ba.constData(), ba.size(), result.data(), upperCase);
+    return result;
+}
+
+QByteArray HexFormat::toWrappedHex(const QByteArray &ba, bool upperCase)
+{
+    if (ba.isEmpty())
+        return QByteArray();
+    qint64 lines = (ba.size() + BYTES_PER_LINE - 1) / BYTES_PER_LINE;
+    QByteArray result(ba.size() * 2 + lines - 1, Qt::Uninitialized);
+    char *out = result.data();
+    for (qint64 idx = 0; idx < ba.size(); idx += BYTES_PER_LINE)
+    {
+        if (idx > 0)
+            *out++ = '\n';
+        qint64 count = std::min<qint64>(BYTES_PER_LINE, ba.size() - idx);
+        encode(ba.constData() + idx, count, out, upperCase);
+        out += 2 * count;
+    }
+    return result;
+}
+
+QByteArray HexFormat::toReadable(const QByteArray &ba, qint64 address, int addressWidth, bool upperCase)
+{
+    // Every line has the same layout, only the address may grow by digits
+    const char *digits = upperCase ? upperDigits : lowerDigits;
+    qint64 lines = (ba.size() + BYTES_PER_LINE - 1) / BYTES_PER_LINE;
+    int maxDigits = std::max(addressWidth, hexDigitCount(address + std::max<qint64>(ba.size() - 1, 0)));
+    QByteArray result(lines * (maxDigits + READABLE_TAIL), Qt::Uninitialized);
+    char *out = result.data();
+    char hex[2 * BYTES_PER_LINE];
+
+    for (qint64 idx = 0; idx < ba.size(); idx += BYTES_PER_LINE)
+    {
+        int count = (int)std::min<qint64>(BYTES_PER_LINE, ba.size() - idx);
+        qint64 lineAddress = address + idx;
+        int addrDigits = std::max(addressWidth, hexDigitCount(lineAddress));
+        for (int digit = addrDigits - 1; digit >= 0; digit--)
+            *out++ = (digit < 16) ? digits[(lineAddress >> (4 * digit)) & 0xf] : '0';
+        *out++ = ' ';
+
+        encode(ba.constData() + idx, count, hex, upperCase);
+        for (int col = 0; col < count; col++)
+        {
+            *out++ = ' ';
+            *out++ = hex[2 * col];
+            *out++ = hex[2 * col + 1];
+        }
+        memset(out, ' ', 3 * (BYTES_PER_LINE - count) + 2);
+        out += 3 * (BYTES_PER_LINE - count) + 2;
+
+        printable(ba.constData() + idx, count, out);
+        out += count;
+        memset(out, ' ', BYTES_PER_LINE + 1 - count);
+        out += BYTES_PER_LINE + 1 - count;
+        *out++ = '\n';
+    }
+    result.truncate(out - result.constData());
+    return result;
+}
+
+// ***************************************** Streaming
+
+bool HexFormat::write(QIODevice &device, Chunks &chunks, qint64 pos, qint64 count, Format format,
+                      qint64 address, int addressWidth, bool upperCase, const Chunks::ProgressFunction &progress)
+{
+    // Blocks are a multiple of the line length, so lines never span two
+    qint64 end = chunks.size();
+    if ((count >= 0) && ((pos + count) < end))
+        end = pos + count;
+    for (qint64 blockPos = pos; blockPos < end; blockPos += STREAM_BLOCK)
+    {
+        if (progress && !progress(blockPos))
+            return false;
+        QByteArray block = chunks.data(blockPos, std::min<qint64>(STREAM_BLOCK, end - blockPos));
+        if (block.isEmpty())
+            break;
+        QByteArray text;
+        switch (format)
+        {
+        case Hex:
+            text = toHex(block, upperCase);
+            break;
+        case WrappedHex:
+            text = toWrappedHex(block, upperCase);
+            if ((blockPos + block.size()) < end)
+                text.append('\n');
+            break;
+        case Readable:
+            text = toReadable(block, address + (blockPos - pos), addressWidth, upperCase);
+            break;
+        }
+        if (device.write(text) != text.size())
+            return false;
+    }
+    return true;
+}
+
+
+// ***************************************** Parser
+
+static inline bool isBlank(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == ',') || (c == ';');
+}
+
+static inline int nibble(char c)
+{
+    return (c <= '9') ? (c - '0') : ((c | 0x20) - 'a' + 10);
+}
+
+HexParser::HexParser()
+    : _tokenIdx(0), _gap(0), _width(0), _lineBytes(0), _address(false), _skipLine(false)
+{
+}
+
+bool HexParser::isHex(const char *digits, qint64 count)
+{
+    qint64 idx = 0;
+#if defined(HEXFORMAT_SSE2)
+    // Compared as signed bytes, non ascii chars are negative and drop out
+    const __m128i belowZero = _mm_set1_epi8('0' - 1);
+    const __m128i aboveNine = _mm_set1_epi8('9' + 1);
+    const __m128i belowA = _mm_set1_epi8('a' - 1);
+    const __m128i aboveF = _mm_set1_epi8('f' + 1);
+    const __m128i lower = _mm_set1_epi8(0x20);
+    for (; idx + 16 <= count; idx += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(digits + idx));
+        __m128i l = _mm_or_si128(v, lower);
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, belowZero), _mm_cmplt_epi8(v, aboveNine));
+        __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(l, belowA), _mm_cmplt_epi8(l, aboveF));
+        if (_mm_movemask_epi8(_mm_or_si128(digit, letter)) != 0xffff)
+            return false;
+    }
+#elif defined(HEXFORMAT_NEON)
+    for (; idx + 16 <= count; idx += 16)
+    {
+        uint8x16_t v = vld1q_u8((const uint8_t *)(digits + idx));
+        uint8x16_t l = vorrq_u8(v, vdupq_n_u8(0x20));
+        uint8x16_t digit = vandq_u8(vcgeq_u8(v, vdupq_n_u8('0')), vcleq_u8(v, vdupq_n_u8('9')));
+        uint8x16_t letter = vandq_u8(vcgeq_u8(l, vdupq_n_u8('a')), vcleq_u8(l, vdupq_n_u8('f')));
+        if (vminvq_u8(vorrq_u8(digit, letter)) != 0xff)
+            return false;
+    }
+#endif
+    for (; idx < count; idx++)
+    {
+        char c = digits[idx];
+        char l = c | 0x20;
+        if (!(((c >= '0') && (c <= '9')) || ((l >= 'a') && (l <= 'f'))))
+            return false;
+    }
+    return true;
+}
+
+void HexParser::decode(const char *digits, qint64 count, char *out)
+{
+    qint64 idx = 0;
+#if defined(HEXFORMAT_SSE2)
+    // Letters are mapped by their lower case code, a pair of nibbles is
+    // combined in each 16 bit lane and two vectors are packed to 16 bytes
+    const __m128i nine = _mm_set1_epi8('9');
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i letter = _mm_set1_epi8('a' - 10);
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i lowByte = _mm_set1_epi16(0x00ff);
+    for (; idx + 32 <= count; idx += 32)
+    {
+        __m128i pairs[2];
+        for (int half = 0; half < 2; half++)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(digits + idx + 16 * half));
+            __m128i isLetter = _mm_cmpgt_epi8(v, nine);
+            __m128i n = _mm_or_si128(_mm_and_si128(isLetter, _mm_sub_epi8(_mm_or_si128(v, lower), letter)),
+                                     _mm_andnot_si128(isLetter, _mm_sub_epi8(v, zero)));
+            pairs[half] = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(n, lowByte), 4), _mm_srli_epi16(n, 8));
+        }
+        _mm_storeu_si128((__m128i *)(out + idx / 2), _mm_packus_epi16(pairs[0], pairs[1]));
+    }
+#elif defined(HEXFORMAT_NEON)
+    // The load splits high and low digits into separate vectors
+    const uint8x16_t nine = vdupq_n_u8('9');
+    for (; idx + 32 <= count; idx += 32)
+    {
+        uint8x16x2_t v = vld2q_u8((const uint8_t *)(digits + idx));
+        uint8x16_t n[2];
+        for (int half = 0; half < 2; half++)
+            n[half] = vbslq_u8(vcgtq_u8(v.val[half], nine),
+                               vsubq_u8(vorrq_u8(v.val[half], vdupq_n_u8(0x20)), vdupq_n_u8('a' - 10)),
+                               vsubq_u8(v.val[half], vdupq_n_u8('0')));
+        vst1q_u8((uint8_t *)(out + idx / 2), vorrq_u8(vshlq_n_u8(n[0], 4), n[1]));
+    }
+#endif
+    for (; idx + 1 < count; idx += 2)
+        out[idx / 2] = (char)((nibble(digits[idx]) << 4) | nibble(digits[idx + 1]));
+}
+
+QByteArray HexParser::parse(const QByteArray &text)
+{
+    HexParser parser;
+    QByteArray result;
+    result.reserve(text.size() / 2);
+    parser.feed(text.constData(), text.size(), result);
+    parser.finish(result);
+    return result;
+}
+
+void HexParser::feed(const char *text, qint64 len, QByteArray &out)
+{
+    // Only text up to the last separator is parsed, a token may continue
+    _pending.append(text, len);
+    qint64 cut = _pending.size();
+    while ((cut > 0) && !isBlank(_pending.at(cut - 1)) && (_pending.at(cut - 1) != '\n'))
+        cut -= 1;
+    parseText(_pending.constData(), cut, out);
+    _pending.remove(0, cut);
+}
+
+void HexParser::finish(QByteArray &out)
+{
+    parseText(_pending.constData(), _pending.size(), out);
+    _pending.clear();
+    endLine(out);
+}
+
+void HexParser::parseText(const char *text, qint64 len, QByteArray &out)
+{
+    const char *p = text;
+    const char *end = text + len;
+    while (p < end)
+    {
+        if (*p == '\n')
+        {
+            endLine(out);
+            p += 1;
+        }
+        else if (_skipLine)
+        {
+            const char *eol = (const char *)memchr(p, '\n', end - p);
+            p = eol ? eol : end;
+        }
+        else if (isBlank(*p))
+        {
+            _gap += 1;
+            p += 1;
+        }
+        else
+        {
+            const char *tokenEnd = p;
+            while ((tokenEnd < end) && !isBlank(*tokenEnd) && (*tokenEnd != '\n'))
+                tokenEnd += 1;
+            parseToken(p, tokenEnd, out);
+            _gap = 0;
+            p = tokenEnd;
+        }
+    }
+}
+
+void HexParser::parseToken(const char *begin, const char *end, QByteArray &out)
+{
+    if (((end - begin) > 2) && (begin[0] == '0') && ((begin[1] | 0x20) == 'x'))
+        begin += 2;
+    bool colon = (end > begin) && (end[-1] == ':');
+    if (colon)
+        end -= 1;
+    qint64 count = end - begin;
+    if ((count == 0) || (colon && (_tokenIdx > 0)) || !isHex(begin, count))
+    {
+        _skipLine = true;
+        return;
+    }
+
+    // The first token may be an address, which the next one tells
+    if (_tokenIdx++ == 0)
+    {
+        if (colon)
+        {
+            _address = true;
+            return;
+        }
+        if (count > 2)
+        {
+            _held = QByteArray(begin, count);
+            return;
+        }
+    }
+    else if (!_held.isEmpty())
+    {
+        if (count == 2)
+            _address = true;
+        else
+            appendToken(_held.constData(), _held.size(), out);
+        _held.clear();
+    }
+
+    if (_address)
+    {
+        if ((_lineBytes > 0) && ((_gap >= 3) || ((_gap >= 2) && (_lineBytes >= BYTES_PER_LINE))))
+        {
+            _skipLine = true;
+            return;
+        }
+        if (_width == 0)
+            _width = (int)count;
+        else if (count != _width)
+        {
+            _skipLine = true;
+            return;
+        }
+    }
+    appendToken(begin, count, out);
+}
+
+void HexParser::appendToken(const char *digits, qint64 count, QByteArray &out)
+{
+    qint64 size = out.size();
+    qint64 bytes = (count + 1) / 2;
+    out.resize(size + bytes);
+    char *dst = out.data() + size;
+    if (count % 2)
+    {
+        *dst++ = (char)nibble(*digits++);
+        count -= 1;
+    }
+    decode(digits, count, dst);
+    _lineBytes += bytes;
+}
+
+void HexParser::endLine(QByteArray &out)
+{
+    if (!_held.isEmpty())
+        appendToken(_held.constData(), _held.size(), out);
+    _held.clear();
+    _tokenIdx = 0;
+    _gap = 0;
+    _width = 0;
+    _lineBytes = 0;
+    _address = false;
+    _skipLine = false;
+}
@@ -0,0 +1,103 @@
+#ifndef HEXFORMAT_H
+#define HEXFORMAT_H
+
+/** \cond docNever */
+
+/*! HexFormat turns binary data into the text formats QHexEdit hands out:
+ * plain hex, hex wrapped into lines of 16 bytes (clipboard) and the readable
+ * dump with address, hex and ascii columns.
+ *
+ * Hex digits and printable characters are produced 16 bytes at a time with
+ * SSE2 (x86) or NEON (AArch64), other targets use lookup tables. Every
+ * format is written in one pass into an output, which is sized up front.
+ * Outputs too large for memory or the clipboard can be streamed block by
+ * block from Chunks into a QIODevice.
+ */
+
+#include <QByteArray>
+#include <QIODevice>
+
+#include "chunks.h"
+
+class HexFormat
+{
+public:
+    enum Format
+    {
+        Hex,            // "00ff10"
+        WrappedHex,     // Hex with a line break after every 16 bytes
+        Readable        // "0000  00 ff 10 ...  ..."
+    };
+
+    // Writes 2*len hex digits to out
+    static void encode(const char *data, qint64 len, char *out, bool upperCase=false);
+
+    // Writes len chars to out, non printable bytes become '.'
+    static void printable(const char *data, qint64 len, char *out);
+
+    static QByteArray toHex(const QByteArray &ba, bool upperCase=false);
+    static QByteArray toWrappedHex(const QByteArray &ba, bool upperCase=false);
+
+    // Lines of 16 bytes, the first one at address, addresses have at least
+    // addressWidth digits
+    static QByteArray toReadable(const QByteArray &ba, qint64 address, int addressWidth, bool upperCase=false);
+
+    // Streams count bytes from pos on in format to device
+    static bool write(QIODevice &device, Chunks &chunks, qint64 pos, qint64 count, Format format,
+                      qint64 address=0, int addressWidth=4, bool upperCase=false,
+                      const Chunks::ProgressFunction &progress=Chunks::ProgressFunction());
+};
+
+/*! HexParser is the reverse of HexFormat. It decodes hex text as it comes
+ * from clipboards, dumps and source code: blanks, commas and semicolons
+ * separate tokens, "0x" prefixes are dropped and tokens with an odd number
+ * of digits get a leading zero.
+ *
+ * A line may start with an address column, which is skipped. It is either
+ * a first token ending in ':' (xxd, "0x1000:"), or a first token of more
+ * than 2 digits followed by a 2 digit token (HexFormat::Readable,
+ * hexdump -C). A line ends at its first token, which is no hex number
+ * (an ascii column or a comment). In lines with an address, tokens must
+ * keep the width of the first one, and a gap of 3 blanks, or 2 blanks after
+ * 16 bytes, starts the ascii column as well.
+ *
+ * Text can be fed in blocks of any size, digits are validated and decoded
+ * 16 bytes at a time.
+ */
+class HexParser
+{
+public:
+    HexParser();
+
+    // Appends the bytes decoded from text to out, an unterminated last token
+    // is kept for the next call
+    void feed(const char *text, qint64 len, QByteArray &out);
+
+    // Decodes what is left and resets the parser
+    void finish(QByteArray &out);
+
+    static QByteArray parse(const QByteArray &text);
+
+    // Kernels, digits must be valid and count even for decode()
+    static bool isHex(const char *digits, qint64 count);
+    static void decode(const char *digits, qint64 count, char *out);
+
+private:
+    void parseText(const char *text, qint64 len, QByteArray &out);
+    void parseToken(const char *begin, const char *end, QByteArray &out);
+    void appendToken(const char *digits, qint64 count, QByteArray &out);
+    void endLine(QByteArray &out);
+
+    QByteArray _pending;        // text after the last separator
+    QByteArray _held;           // first token, until it is known whether it is an address
+    int _tokenIdx;              // tokens seen in the line
+    int _gap;                   // blanks in front of the current token
+    int _width;                 // digits of the first data token, in lines with address
+    qint64 _lineBytes;          // bytes decoded from the line
+    bool _address;              // line starts with an address column
+    bool _skipLine;             // rest of the line is no data
+};
+
+/** \endcond docNever */
+
+#endif // HEXFORMAT_H
@@ -0,0 +1,171 @@
+#include "merkletree.h"
+#include <QCryptographicHash>
+#include <algorithm>
+
+
+// ***************************************** Shape
+
+static qint64 blocksFor(qint64 size)
+{
+    return std::max<qint64>(1, (size + MerkleTree::BlockSize - 1) / MerkleTree::BlockSize);
+}
+
+MerkleTree::MerkleTree()
+{
+    reset(0);
+}
+
+void MerkleTree::reset(qint64 size)
+{
+    _size = size;
+    _levels.clear();
+    for (qint64 count = blocksFor(size); ; count = (count + 1) / 2)
+    {
+        _levels.append(QVector<QByteArray>(count));
+        if (count == 1)
+            break;
+    }
+}
+
+void MerkleTree::invalidate(qint64 pos, qint64 length, qint64 size)
+{
+    // A new size changes the right edge of the tree, which is dirtied with
+    // everything behind the shorter of both sizes
+    qint64 first = pos / BlockSize;
+    qint64 last = (length < 0) ? -1 : (pos + length - 1) / BlockSize;
+    if (length == 0)
+        last = first - 1;
+    if (size != _size)
+    {
+        first = std::min(first, std::min(size, _size) / BlockSize);
+        last = -1;
+        qint64 count = blocksFor(size);
+        int level = 0;
+        for (; ; count = (count + 1) / 2, level++)
+        {
+            if (level == _levels.size())
+                _levels.append(QVector<QByteArray>());
+            _levels[level].resize(count);
+            if (count == 1)
+                break;
+        }
+        _levels.resize(level + 1);
+        _size = size;
+    }
+
+    for (int level = 0; level < _levels.size(); level++)
+    {
+        QVector<QByteArray> &nodes = _levels[level];
+        qint64 begin = first >> level;
+        qint64 end = (last < 0) ? nodes.size() - 1 : std::min<qint64>(last >> level, nodes.size() - 1);
+        for (qint64 idx = begin; idx <= end; idx++)
+            nodes[idx].clear();
+    }
+}
+
+
+// ***************************************** Hashing
+
+QByteArray MerkleTree::update(const ReadFunction &read, const FillFunction &fill)
+{
+    return hashNode(_levels.size() - 1, 0, read, fill);
+}
+
+QByteArray MerkleTree::hashNode(int level, qint64 idx, const ReadFunction &read, const FillFunction &fill)
+{
+    QByteArray &node = _levels[level][idx];
+    if (!node.isEmpty())
+        return node;
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if (level == 0)
+    {
+        qint64 pos = idx * BlockSize;
+        qint64 len = std::min(BlockSize, _size - pos);
+        char value;
+        if (fill && (len == BlockSize) && (fill(pos, &value) >= len))
+        {
+            QByteArray &cached = _fillHashes[(uchar)value];
+            if (cached.isEmpty())
+            {
+                hash.addData(QByteArrayView("\x00", 1));
+                hash.addData(QByteArray(BlockSize, value));
+                cached = hash.result();
+            }
+            node = cached;
+        }
+        else
+        {
+            hash.addData(QByteArrayView("\x00", 1));
+            hash.addData(read(pos, len));
+            node = hash.result();
+        }
+    }
+    else if ((2 * idx + 1) < _levels.at(level - 1).size())
+    {
+        hash.addData(QByteArrayView("\x01", 1));
+        hash.addData(hashNode(level - 1, 2 * idx, read, fill));
+        hash.addData(hashNode(level - 1, 2 * idx + 1, read, fill));
+        node = hash.result();
+    }
+    else
+        node = hashNode(level - 1, 2 * idx, read, fill);
+    return node;
+}
+
+QByteArray MerkleTree::rootHash() const
+{
+    return _levels.last().first();
+}
+
+qint64 MerkleTree::size() const
+{
+    return _size;
+}
+
+qint64 MerkleTree::blockCount() const
+{
+    return _levels.first().size();
+}
+
+bool MerkleTree::isDirty() const
+{
+    return rootHash().isEmpty();
+}
+
+
+// ***************************************** Comparison
+
+QVector<qint64> MerkleTree::differingBlocks(const MerkleTree &a, const MerkleTree &b)
+{
+    Q_ASSERT(!a.isDirty() && !b.isDirty());
+    QVector<qint64> blocks;
+    if (a.blockCount() == b.blockCount())
+    {
+        descend(a, b, a._levels.size() - 1, 0, blocks);
+        return blocks;
+    }
+
+    // Trees of different shape only share their blocks
+    qint64 common = std::min(a.blockCount(), b.blockCount());
+    for (qint64 idx = 0; idx < common; idx++)
+        if (a._levels.first().at(idx) != b._levels.first().at(idx))
+            blocks.append(idx);
+    for (qint64 idx = common; idx < std::max(a.blockCount(), b.blockCount()); idx++)
+        blocks.append(idx);
+    return blocks;
+}
+
+void MerkleTree::descend(const MerkleTree &a, const MerkleTree &b, int level, qint64 idx, QVector<qint64> &blocks)
+{
+    if (a._levels.at(level).at(idx) == b._levels.at(level).at(idx))
+        return;
+    if (level == 0)
+    {
+        blocks.append(idx);
+        return;
+    }
+    descend(a, b, level - 1, 2 * idx, blocks);
+    if ((2 * idx + 1) < a._levels.at(level - 1).size())
+        descend(a, b, level - 1, 2 * idx + 1, blocks);
+}
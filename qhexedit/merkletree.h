@@ -0,0 +1,67 @@
+#ifndef MERKLETREE_H
+#define MERKLETREE_H
+
+/** \cond docNever */
+
+/*! MerkleTree keeps SHA-256 hashes of the 4 KiB blocks of an image and of
+ * pairs of them up to a single root, the digest of the whole image.
+ *
+ * Edits only mark the blocks they touch dirty, together with the nodes above
+ * them. update() then hashes dirty blocks again and combines only the dirty
+ * nodes, so after overwriting some bytes the digest costs one block hash
+ * and log2(blocks) node hashes. Inserting or removing bytes moves all
+ * blocks behind the edit, so these are dirty up to the end.
+ *
+ * Two up to date trees tell, which blocks of their images differ, by only
+ * descending into subtrees with different hashes.
+ *
+ * Leaves hash 0x00 and the block, nodes 0x01 and both children, a node
+ * without right child takes the hash of its left one. Blocks, which are one
+ * fill value, are not read: their hash is computed once per value.
+ */
+
+#include <QtCore>
+#include <functional>
+
+class MerkleTree
+{
+public:
+    // Reads len bytes at pos of the image
+    typedef std::function<QByteArray(qint64 pos, qint64 len)> ReadFunction;
+    // Bytes equal to *value from pos on, see Chunks::fillLength()
+    typedef std::function<qint64(qint64 pos, char *value)> FillFunction;
+
+    static const qint64 BlockSize = 0x1000;
+
+    MerkleTree();
+
+    // Image of size bytes, all blocks dirty
+    void reset(qint64 size);
+
+    // Marks the blocks of [pos, pos+length) dirty, length -1 up to the end.
+    // size is the size of the image after the edit.
+    void invalidate(qint64 pos, qint64 length, qint64 size);
+
+    // Hashes dirty blocks and nodes, returns the root hash
+    QByteArray update(const ReadFunction &read, const FillFunction &fill=FillFunction());
+
+    QByteArray rootHash() const;            // empty while dirty
+    qint64 size() const;
+    qint64 blockCount() const;
+    bool isDirty() const;
+
+    // Indices of the blocks, which differ in the images of two up to date trees
+    static QVector<qint64> differingBlocks(const MerkleTree &a, const MerkleTree &b);
+
+private:
+    QByteArray hashNode(int level, qint64 idx, const ReadFunction &read, const FillFunction &fill);
+    static void descend(const MerkleTree &a, const MerkleTree &b, int level, qint64 idx, QVector<qint64> &blocks);
+
+    qint64 _size;
+    QVector<QVector<QByteArray>> _levels;   // _levels[0] are blocks, last one is the root, empty hashes are dirty
+    QHash<uchar, QByteArray> _fillHashes;   // hash of a whole block of one byte value
+};
+
+/** \endcond docNever */
+
+#endif // MERKLETREE_H
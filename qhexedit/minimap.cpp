@@ -0,0 +1,311 @@
+#include "minimap.h"
+#include <QMouseEvent>
+#include <QPainter>
+#include <QtConcurrent>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define MINIMAP_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define MINIMAP_NEON
+#endif
+
+#define MIN_BLOCK_SIZE 0x1000
+#define MAX_BLOCKS 0x10000                      // larger images get larger blocks
+#define BLOCKS_PER_RUN 1024                     // blocks computed per worker run, results show up in between
+
+
+// ***************************************** Statistics
+
+BlockStats BlockStats::compute(const char *data, qint64 len)
+{
+    // Four interleaved histograms, so successive equal bytes (padding) do not
+    // wait for each other's increment. A scatter into 256 bins has no SIMD
+    // form before AVX-512, so vectors only test 16 bytes for one value at once:
+    // runs of padding count 16 per step, other bytes go to the histograms.
+    quint32 counts[4][256];
+    memset(counts, 0, sizeof(counts));
+    const uchar *p = (const uchar *)data;
+    qint64 idx = 0;
+#if defined(MINIMAP_SSE2) || defined(MINIMAP_NEON)
+    for (; idx + 16 <= len; idx += 16)
+    {
+#if defined(MINIMAP_SSE2)
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + idx));
+        bool uniform = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)p[idx]))) == 0xffff;
+#else
+        uint8x16_t v = vld1q_u8(p + idx);
+        bool uniform = vminvq_u8(vceqq_u8(v, vdupq_n_u8(p[idx]))) == 0xff;
+#endif
+        if (uniform)
+        {
+            counts[0][p[idx]] += 16;
+            continue;
+        }
+        for (int lane = 0; lane < 16; lane += 4)
+        {
+            counts[0][p[idx + lane]] += 1;
+            counts[1][p[idx + lane + 1]] += 1;
+            counts[2][p[idx + lane + 2]] += 1;
+            counts[3][p[idx + lane + 3]] += 1;
+        }
+    }
+#endif
+    for (; idx + 4 <= len; idx += 4)
+    {
+        counts[0][p[idx]] += 1;
+        counts[1][p[idx + 1]] += 1;
+        counts[2][p[idx + 2]] += 1;
+        counts[3][p[idx + 3]] += 1;
+    }
+    for (; idx < len; idx++)
+        counts[0][p[idx]] += 1;
+
+    BlockStats stats = { 0, 0, 0, 0 };
+    if (len <= 0)
+        return stats;
+    quint32 printable = 0;
+    for (int b = 0; b < 256; b++)
+    {
+        quint32 count = counts[0][b] + counts[1][b] + counts[2][b] + counts[3][b];
+        if (count == 0)
+            continue;
+        float share = (float)count / len;
+        stats.entropy -= share * log2f(share);
+        if (((b >= 0x20) && (b <= 0x7e)) || (b == '\t') || (b == '\r') || (b == '\n'))
+            printable += count;
+        if (b == 0x00)
+            stats.zeroShare = share;
+        if (b == 0xff)
+            stats.ffShare = share;
+    }
+    stats.printableShare = (float)printable / len;
+    return stats;
+}
+
+static QRgb colorFor(const BlockStats &stats)
+{
+    if (stats.zeroShare >= 0.9f)
+        return qRgb(0x40, 0x40, 0x40);
+    if (stats.ffShare >= 0.9f)
+        return qRgb(0xe8, 0xe8, 0xe8);
+    if (stats.entropy >= 7.0f)
+        return qRgb(0xd0, 0x30, 0x30);
+    if (stats.printableShare >= 0.8f)
+        return qRgb(0x40, 0xb0, 0x40);
+    int light = (int)(stats.entropy * 16);
+    return qRgb(0x20 + light / 2, 0x40 + light, 0xe0);
+}
+
+
+// ***************************************** Minimap
+
+Minimap::Minimap(Chunks *chunks, QWidget *parent) : QWidget(parent)
+    , _chunks(chunks)
+    , _size(0)
+    , _blockSize(MIN_BLOCK_SIZE)
+    , _imageValid(false)
+    , _visibleFirst(0)
+    , _visibleLast(-1)
+{
+    setCursor(Qt::PointingHandCursor);
+    connect(_chunks, SIGNAL(rangeChanged(qint64,qint64)), this, SLOT(rangeChanged(qint64,qint64)));
+    connect(&_watcher, SIGNAL(finished()), this, SLOT(blocksFinished()));
+    resetBlocks();
+}
+
+Minimap::~Minimap()
+{
+    _watcher.cancel();
+    _watcher.waitForFinished();
+}
+
+void Minimap::cancel()
+{
+    _watcher.cancel();
+    _watcher.waitForFinished();
+}
+
+void Minimap::setVisibleRange(qint64 first, qint64 last)
+{
+    if ((first == _visibleFirst) && (last == _visibleLast))
+        return;
+    _visibleFirst = first;
+    _visibleLast = last;
+    update();
+}
+
+void Minimap::resetBlocks()
+{
+    // Results of a running worker belong to the former layout
+    _watcher.cancel();
+    _size = _chunks->size();
+    _blockSize = MIN_BLOCK_SIZE;
+    while ((_size / _blockSize) >= MAX_BLOCKS)
+        _blockSize *= 2;
+    int count = (int)((_size + _blockSize - 1) / _blockSize);
+    _stats = QVector<BlockStats>(count);
+    _valid = QBitArray(count);
+    _dirty = QBitArray(count, true);
+    _imageValid = false;
+    update();
+    startWorker();
+}
+
+void Minimap::rangeChanged(qint64 pos, qint64 length)
+{
+    // Stats of dirty blocks are shown until they are computed again, so the
+    // strip does not flicker while typing
+    qint64 size = _chunks->size();
+    qint64 blockSize = MIN_BLOCK_SIZE;
+    while ((size / blockSize) >= MAX_BLOCKS)
+        blockSize *= 2;
+    if ((blockSize != _blockSize) || (pos == 0 && length < 0))
+    {
+        resetBlocks();
+        return;
+    }
+
+    int count = (int)((size + _blockSize - 1) / _blockSize);
+    _stats.resize(count);
+    _valid.resize(count);
+    _dirty.resize(count);
+    _size = size;
+    int first = (int)(pos / _blockSize);
+    int last = (length < 0) ? count - 1 : (int)std::min<qint64>((pos + length - 1) / _blockSize, count - 1);
+    for (int idx = first; idx <= last; idx++)
+        _dirty.setBit(idx);
+    _imageValid = false;
+    update();
+    startWorker();
+}
+
+void Minimap::startWorker()
+{
+    // One run at a time, blocksFinished() starts the next one
+    if (_watcher.isRunning())
+        return;
+    QVector<int> blocks;
+    for (int idx = 0; (idx < _dirty.size()) && (blocks.size() < BLOCKS_PER_RUN); idx++)
+        if (_dirty.testBit(idx))
+        {
+            blocks.append(idx);
+            _dirty.clearBit(idx);
+        }
+    if (blocks.isEmpty())
+        return;
+
+    Chunks *chunks = _chunks;
+    qint64 blockSize = _blockSize;
+    _watcher.setFuture(QtConcurrent::run([chunks, blocks, blockSize](QPromise<BlockResults> &promise) {
+        BlockResults results;
+        for (int idx : blocks)
+        {
+            if (promise.isCanceled())
+                return;
+            QByteArray data = chunks->data(idx * blockSize, blockSize);
+            results.append(qMakePair(idx, BlockStats::compute(data.constData(), data.size())));
+        }
+        promise.addResult(results);
+    }));
+}
+
+void Minimap::blocksFinished()
+{
+    // Blocks dirtied again while running stay dirty and are done next run
+    if (!_watcher.isCanceled() && (_watcher.future().resultCount() > 0))
+    {
+        for (auto &result : _watcher.result())
+            if (result.first < _stats.size())
+            {
+                _stats[result.first] = result.second;
+                _valid.setBit(result.first);
+            }
+        _imageValid = false;
+        update();
+    }
+    startWorker();
+}
+
+
+// ***************************************** Painting and mouse
+
+void Minimap::updateImage()
+{
+    // Each pixel row averages the blocks it covers
+    int height = std::max(1, this->height());
+    int width = std::max(1, this->width());
+    _image = QImage(width, height, QImage::Format_RGB32);
+    QRgb background = palette().color(QPalette::Window).rgb();
+    int count = _stats.size();
+    for (int y = 0; y < height; y++)
+    {
+        int first = (int)((qint64)y * count / height);
+        int last = std::max(first + 1, (int)((qint64)(y + 1) * count / height));
+        BlockStats sum = { 0, 0, 0, 0 };
+        int valid = 0;
+        for (int idx = first; (idx < last) && (idx < count); idx++)
+            if (_valid.testBit(idx))
+            {
+                sum.entropy += _stats[idx].entropy;
+                sum.zeroShare += _stats[idx].zeroShare;
+                sum.ffShare += _stats[idx].ffShare;
+                sum.printableShare += _stats[idx].printableShare;
+                valid += 1;
+            }
+        QRgb color = background;
+        if (valid > 0)
+        {
+            BlockStats average = { sum.entropy / valid, sum.zeroShare / valid,
+                                   sum.ffShare / valid, sum.printableShare / valid };
+            color = colorFor(average);
+        }
+        QRgb *line = (QRgb *)_image.scanLine(y);
+        std::fill(line, line + width, color);
+    }
+    _imageValid = true;
+}
+
+void Minimap::paintEvent(QPaintEvent *)
+{
+    if (!_imageValid || (_image.size() != size()))
+        updateImage();
+    QPainter painter(this);
+    painter.drawImage(0, 0, _image);
+
+    if ((_size > 0) && (_visibleLast >= _visibleFirst))
+    {
+        int top = (int)((double)_visibleFirst * height() / _size);
+        int bottom = std::max(top + 2, (int)((double)(_visibleLast + 1) * height() / _size));
+        painter.setPen(QPen(palette().color(QPalette::Highlight), 2));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRect(QRect(1, top, width() - 2, bottom - top));
+    }
+}
+
+void Minimap::resizeEvent(QResizeEvent *)
+{
+    _imageValid = false;
+}
+
+qint64 Minimap::positionAt(int y)
+{
+    y = qBound(0, y, std::max(0, height() - 1));
+    return (qint64)((double)y * _size / std::max(1, height()));
+}
+
+void Minimap::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+        emit positionClicked(positionAt(event->pos().y()));
+}
+
+void Minimap::mouseMoveEvent(QMouseEvent *event)
+{
+    if (event->buttons() & Qt::LeftButton)
+        emit positionClicked(positionAt(event->pos().y()));
+}
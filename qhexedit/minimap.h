@@ -0,0 +1,88 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+/** \cond docNever */
+
+/*! Minimap is the overview strip QHexEdit shows beside its vertical
+ * scrollbar. Every pixel row stands for a part of the image and is colored
+ * by what the bytes there look like:
+ *
+ *   padding (mostly 0x00 or 0xff)   dark grey / light grey
+ *   compressed or encrypted         red (entropy of 7 bits per byte and more)
+ *   text                            green (mostly printable ascii)
+ *   code and other data             blue, lighter with higher entropy
+ *
+ * The statistics are kept per block of the image. A worker thread computes
+ * blocks, which are dirty, from byte histograms. Edits reported by
+ * Chunks::rangeChanged() only dirty the blocks they touch, so only these are
+ * read again. Clicking or dragging in the strip emits positionClicked().
+ */
+
+#include <QBitArray>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QWidget>
+
+#include "chunks.h"
+
+struct BlockStats
+{
+    float entropy;              // bits per byte, 0..8
+    float zeroShare;            // share of 0x00 bytes
+    float ffShare;              // share of 0xff bytes
+    float printableShare;       // share of 0x20..0x7e, \t, \r and \n
+
+    static BlockStats compute(const char *data, qint64 len);
+};
+
+class Minimap : public QWidget
+{
+    Q_OBJECT
+
+public:
+    Minimap(Chunks *chunks, QWidget *parent);
+    ~Minimap();
+
+    // Bytes shown by the editor, drawn as frame
+    void setVisibleRange(qint64 first, qint64 last);
+    // Stops the worker, e.g. before the device of the chunks is replaced. It
+    // starts again with the next change.
+    void cancel();
+
+signals:
+    void positionClicked(qint64 pos);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+    void resizeEvent(QResizeEvent *event);
+    void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+
+private slots:
+    void rangeChanged(qint64 pos, qint64 length);
+    void blocksFinished();
+
+private:
+    typedef QVector<QPair<int, BlockStats>> BlockResults;
+
+    void resetBlocks();
+    void startWorker();
+    void updateImage();
+    qint64 positionAt(int y);
+
+    Chunks *_chunks;
+    qint64 _size;                               // image size the blocks were laid out for
+    qint64 _blockSize;
+    QVector<BlockStats> _stats;
+    QBitArray _valid;                           // _stats[idx] was computed
+    QBitArray _dirty;                           // block needs to be computed (again)
+    QFutureWatcher<BlockResults> _watcher;
+    QImage _image;                              // rendered strip, one pixel per row
+    bool _imageValid;
+    qint64 _visibleFirst;
+    qint64 _visibleLast;
+};
+
+/** \endcond docNever */
+
+#endif // MINIMAP_H
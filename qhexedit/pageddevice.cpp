@@ -0,0 +1,184 @@
+#include "pageddevice.h"
+#include <algorithm>
+#include <string.h>
+
+#define PAGE_BYTES 0x400                        // unit of requests and of the cache
+#define CACHE_PAGES 0x1000                      // pages kept, 4 MiB
+#define MAX_REQUEST_PAGES 0x10                  // consecutive wanted pages are requested together
+#define MAX_WANTED_PAGES 0x100                  // older wanted pages are given up
+#define PREFETCH_PAGES 0x10                     // ahead of the view in scroll direction
+#define VIEW_PAGES 0x20                         // reads this close to the view ask for their pages
+#define FETCH_LIMIT 0x8000                      // larger reads are served from the cache only
+#define PLACEHOLDER '\0'                        // read for pages not there yet
+
+
+// ***************************************** PagedDevice
+
+PagedDevice::PagedDevice(qint64 address, qint64 size, QObject *parent) : QIODevice(parent)
+    , _address(address)
+    , _size(size)
+    , _pages(CACHE_PAGES)
+    , _requestPage(0)
+    , _requestCount(0)
+    , _viewPage(0)
+    , _direction(1)
+{
+}
+
+qint64 PagedDevice::address() const
+{
+    return _address;
+}
+
+int PagedDevice::cachedPages() const
+{
+    QMutexLocker locker(&_mutex);
+    return int(_pages.count());
+}
+
+qint64 PagedDevice::pageLength(qint64 page) const
+{
+    return std::min<qint64>(PAGE_BYTES, _size - page * PAGE_BYTES);
+}
+
+
+// ***************************************** Requests
+
+void PagedDevice::want(qint64 page)
+{
+    if ((page < 0) || (page * PAGE_BYTES >= _size) || _pages.contains(page))
+        return;
+    if ((_requestCount > 0) && (page >= _requestPage) && (page < _requestPage + _requestCount))
+        return;
+    _wanted.removeOne(page);
+    _wanted.prepend(page);
+    while (_wanted.size() > MAX_WANTED_PAGES)
+        _givenUp.append(_wanted.takeLast());
+}
+
+bool PagedDevice::takeRequest()
+{
+    // The run around the most urgent page, as far as its neighbours are wanted too
+    if ((_requestCount > 0) || _wanted.isEmpty())
+        return false;
+    qint64 first = _wanted.first();
+    qint64 last = first;
+    while ((last - first + 1 < MAX_REQUEST_PAGES) && _wanted.contains(last + 1))
+        last++;
+    while ((last - first + 1 < MAX_REQUEST_PAGES) && _wanted.contains(first - 1))
+        first--;
+    for (qint64 page = first; page <= last; page++)
+        _wanted.removeOne(page);
+    _requestPage = first;
+    _requestCount = last - first + 1;
+    return true;
+}
+
+void PagedDevice::readFinished(qint64 address, const QByteArray &data)
+{
+    QMutexLocker locker(&_mutex);
+    if ((_requestCount == 0) || (address != _address + _requestPage * PAGE_BYTES))
+        return;                                 // not ours, e.g. for a former device
+
+    // A short answer keeps its whole pages, the others stay missing
+    qint64 first = _requestPage;
+    qint64 loaded = 0;
+    for (qint64 page = first; page < first + _requestCount; page++)
+    {
+        qint64 length = pageLength(page);
+        if (loaded + length > data.size())
+            break;
+        _pages.insert(page, new QByteArray(data.mid(loaded, length)));
+        loaded += length;
+    }
+    _requestCount = 0;
+
+    bool request = takeRequest();
+    qint64 requestPos = _requestPage * PAGE_BYTES;
+    qint64 requestLength = std::min(_requestCount * PAGE_BYTES, _size - requestPos);
+    locker.unlock();
+    if (loaded > 0)
+        emit pagesChanged(first * PAGE_BYTES, loaded);
+    if (request)
+        emit readRequested(_address + requestPos, requestLength);
+}
+
+
+// ***************************************** QIODevice
+
+bool PagedDevice::open(OpenMode mode)
+{
+    if (mode & WriteOnly)
+        return false;
+    return QIODevice::open(mode | Unbuffered);
+}
+
+bool PagedDevice::isSequential() const
+{
+    return false;
+}
+
+qint64 PagedDevice::size() const
+{
+    return _size;
+}
+
+qint64 PagedDevice::readData(char *data, qint64 maxSize)
+{
+    qint64 pos = this->pos();
+    if ((pos >= _size) || (maxSize <= 0))
+        return 0;
+    maxSize = std::min(maxSize, _size - pos);
+    qint64 first = pos / PAGE_BYTES;
+    qint64 last = (pos + maxSize - 1) / PAGE_BYTES;
+
+    QMutexLocker locker(&_mutex);
+    bool fetch = maxSize <= FETCH_LIMIT;
+    if (fetch && (QThread::currentThread() == thread()))
+    {
+        // The GUI thread reads what is shown, this moves the view. Prefetched
+        // pages are wanted first, so they line up behind the pages read.
+        if (first != _viewPage)
+            _direction = (first > _viewPage) ? 1 : -1;
+        _viewPage = first;
+        for (qint64 idx = PREFETCH_PAGES; idx > 0; idx--)
+            want((_direction > 0) ? last + idx : first - idx);
+    }
+    fetch = fetch && (last >= _viewPage - VIEW_PAGES) && (first <= _viewPage + VIEW_PAGES);
+
+    qint64 done = 0;
+    QList<qint64> missing;
+    for (qint64 page = first; page <= last; page++)
+    {
+        qint64 ofs = (page == first) ? pos - first * PAGE_BYTES : 0;
+        qint64 count = std::min(pageLength(page) - ofs, maxSize - done);
+        if (const QByteArray *bytes = _pages.object(page))
+            memcpy(data + done, bytes->constData() + ofs, count);
+        else
+        {
+            memset(data + done, PLACEHOLDER, count);
+            missing.append(page);
+        }
+        done += count;
+    }
+    if (fetch)
+        for (int idx = missing.size() - 1; idx >= 0; idx--)
+            want(missing.at(idx));
+
+    bool request = takeRequest();
+    qint64 requestPos = _requestPage * PAGE_BYTES;
+    qint64 requestLength = std::min(_requestCount * PAGE_BYTES, _size - requestPos);
+    QList<qint64> givenUp;
+    givenUp.swap(_givenUp);
+    locker.unlock();
+    for (qint64 page : givenUp)
+        emit pagesChanged(page * PAGE_BYTES, pageLength(page));
+    if (request)
+        emit readRequested(_address + requestPos, requestLength);
+    return done;
+}
+
+qint64 PagedDevice::writeData(const char *, qint64)
+{
+    return -1;
+}
@@ -0,0 +1,76 @@
+#ifndef PAGEDDEVICE_H
+#define PAGEDDEVICE_H
+
+/** \cond docNever */
+
+/*! PagedDevice is a read only QIODevice for memory, which is far away (e.g.
+ * on a target behind a debug probe) and paged in on demand.
+ *
+ * The bytes come in pages of PAGE_BYTES. Pages read so far are kept in a
+ * cache, the least recently used ones are dropped first. Reading a page,
+ * which is not there, gives placeholder bytes and asks for the page with
+ * readRequested(). The owner answers with readFinished(), then the device
+ * tells with pagesChanged() that readers get the real bytes now.
+ *
+ * Only one request is out at a time. Missing pages wait in a list, newest
+ * first, and consecutive ones are requested together. The view is where the
+ * GUI thread read last: reads near it (also the read ahead of QHexEdit in
+ * worker threads) ask for their pages, and some pages ahead of it in scroll
+ * direction are prefetched. Reads elsewhere and large reads (exports, scans)
+ * only get what is cached, so browsing transfers just what is looked at.
+ * Pages waiting too long are given up and announced by pagesChanged() too, so
+ * readers, which keep placeholders, read them again when needed.
+ *
+ * Both signals may be emitted from within a read, i.e. while Chunks is locked
+ * and from worker threads. Connect them queued.
+ */
+
+#include <QtCore>
+
+class PagedDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    PagedDevice(qint64 address, qint64 size, QObject *parent=0);
+
+    qint64 address() const;                     // of the first byte, requests use addresses
+    int cachedPages() const;
+
+    // QIODevice
+    bool open(OpenMode mode) override;
+    bool isSequential() const override;
+    qint64 size() const override;
+
+public slots:
+    // Answer to readRequested(), data is empty when the read failed
+    void readFinished(qint64 address, const QByteArray &data);
+
+signals:
+    void readRequested(qint64 address, qint64 length);
+    void pagesChanged(qint64 pos, qint64 length);
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    void want(qint64 page);                     // first in line, unless cached or requested
+    bool takeRequest();                         // next run of wanted pages, false if none or one is out
+    qint64 pageLength(qint64 page) const;
+
+    qint64 _address;
+    qint64 _size;
+    mutable QMutex _mutex;                      // readers run in worker threads too
+    QCache<qint64, QByteArray> _pages;
+    QList<qint64> _wanted;                      // missing pages, most urgent first
+    QList<qint64> _givenUp;                     // dropped from _wanted, not yet announced
+    qint64 _requestPage;                        // first page of the request out
+    qint64 _requestCount;                       // 0 if none is out
+    qint64 _viewPage;
+    int _direction;                             // of the view, 1 down, -1 up
+};
+
+/** \endcond docNever */
+
+#endif // PAGEDDEVICE_H
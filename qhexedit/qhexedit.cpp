@@ -1,12 +1,23 @@
 #include <QApplication>
 #include <QClipboard>
+#include <QEventLoop>
 #include <QKeyEvent>
 #include <QPainter>
+#include <QProgressDialog>
 #include <QScrollBar>
+#include <QtConcurrent>
+#include <QtMath>
 
 #include "qhexedit.h"
 #include <algorithm>
 
+// Above this many lines the vertical scrollbar maps proportionally onto lines
+#define MAX_SCROLL_RANGE 0x10000000
+#define PASTE_BLOCK 0x100000            // clipboard text parsed per step
+#define PASTE_PROGRESS 0x400000         // larger texts show a progress dialog
+#define MINIMAP_WIDTH 24                // pixels right of the viewport
+#define TRANSFORM_ASYNC 0x400000        // larger selections are transformed by a worker
+
 
 // ********************************************************************** Constructor, destructor
 
@@ -24,8 +35,22 @@ QHexEdit::QHexEdit(QWidget *parent) : QAbstractScrollArea(parent)
     , _editAreaIsAscii(false)
     , _chunks(new Chunks(this))
     , _cursorPosition(0)
+    , _bSelectionBegin(0)
+    , _bSelectionEnd(0)
+    , _bSelectionInit(0)
+    , _topLine(0)
+    , _maxTopLine(0)
+    , _wheelDelta(0)
+    , _rowsFirstLine(0)
+    , _rowsBytesPerLine(0)
+    , _rowsGeneration(0)
+    , _scrollDirection(1)
+    , _tileStyle(0)
     , _lastEventSize(0)
     , _undoStack(new UndoStack(_chunks, this))
+    , _minimap(NULL)
+    , _transformWatcher(NULL)
+    , _transformStopped(false)
 {
 #ifdef Q_OS_WIN32
     setFont(QFont("Courier", 10));
@@ -34,18 +59,27 @@ QHexEdit::QHexEdit(QWidget *parent) : QAbstractScrollArea(parent)
 #endif
     setAddressAreaColor(this->palette().alternateBase().color());
     setHighlightingColor(QColor(0xff, 0xff, 0x99, 0xff));
+    setMarkColor(QColor(0xff, 0xb0, 0xb0, 0xff));
     setSelectionColor(this->palette().highlight().color());
     setAddressFontColor(QPalette::WindowText);
     setAsciiAreaColor(this->palette().alternateBase().color());
     setAsciiFontColor(QPalette::WindowText);
 
     connect(&_cursorTimer, SIGNAL(timeout()), this, SLOT(updateCursor()));
-    connect(verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(adjust()));
+    connect(verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(verticalScrolled(int)));
+    connect(verticalScrollBar(), SIGNAL(actionTriggered(int)), this, SLOT(verticalAction(int)));
     connect(horizontalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(adjust()));
     connect(_undoStack, SIGNAL(indexChanged(int)), this, SLOT(dataChangedPrivate(int)));
+    connect(_chunks, SIGNAL(rangeChanged(qint64,qint64)), this, SLOT(rangeChangedPrivate(qint64,qint64)));
+    connect(&_searchWatcher, SIGNAL(finished()), this, SLOT(searchFinishedPrivate()));
+    connect(&_searchWatcher, SIGNAL(progressValueChanged(int)), this, SIGNAL(searchProgress(int)));
+    connect(&_prefetchWatcher, SIGNAL(finished()), this, SLOT(prefetchFinished()));
+    connect(&_rowsTimer, SIGNAL(timeout()), this, SLOT(readBuffersPrivate()));
 
     _cursorTimer.setInterval(500);
     _cursorTimer.start();
+    _rowsTimer.setSingleShot(true);
+    _rowsTimer.setInterval(0);
 
     setAddressWidth(4);
     setAddressArea(true);
@@ -60,6 +94,9 @@ QHexEdit::QHexEdit(QWidget *parent) : QAbstractScrollArea(parent)
 
 QHexEdit::~QHexEdit()
 {
+    // Workers of panels read _chunks too, they stop before it is destroyed
+    stopWorkers();
+    delete _minimap;
 }
 
 // ********************************************************************** Properties
@@ -211,9 +248,10 @@ void QHexEdit::setCursorPosition(qint64 position)
     if (position < 0)
         position = 0;
 
-    // 3. Calc new position of cursor
+    // 3. Calc new position of cursor, rows far out of view are clamped to keep the maths in int
     _bPosCurrent = position / 2;
-    _pxCursorY = ((position / 2 - _bPosFirst) / _bytesPerLine + 1) * _pxCharHeight;
+    qint64 cursorRow = qBound<qint64>(-1, (position / 2 - _bPosFirst) / _bytesPerLine, _rowsShown + 1);
+    _pxCursorY = (int)(cursorRow + 1) * _pxCharHeight;
     int x = (position % (2 * _bytesPerLine));
     if (_editAreaIsAscii)
     {
@@ -267,9 +305,11 @@ qint64 QHexEdit::cursorPosition()
 
 void QHexEdit::setData(const QByteArray &ba)
 {
+    stopWorkers();
     _data = ba;
-    _bData.setData(_data);
-    setData(_bData);
+    _chunks->setBuffer(_bData, _data);
+    init();
+    dataChangedPrivate();
 }
 
 QByteArray QHexEdit::data()
@@ -300,6 +340,42 @@ QColor QHexEdit::highlightingColor()
     return _brushHighlighted.color();
 }
 
+void QHexEdit::setMarkColor(const QColor &color)
+{
+    _brushMarked = QBrush(color);
+    viewport()->update();
+}
+
+QColor QHexEdit::markColor()
+{
+    return _brushMarked.color();
+}
+
+void QHexEdit::setMinimap(bool minimap)
+{
+    if (minimap == (_minimap != NULL))
+        return;
+    if (minimap)
+    {
+        _minimap = new Minimap(_chunks, this);
+        connect(_minimap, SIGNAL(positionClicked(qint64)), this, SLOT(minimapClicked(qint64)));
+        setViewportMargins(0, 0, MINIMAP_WIDTH, 0);
+        _minimap->show();
+    }
+    else
+    {
+        delete _minimap;
+        _minimap = NULL;
+        setViewportMargins(0, 0, 0, 0);
+    }
+    resizeEvent(NULL);
+}
+
+bool QHexEdit::minimap()
+{
+    return _minimap != NULL;
+}
+
 void QHexEdit::setOverwriteMode(bool overwriteMode)
 {
     _overwriteMode = overwriteMode;
@@ -361,6 +437,7 @@ bool QHexEdit::dynamicBytesPerLine()
 // ********************************************************************** Access to data of qhexedit
 bool QHexEdit::setData(QIODevice &iODevice)
 {
+    stopWorkers();
     bool ok = _chunks->setIODevice(iODevice);
     init();
     dataChangedPrivate();
@@ -377,6 +454,18 @@ bool QHexEdit::write(QIODevice &iODevice, qint64 pos, qint64 count)
     return _chunks->write(iODevice, pos, count);
 }
 
+Chunks *QHexEdit::chunks()
+{
+    return _chunks;
+}
+
+void QHexEdit::reload(qint64 pos, qint64 length)
+{
+    // rangeChangedPrivate() drops the rows, the visible ones are read right away
+    _chunks->reload(pos, length);
+    readBuffers();
+}
+
 // ********************************************************************** Char handling
 void QHexEdit::insert(qint64 index, char ch)
 {
@@ -409,13 +498,71 @@ void QHexEdit::replace(qint64 pos, qint64 len, const QByteArray &ba)
     refresh();
 }
 
+bool QHexEdit::transformSelection(const Transform &transform)
+{
+    qint64 pos = getSelectionBegin();
+    qint64 len = getSelectionEnd() - pos;
+    if (_readOnly || (len <= 0))
+        return false;
+
+    if (len <= TRANSFORM_ASYNC)
+    {
+        _undoStack->transform(pos, len, transform);
+        refresh();
+        return true;
+    }
+
+    // Large selections are read, transformed and written block by block by a
+    // worker, the command is pushed when it is done. Chunks serializes the
+    // worker's accesses with the views. A cancel restores the blocks done.
+    // Until then the editor is read only and the dialog is shown at once, so
+    // no edit or undo gets between the transform and its command.
+    QProgressDialog progress(tr("Transforming..."), tr("Cancel"), 0, 1000, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(0);
+    QFutureWatcher<QUndoCommand *> watcher;
+    QEventLoop loop;
+    auto canceled = QSharedPointer<QAtomicInt>::create(0);
+    connect(&watcher, SIGNAL(progressValueChanged(int)), &progress, SLOT(setValue(int)));
+    connect(&watcher, SIGNAL(finished()), &loop, SLOT(quit()));
+    connect(&progress, &QProgressDialog::canceled, &progress, [canceled]() { canceled->storeRelaxed(1); });
+    UndoStack *undoStack = _undoStack;
+    bool readOnly = _readOnly;
+    _readOnly = true;
+    _transformWatcher = &watcher;
+    _transformCanceled = canceled;
+    _transformStopped = false;
+    watcher.setFuture(QtConcurrent::run([undoStack, pos, len, transform, canceled](QPromise<QUndoCommand *> &promise) {
+        promise.setProgressRange(0, 1000);
+        promise.addResult(undoStack->applyTransform(pos, len, transform, [&promise, len, canceled](qint64 done) {
+            promise.setProgressValue((int)(done * 1000 / len));
+            return canceled->loadRelaxed() == 0;
+        }));
+    }));
+    loop.exec();
+    _transformWatcher = NULL;
+    _transformCanceled.reset();
+    _readOnly = readOnly;
+
+    // Data replaced meanwhile has an undo stack of its own
+    QUndoCommand *command = watcher.result();
+    if (_transformStopped)
+        delete command;
+    if (!command || _transformStopped)
+        return false;
+    _undoStack->push(command);
+    refresh();
+    return true;
+}
+
 // ********************************************************************** Utility functions
 void QHexEdit::ensureVisible()
 {
-    if (_cursorPosition < (_bPosFirst * 2))
-        verticalScrollBar()->setValue((int)(_cursorPosition / 2 / _bytesPerLine));
-    if (_cursorPosition > ((_bPosFirst + (_rowsShown - 1)*_bytesPerLine) * 2))
-        verticalScrollBar()->setValue((int)(_cursorPosition / 2 / _bytesPerLine) - _rowsShown + 1);
+    qint64 cursorLine = _cursorPosition / 2 / _bytesPerLine;
+    if (cursorLine < _topLine)
+        setTopLine(cursorLine);
+    if (cursorLine > (_topLine + _rowsShown - 1))
+        setTopLine(cursorLine - _rowsShown + 1);
     if (_pxCursorX < horizontalScrollBar()->value())
         horizontalScrollBar()->setValue(_pxCursorX);
     if ((_pxCursorX + _pxCharWidth) > (horizontalScrollBar()->value() + viewport()->width()))
@@ -427,14 +574,65 @@ qint64 QHexEdit::indexOf(const QByteArray &ba, qint64 from)
 {
     qint64 pos = _chunks->indexOf(ba, from);
     if (pos > -1)
+        selectRange(pos, ba.length());
+    return pos;
+}
+
+qint64 QHexEdit::indexOf(const BytePattern &pattern, qint64 from)
+{
+    qint64 length = 0;
+    qint64 pos = _chunks->indexOf(pattern, from, &length);
+    if (pos > -1)
+        selectRange(pos, length);
+    return pos;
+}
+
+void QHexEdit::startSearch(const QByteArray &ba, qint64 from)
+{
+    Chunks *chunks = _chunks;
+    runSearch([chunks, ba, from](qint64 *length, const Chunks::ProgressFunction &progress) {
+        *length = ba.size();
+        return chunks->indexOf(ba, from, progress);
+    });
+}
+
+void QHexEdit::startSearch(const BytePattern &pattern, qint64 from)
+{
+    Chunks *chunks = _chunks;
+    runSearch([chunks, pattern, from](qint64 *length, const Chunks::ProgressFunction &progress) {
+        return chunks->indexOf(pattern, from, length, progress);
+    });
+}
+
+void QHexEdit::cancelSearch()
+{
+    if (_searchWatcher.isRunning())
     {
-        qint64 curPos = pos*2;
-        setCursorPosition(curPos + ba.length()*2);
-        resetSelection(curPos);
-        setSelection(curPos + ba.length()*2);
-        ensureVisible();
+        _searchWatcher.cancel();
+        _searchWatcher.waitForFinished();
     }
-    return pos;
+}
+
+void QHexEdit::stopWorkers()
+{
+    // Workers of panels are told first, the read ahead cannot be cancelled
+    // and is waited for
+    emit dataAboutToBeReplaced();
+    if (_transformWatcher)
+    {
+        _transformCanceled->storeRelaxed(1);
+        _transformStopped = true;
+        _transformWatcher->waitForFinished();
+    }
+    cancelSearch();
+    _prefetchWatcher.waitForFinished();
+    if (_minimap)
+        _minimap->cancel();
+}
+
+bool QHexEdit::isSearching()
+{
+    return _searchWatcher.isRunning();
 }
 
 bool QHexEdit::isModified()
@@ -458,6 +656,8 @@ qint64 QHexEdit::lastIndexOf(const QByteArray &ba, qint64 from)
 
 void QHexEdit::redo()
 {
+    if (_transformWatcher)              // the transform's command is not pushed yet
+        return;
     _undoStack->redo();
     setCursorPosition(_chunks->pos()*(_editAreaIsAscii ? 1 : 2));
     refresh();
@@ -466,13 +666,51 @@ void QHexEdit::redo()
 QString QHexEdit::selectionToReadableString()
 {
     QByteArray ba = _chunks->data(getSelectionBegin(), getSelectionEnd() - getSelectionBegin());
-    return toReadable(ba);
+    return QString::fromLatin1(HexFormat::toReadable(ba, _addressOffset + getSelectionBegin(), addressWidth()));
 }
 
 QString QHexEdit::selectedData()
 {
-    QByteArray ba = _chunks->data(getSelectionBegin(), getSelectionEnd() - getSelectionBegin()).toHex();
-    return ba;
+    QByteArray ba = _chunks->data(getSelectionBegin(), getSelectionEnd() - getSelectionBegin());
+    return QString::fromLatin1(HexFormat::toHex(ba));
+}
+
+bool QHexEdit::writeSelection(QIODevice &device, HexFormat::Format format, const Chunks::ProgressFunction &progress)
+{
+    return HexFormat::write(device, *_chunks, getSelectionBegin(), getSelectionEnd() - getSelectionBegin(), format,
+                            _addressOffset + getSelectionBegin(), addressWidth(), false, progress);
+}
+
+void QHexEdit::selectRange(qint64 pos, qint64 len)
+{
+    qint64 curPos = pos*2;
+    setCursorPosition(curPos + len*2);
+    resetSelection(curPos);
+    setSelection(curPos + len*2);
+    ensureVisible();
+}
+
+void QHexEdit::setMarkedRanges(const QVector<QPair<qint64, qint64>> &ranges)
+{
+    // marks are painted into the tiles
+    _markedRanges = ranges;
+    _tiles.clear();
+    viewport()->update();
+}
+
+QVector<QPair<qint64, qint64>> QHexEdit::markedRanges()
+{
+    return _markedRanges;
+}
+
+qint64 QHexEdit::topLine()
+{
+    return _topLine;
+}
+
+void QHexEdit::scrollToLine(qint64 line)
+{
+    setTopLine(line);
 }
 
 void QHexEdit::setFont(const QFont &font)
@@ -498,11 +736,13 @@ void QHexEdit::setFont(const QFont &font)
 QString QHexEdit::toReadableString()
 {
     QByteArray ba = _chunks->data();
-    return toReadable(ba);
+    return QString::fromLatin1(HexFormat::toReadable(ba, _addressOffset, addressWidth()));
 }
 
 void QHexEdit::undo()
 {
+    if (_transformWatcher)              // the transform's command is not pushed yet
+        return;
     _undoStack->undo();
     setCursorPosition(_chunks->pos()*(_editAreaIsAscii ? 1 : 2));
     refresh();
@@ -648,11 +888,9 @@ void QHexEdit::keyPressEvent(QKeyEvent *event)
         /* Cut */
         if (event->matches(QKeySequence::Cut))
         {
-            QByteArray ba = _chunks->data(getSelectionBegin(), getSelectionEnd() - getSelectionBegin()).toHex();
-            for (qint64 idx = 32; idx < ba.size(); idx +=33)
-                ba.insert(idx, "\n");
+            QByteArray ba = _chunks->data(getSelectionBegin(), getSelectionEnd() - getSelectionBegin());
             QClipboard *clipboard = QApplication::clipboard();
-            clipboard->setText(ba);
+            clipboard->setText(QString::fromLatin1(HexFormat::toWrappedHex(ba)));
             if (_overwriteMode)
             {
                 qint64 len = getSelectionEnd() - getSelectionBegin();
@@ -669,8 +907,9 @@ void QHexEdit::keyPressEvent(QKeyEvent *event)
         /* Paste */
         if (event->matches(QKeySequence::Paste))
         {
-            QClipboard *clipboard = QApplication::clipboard();
-            QByteArray ba = QByteArray().fromHex(clipboard->text().toLatin1());
+            QByteArray ba;
+            if (!pasteFromClipboard(ba))
+                return;
             if (_overwriteMode)
             {
                 ba = ba.left(std::min<qint64>(ba.size(), (_chunks->size() - _bPosCurrent)));
@@ -827,11 +1066,9 @@ void QHexEdit::keyPressEvent(QKeyEvent *event)
     /* Copy */
     if (event->matches(QKeySequence::Copy))
     {
-        QByteArray ba = _chunks->data(getSelectionBegin(), getSelectionEnd() - getSelectionBegin()).toHex();
-        for (qint64 idx = 32; idx < ba.size(); idx +=33)
-            ba.insert(idx, "\n");
+        QByteArray ba = _chunks->data(getSelectionBegin(), getSelectionEnd() - getSelectionBegin());
         QClipboard *clipboard = QApplication::clipboard();
-        clipboard->setText(ba);
+        clipboard->setText(QString::fromLatin1(HexFormat::toWrappedHex(ba)));
     }
 
     // Switch between insert/overwrite mode
@@ -889,8 +1126,6 @@ void QHexEdit::paintEvent(QPaintEvent *event)
 
     if (event->rect() != _cursorRect)
     {
-        int pxPosStartY = _pxCharHeight;
-
         // draw some patterns if needed
         painter.fillRect(event->rect(), viewport()->palette().color(QPalette::Base));
         if (_addressArea)
@@ -902,89 +1137,29 @@ void QHexEdit::paintEvent(QPaintEvent *event)
             painter.drawLine(linePos - pxOfsX, event->rect().top(), linePos - pxOfsX, height());
         }
 
-        painter.setPen(viewport()->palette().color(QPalette::WindowText));
-
-        // paint address area
-        if (_addressArea)
-        {
-            QString address;
-            for (int row=0, pxPosY = _pxCharHeight; row <= (_dataShown.size()/_bytesPerLine); row++, pxPosY +=_pxCharHeight)
-            {
-                address = QString("%1").arg(_bPosFirst + row*_bytesPerLine + _addressOffset, _addrDigits, 16, QChar('0'));
-                painter.setPen(QPen(_addressFontColor));
-                painter.drawText(_pxPosAdrX - pxOfsX, pxPosY, hexCaps() ? address.toUpper() : address);
-            }
-        }
-
-        // paint hex and ascii area
-        QPen colStandard = QPen(viewport()->palette().color(QPalette::WindowText));
-
-        painter.setBackgroundMode(Qt::TransparentMode);
-
-        for (int row = 0, pxPosY = pxPosStartY; row <= _rowsShown; row++, pxPosY +=_pxCharHeight)
-        {
-            QByteArray hex;
-            int pxPosX = _pxPosHexX  - pxOfsX;
-            int pxPosAsciiX2 = _pxPosAsciiX  - pxOfsX;
-            qint64 bPosLine = row * _bytesPerLine;
-            for (int colIdx = 0; ((bPosLine + colIdx) < _dataShown.size() && (colIdx < _bytesPerLine)); colIdx++)
-            {
-                QColor c = viewport()->palette().color(QPalette::Base);
-                painter.setPen(QPen(_hexFontColor));
-
-                qint64 posBa = _bPosFirst + bPosLine + colIdx;
-                if ((getSelectionBegin() <= posBa) && (getSelectionEnd() > posBa))
-                {
-                    c = _brushSelection.color();
-                    painter.setPen(_penSelection);
-                }
-                else
-                {
-                    if (_highlighting)
-                        if (_markedShown.at((int)(posBa - _bPosFirst)))
-                        {
-                            c = _brushHighlighted.color();
-                            painter.setPen(_penHighlighted);
-                        }
-                }
-
-                // render hex value
-                QRect r;
-                if (colIdx == 0)
-                    r.setRect(pxPosX, pxPosY - _pxCharHeight + _pxSelectionSub, 2*_pxCharWidth, _pxCharHeight);
-                else
-                    r.setRect(pxPosX - _pxCharWidth, pxPosY - _pxCharHeight + _pxSelectionSub, 3*_pxCharWidth, _pxCharHeight);
-                painter.fillRect(r, c);
-                hex = _hexDataShown.mid((bPosLine + colIdx) * 2, 2);
-                painter.drawText(pxPosX, pxPosY, hexCaps()?hex.toUpper():hex);
-                pxPosX += 3*_pxCharWidth;
-
-                // render ascii value
-                if (_asciiArea)
-                {
-                    if (c == viewport()->palette().color(QPalette::Base))
-                        c = _asciiAreaColor;
-                    int ch = (uchar)_dataShown.at(bPosLine + colIdx);
-                    if ( ch < ' ' || ch > '~' )
-                        ch = '.';
-                    r.setRect(pxPosAsciiX2, pxPosY - _pxCharHeight + _pxSelectionSub, _pxCharWidth, _pxCharHeight);
-                    painter.fillRect(r, c);
-                    painter.setPen(QPen(_asciiFontColor));
-                    painter.drawText(pxPosAsciiX2, pxPosY, QChar(ch));
-                    pxPosAsciiX2 += _pxCharWidth;
-                }
-            }
-        }
-        painter.setBackgroundMode(Qt::TransparentMode);
+        // Rows are blitted from their tiles, which are rendered once and kept
+        // until data, selection or style of the row change
+        updateTileStyle();
+
+        // only rows intersecting the exposed rect are painted, after scrolling
+        // that is the strip which scrollContentsBy() did not blit
+        int rowFirst = std::max(0, (event->rect().top() - _pxSelectionSub) / _pxCharHeight);
+        int rowLast = std::min(_rowsShown, (event->rect().bottom() - _pxSelectionSub) / _pxCharHeight);
+        rowLast = std::min(rowLast, (int)_rows.size() - 1);
+        for (int row = rowFirst; row <= rowLast; row++)
+            painter.drawPixmap(-pxOfsX, row * _pxCharHeight + _pxSelectionSub, rowTile(_rowsFirstLine + row, _rows.at(row))->pixmap);
         painter.setPen(viewport()->palette().color(QPalette::WindowText));
     }
 
     // _cursorPosition counts in 2, _bPosFirst counts in 1
-    int hexPositionInShowData = _cursorPosition - 2 * _bPosFirst;
+    qint64 hexPositionInShowData = _cursorPosition - 2 * _bPosFirst;
+    qint64 cursorRow = hexPositionInShowData / (2 * _bytesPerLine);
+    int hexPositionInRow = (int)(hexPositionInShowData % (2 * _bytesPerLine));
 
     // due to scrolling the cursor can go out of the currently displayed data
-    if ((hexPositionInShowData >= 0) && (hexPositionInShowData < _hexDataShown.size()))
+    if ((hexPositionInShowData >= 0) && (cursorRow < _rows.size()) && (hexPositionInRow < _rows.at(cursorRow).hex.size()))
     {
+        const ShownRow &shown = _rows.at(cursorRow);
         // paint cursor
         if (_readOnly)
         {
@@ -999,8 +1174,7 @@ void QHexEdit::paintEvent(QPaintEvent *event)
             if (_editAreaIsAscii)
             {
                 // every 2 hex there is 1 ascii
-                int asciiPositionInShowData = hexPositionInShowData / 2;
-                int ch = (uchar)_dataShown.at(asciiPositionInShowData);
+                int ch = (uchar)shown.data.at(hexPositionInRow / 2);
                 if (ch < ' ' || ch > '~')
                     ch = '.';
 
@@ -1008,7 +1182,7 @@ void QHexEdit::paintEvent(QPaintEvent *event)
             }
             else
             {
-                painter.drawText(_pxCursorX - pxOfsX, _pxCursorY, hexCaps() ? _hexDataShown.mid(hexPositionInShowData, 1).toUpper() : _hexDataShown.mid(hexPositionInShowData, 1));
+                painter.drawText(_pxCursorX - pxOfsX, _pxCursorY, hexCaps() ? shown.hex.mid(hexPositionInRow, 1).toUpper() : shown.hex.mid(hexPositionInRow, 1));
             }
     }
 
@@ -1038,9 +1212,44 @@ void QHexEdit::resizeEvent(QResizeEvent *)
         // to prevent devision by zero use the min value 1
         setBytesPerLine(std::max(charWidth / (_asciiArea ? 4 : 3),1));
     }
+    if (_minimap)
+    {
+        QRect view = viewport()->geometry();
+        _minimap->setGeometry(view.right() + 1, view.top(), MINIMAP_WIDTH, view.height());
+    }
     adjust();
 }
 
+void QHexEdit::scrollContentsBy(int dx, int)
+{
+    // Move the pixels still valid and only repaint the strip scrolled into
+    // view. Vertical scrolling is done by setTopLine(), as scrollbar values
+    // are no lines when the image has more lines than an int holds.
+    if (qAbs(dx) < viewport()->width())
+        viewport()->scroll(dx, 0);
+    else
+        viewport()->update();
+}
+
+void QHexEdit::wheelEvent(QWheelEvent *event)
+{
+    // Scroll by lines, the scrollbar steps may be much coarser
+    if (event->angleDelta().y() == 0)
+    {
+        QAbstractScrollArea::wheelEvent(event);
+        return;
+    }
+    _wheelDelta += event->angleDelta().y();
+    int steps = _wheelDelta / 120;
+    _wheelDelta -= steps * 120;
+    int lines = steps * QApplication::wheelScrollLines();
+    if (event->modifiers() & (Qt::ControlModifier | Qt::ShiftModifier))
+        lines = steps * std::max(_rowsShown, 1);
+    if (lines != 0)
+        setTopLine(_topLine - lines);
+    event->accept();
+}
+
 bool QHexEdit::focusNextPrevChild(bool next)
 {
     if (_addressArea)
@@ -1059,8 +1268,7 @@ bool QHexEdit::focusNextPrevChild(bool next)
 // ********************************************************************** Handle selections
 void QHexEdit::resetSelection()
 {
-    _bSelectionBegin = _bSelectionInit;
-    _bSelectionEnd = _bSelectionInit;
+    setSelectionRange(_bSelectionInit, _bSelectionInit);
 }
 
 void QHexEdit::resetSelection(qint64 pos)
@@ -1072,8 +1280,7 @@ void QHexEdit::resetSelection(qint64 pos)
         pos = _chunks->size();
 
     _bSelectionInit = pos;
-    _bSelectionBegin = pos;
-    _bSelectionEnd = pos;
+    setSelectionRange(pos, pos);
 }
 
 void QHexEdit::setSelection(qint64 pos)
@@ -1085,15 +1292,18 @@ void QHexEdit::setSelection(qint64 pos)
         pos = _chunks->size();
 
     if (pos >= _bSelectionInit)
-    {
-        _bSelectionEnd = pos;
-        _bSelectionBegin = _bSelectionInit;
-    }
+        setSelectionRange(_bSelectionInit, pos);
     else
-    {
-        _bSelectionBegin = pos;
-        _bSelectionEnd = _bSelectionInit;
-    }
+        setSelectionRange(pos, _bSelectionInit);
+}
+
+void QHexEdit::setSelectionRange(qint64 begin, qint64 end)
+{
+    if ((begin == _bSelectionBegin) && (end == _bSelectionEnd))
+        return;
+    _bSelectionBegin = begin;
+    _bSelectionEnd = end;
+    emit selectionChanged(begin, end);
 }
 
 qint64 QHexEdit::getSelectionBegin()
@@ -1113,7 +1323,7 @@ void QHexEdit::init()
     setAddressOffset(0);
     resetSelection(0);
     setCursorPosition(0);
-    verticalScrollBar()->setValue(0);
+    setTopLine(0);
     _modified = false;
 }
 
@@ -1139,19 +1349,103 @@ void QHexEdit::adjust()
 
     // set verticalScrollbar()
     _rowsShown = ((viewport()->height()-4)/_pxCharHeight);
-    int lineCount = (int)(_chunks->size() / (qint64)_bytesPerLine) + 1;
-    verticalScrollBar()->setRange(0, lineCount - _rowsShown);
-    verticalScrollBar()->setPageStep(_rowsShown);
+    _rowCache.setMaxCost(8 * (_rowsShown + 1));   // view, 3 prefetched pages and some history
+    _tiles.setMaxCost(5 * (_rowsShown + 1));
+    // Lines map 1:1 onto the scrollbar as long as they fit, beyond that the
+    // scrollbar positions proportionally. Signals are blocked, as _topLine
+    // and not the scrollbar is the position of the view.
+    qint64 lineCount = _chunks->size() / _bytesPerLine + 1;
+    _maxTopLine = std::max<qint64>(lineCount - _rowsShown, 0);
+    int range = (int)std::min<qint64>(_maxTopLine, MAX_SCROLL_RANGE);
+    int pageStep = (range == _maxTopLine) ? _rowsShown : std::max(1, (int)((qint64)_rowsShown * range / _maxTopLine));
+    if (_topLine > _maxTopLine)
+    {
+        _topLine = _maxTopLine;
+        viewport()->update();
+    }
+    {
+        QSignalBlocker blocker(verticalScrollBar());
+        verticalScrollBar()->setRange(0, range);
+        verticalScrollBar()->setPageStep(pageStep);
+        verticalScrollBar()->setValue(scrollValueForLine(_topLine));
+    }
 
-    int value = verticalScrollBar()->value();
-    _bPosFirst = (qint64)value * _bytesPerLine;
-    _bPosLast = _bPosFirst + (qint64)(_rowsShown * _bytesPerLine) - 1;
+    _bPosFirst = _topLine * _bytesPerLine;
+    _bPosLast = _bPosFirst + (qint64)_rowsShown * _bytesPerLine - 1;
     if (_bPosLast >= _chunks->size())
         _bPosLast = _chunks->size() - 1;
+    if (_minimap)
+        _minimap->setVisibleRange(_bPosFirst, _bPosLast);
     readBuffers();
     setCursorPosition(_cursorPosition);
 }
 
+void QHexEdit::setTopLine(qint64 line, bool syncScrollBar)
+{
+    line = qBound<qint64>(0, line, _maxTopLine);
+    qint64 delta = line - _topLine;
+    _topLine = line;
+    if (syncScrollBar)
+    {
+        QSignalBlocker blocker(verticalScrollBar());
+        verticalScrollBar()->setValue(scrollValueForLine(line));
+    }
+    if (delta == 0)
+        return;
+    emit topLineChanged(line);
+
+    // blit the rows still in view, only the exposed strip is painted
+    if (qAbs(delta) < _rowsShown)
+        viewport()->scroll(0, (int)-delta * _pxCharHeight);
+    else
+        viewport()->update();
+    adjust();
+}
+
+qint64 QHexEdit::lineForScrollValue(int value)
+{
+    qint64 range = verticalScrollBar()->maximum();
+    if ((range <= 0) || (_maxTopLine <= range))
+        return value;
+    // split, so value * _maxTopLine cannot overflow
+    return value * (_maxTopLine / range) + value * (_maxTopLine % range) / range;
+}
+
+int QHexEdit::scrollValueForLine(qint64 line)
+{
+    qint64 range = verticalScrollBar()->maximum();
+    if ((range <= 0) || (_maxTopLine <= range))
+        return (int)line;
+    return (int)((double)line * range / _maxTopLine);
+}
+
+void QHexEdit::verticalScrolled(int value)
+{
+    setTopLine(lineForScrollValue(value), false);
+}
+
+void QHexEdit::verticalAction(int action)
+{
+    // Steps move by lines and pages, even when the scrollbar is proportional.
+    // The slider is set here already, so the value the action would set
+    // afterwards causes no further change.
+    qint64 line = _topLine;
+    switch (action)
+    {
+    case QAbstractSlider::SliderSingleStepAdd: line += 1; break;
+    case QAbstractSlider::SliderSingleStepSub: line -= 1; break;
+    case QAbstractSlider::SliderPageStepAdd: line += _rowsShown; break;
+    case QAbstractSlider::SliderPageStepSub: line -= _rowsShown; break;
+    default: return;
+    }
+    setTopLine(line);
+}
+
+void QHexEdit::minimapClicked(qint64 pos)
+{
+    setTopLine(pos / _bytesPerLine - _rowsShown / 2);
+}
+
 void QHexEdit::dataChangedPrivate(int)
 {
     _modified = _undoStack->index() != 0;
@@ -1165,35 +1459,351 @@ void QHexEdit::refresh()
     readBuffers();
 }
 
-void QHexEdit::readBuffers()
+void QHexEdit::updateTileStyle()
 {
-    _dataShown = _chunks->data(_bPosFirst, _bPosLast - _bPosFirst + _bytesPerLine + 1, &_markedShown);
-    _hexDataShown = QByteArray(_dataShown.toHex());
+    // tiles depend on everything hashed here, besides the data and selection
+    _glyphs.setFont(font(), _pxCharWidth, _pxCharHeight, fontMetrics().ascent(), viewport()->devicePixelRatioF());
+    size_t tileStyle = qHashMulti(0, font().key(), _pxCharWidth, _pxCharHeight, viewport()->devicePixelRatioF(),
+                                  _addressArea, _asciiArea, _hexCaps, _highlighting, _addressOffset, _addrDigits,
+                                  _bytesPerLine, _pxPosHexX, _pxPosAsciiX,
+                                  _addressFontColor.rgba(), _hexFontColor.rgba(), _asciiFontColor.rgba(), _asciiAreaColor.rgba(),
+                                  _brushSelection.color().rgba(), _penSelection.color().rgba(),
+                                  _brushHighlighted.color().rgba(), _penHighlighted.color().rgba(),
+                                  _brushMarked.color().rgba());
+    if (tileStyle != _tileStyle)
+    {
+        _tiles.clear();
+        _tileStyle = tileStyle;
+    }
+}
+
+QHexEdit::RowTile *QHexEdit::rowTile(qint64 line, const ShownRow &row)
+{
+    // a tile stays valid as long as the part of the selection in its row is the same
+    qint64 bPosLine = line * _bytesPerLine;
+    qint64 selectionBegin = qBound(bPosLine, getSelectionBegin(), bPosLine + row.data.size());
+    qint64 selectionEnd = qBound(bPosLine, getSelectionEnd(), bPosLine + row.data.size());
+    if (selectionBegin >= selectionEnd)
+        selectionBegin = selectionEnd = 0;
+    RowTile *tile = _tiles.object(line);
+    if (tile && (tile->selectionBegin == selectionBegin) && (tile->selectionEnd == selectionEnd))
+        return tile;
+
+    qreal dpr = viewport()->devicePixelRatioF();
+    int pxWidth = _pxPosAsciiX + (_asciiArea ? _bytesPerLine * _pxCharWidth : 0);
+    tile = new RowTile{QPixmap(qCeil(pxWidth * dpr), qCeil(_pxCharHeight * dpr)), selectionBegin, selectionEnd};
+    tile->pixmap.setDevicePixelRatio(dpr);
+    tile->pixmap.fill(Qt::transparent);
+    QPainter painter(&tile->pixmap);
+
+    // Characters are drawn from the glyph atlases, collected per color.
+    // Backgrounds are merged into runs of equal style.
+    const char *hexDigits = _hexCaps ? "0123456789ABCDEF" : "0123456789abcdef";
+    QVector<QPainter::PixmapFragment> glyphs[5];   // hex normal, selected, highlighted, marked; ascii
+    enum { Normal, Selected, Highlighted, Marked, Ascii };
+    int pxPosY = _pxCharHeight - _pxSelectionSub;
+
+    // paint address
+    if (_addressArea && (bPosLine <= _chunks->size()))
+    {
+        qint64 address = bPosLine + _addressOffset;
+        int pxPosX = _pxPosAdrX + (_addrDigits - 1) * _pxCharWidth;
+        for (int digit=0; digit < _addrDigits; digit++, pxPosX -= _pxCharWidth)
+            _glyphs.append(glyphs[Normal], digit < 16 ? hexDigits[(address >> (4 * digit)) & 0xf] : '0', pxPosX, pxPosY);
+        _glyphs.draw(painter, glyphs[Normal], _addressFontColor);
+    }
+
+    // paint hex and ascii area
+    QColor background[4] = { viewport()->palette().color(QPalette::Base), _brushSelection.color(),
+                             _brushHighlighted.color(), _brushMarked.color() };
+    int count = row.data.size();
+    auto mark = std::upper_bound(_markedRanges.cbegin(), _markedRanges.cend(), bPosLine,
+                                 [](qint64 pos, const QPair<qint64, qint64> &range) { return pos < range.first + range.second; });
+    int runStart = 0;
+    int runStyle = Normal;
+    for (int colIdx = 0; colIdx <= count; colIdx++)
+    {
+        int style = Normal;
+        if (colIdx < count)
+        {
+            qint64 posBa = bPosLine + colIdx;
+            while ((mark != _markedRanges.cend()) && (mark->first + mark->second <= posBa))
+                ++mark;
+            if ((getSelectionBegin() <= posBa) && (getSelectionEnd() > posBa))
+                style = Selected;
+            else if ((mark != _markedRanges.cend()) && (mark->first <= posBa))
+                style = Marked;
+            else if (_highlighting && row.marked.at(colIdx))
+                style = Highlighted;
+        }
+
+        // flush the background run, hex cells include the gap to their left
+        if ((colIdx == count) || (style != runStyle))
+        {
+            if ((runStyle != Normal) && (colIdx > runStart))
+            {
+                int left = _pxPosHexX + runStart * 3 * _pxCharWidth - (runStart ? _pxCharWidth : 0);
+                int right = _pxPosHexX + (colIdx - 1) * 3 * _pxCharWidth + 2 * _pxCharWidth;
+                painter.fillRect(QRect(left, 0, right - left, _pxCharHeight), background[runStyle]);
+            }
+            if (_asciiArea && (colIdx > runStart))
+                painter.fillRect(QRect(_pxPosAsciiX + runStart * _pxCharWidth, 0, (colIdx - runStart) * _pxCharWidth, _pxCharHeight),
+                                 runStyle == Normal ? _asciiAreaColor : background[runStyle]);
+            runStart = colIdx;
+            runStyle = style;
+        }
+        if (colIdx == count)
+            break;
+
+        // render hex and ascii value
+        uchar ch = (uchar)row.data.at(colIdx);
+        int pxHex = _pxPosHexX + colIdx * 3 * _pxCharWidth;
+        _glyphs.append(glyphs[style], hexDigits[ch >> 4], pxHex, pxPosY);
+        _glyphs.append(glyphs[style], hexDigits[ch & 0xf], pxHex + _pxCharWidth, pxPosY);
+        if (_asciiArea)
+            _glyphs.append(glyphs[Ascii], (ch < ' ' || ch > '~') ? '.' : (char)ch, _pxPosAsciiX + colIdx * _pxCharWidth, pxPosY);
+    }
+    _glyphs.draw(painter, glyphs[Normal], _hexFontColor);
+    _glyphs.draw(painter, glyphs[Selected], _penSelection.color());
+    _glyphs.draw(painter, glyphs[Highlighted], _penHighlighted.color());
+    _glyphs.draw(painter, glyphs[Marked], _penHighlighted.color());
+    _glyphs.draw(painter, glyphs[Ascii], _asciiFontColor);
+    painter.end();
+
+    _tiles.insert(line, tile);
+    return tile;
 }
 
-QString QHexEdit::toReadable(const QByteArray &ba)
+void QHexEdit::readBuffers()
 {
-    QString result;
+    // Rows, which are still in view, are moved to their new place, the others
+    // go to the row cache. Rows scrolled into view are taken from the cache
+    // or read, when the prefetcher did not get them yet.
+    qint64 firstLine = _bPosFirst / _bytesPerLine;
+    int count = _rowsShown + 1;
+    QVector<ShownRow> rows(count);
+    if (_rowsBytesPerLine != _bytesPerLine)
+    {
+        _rowCache.clear();
+        _tiles.clear();
+        _rowsGeneration += 1;
+        _rowsBytesPerLine = _bytesPerLine;
+    }
+    else
+    {
+        for (int idx = 0; idx < _rows.size(); idx++)
+        {
+            if (!_rows.at(idx).valid)
+                continue;
+            qint64 line = _rowsFirstLine + idx;
+            qint64 row = line - firstLine;
+            if ((row >= 0) && (row < count))
+                rows[row] = std::move(_rows[idx]);
+            else
+                _rowCache.insert(line, new ShownRow(std::move(_rows[idx])));
+        }
+    }
+    if (firstLine != _rowsFirstLine)
+        _scrollDirection = (firstLine > _rowsFirstLine) ? 1 : -1;
+    _rows = std::move(rows);
+    _rowsFirstLine = firstLine;
 
-    for (int i=0; i < ba.size(); i += 16)
+    // consecutive missing rows are read with one call
+    for (int row = 0; row < count; )
     {
-        QString addrStr = QString("%1").arg(_addressOffset + i, addressWidth(), 16, QChar('0'));
-        QString hexStr;
-        QString ascStr;
-        for (int j=0; j<16; j++)
+        if (!_rows.at(row).valid)
         {
-            if ((i + j) < ba.size())
+            if (ShownRow *cached = _rowCache.take(firstLine + row))
             {
-                hexStr.append(" ").append(ba.mid(i+j, 1).toHex());
-                char ch = ba[i + j];
-                if ((ch < 0x20) || (ch > 0x7e))
-                        ch = '.';
-                ascStr.append(QChar(ch));
+                _rows[row] = std::move(*cached);
+                delete cached;
             }
         }
-        result += addrStr + " " + QString("%1").arg(hexStr, -48) + "  " + QString("%1").arg(ascStr, -17) + "\n";
+        if (_rows.at(row).valid)
+        {
+            row += 1;
+            continue;
+        }
+        int end = row + 1;
+        while ((end < count) && !_rows.at(end).valid && !_rowCache.contains(firstLine + end))
+            end += 1;
+        QVector<ShownRow> read = readRows(_chunks, firstLine + row, end - row, _bytesPerLine);
+        for (int idx = row; idx < end; idx++)
+        {
+            _tiles.remove(firstLine + idx);
+            _rows[idx] = std::move(read[idx - row]);
+        }
+        row = end;
     }
-    return result;
+    prefetch();
+}
+
+QVector<QHexEdit::ShownRow> QHexEdit::readRows(Chunks *chunks, qint64 firstLine, int count, int bytesPerLine)
+{
+    QByteArray marked;
+    QByteArray data = chunks->data(firstLine * bytesPerLine, (qint64)count * bytesPerLine, &marked);
+    QVector<ShownRow> rows(count);
+    for (int idx = 0; idx < count; idx++)
+    {
+        ShownRow &row = rows[idx];
+        row.data = data.mid(idx * bytesPerLine, bytesPerLine);
+        row.marked = marked.mid(idx * bytesPerLine, bytesPerLine);
+        row.hex = HexFormat::toHex(row.data);
+        row.valid = true;
+    }
+    return rows;
+}
+
+void QHexEdit::prefetch()
+{
+    // One block of missing rows per run, the next one is started when it
+    // arrives. Two pages ahead in scroll direction have priority over the
+    // page behind.
+    if (_prefetchWatcher.isRunning() || _rows.isEmpty())
+        return;
+    qint64 page = _rows.size();
+    qint64 lineCount = _chunks->size() / _bytesPerLine + 1;
+    qint64 starts[3] = { _rowsFirstLine + page, _rowsFirstLine + 2 * page, _rowsFirstLine - page };
+    if (_scrollDirection < 0)
+    {
+        starts[0] = _rowsFirstLine - page;
+        starts[1] = _rowsFirstLine - 2 * page;
+        starts[2] = _rowsFirstLine + page;
+    }
+    for (qint64 start : starts)
+    {
+        qint64 first = std::max<qint64>(start, 0);
+        qint64 end = std::min(start + page, lineCount);
+        while ((first < end) && _rowCache.contains(first))
+            first += 1;
+        if (first >= end)
+            continue;
+        qint64 last = first + 1;
+        while ((last < end) && !_rowCache.contains(last))
+            last += 1;
+
+        Chunks *chunks = _chunks;
+        int bytesPerLine = _bytesPerLine;
+        quint64 generation = _rowsGeneration;
+        int count = (int)(last - first);
+        _prefetchWatcher.setFuture(QtConcurrent::run([chunks, first, count, bytesPerLine, generation]() {
+            return RowBlock{first, bytesPerLine, generation, readRows(chunks, first, count, bytesPerLine)};
+        }));
+        return;
+    }
+}
+
+void QHexEdit::prefetchFinished()
+{
+    // Results read before an edit are outdated, those rows are read again.
+    // The tiles of fresh rows are rendered right away, while the view idles.
+    RowBlock block = _prefetchWatcher.result();
+    if ((block.generation == _rowsGeneration) && (block.bytesPerLine == _bytesPerLine))
+    {
+        updateTileStyle();
+        for (int idx = 0; idx < block.rows.size(); idx++)
+        {
+            qint64 line = block.firstLine + idx;
+            if ((line >= _rowsFirstLine) && (line < _rowsFirstLine + _rows.size()))
+                continue;
+            rowTile(line, block.rows.at(idx));
+            _rowCache.insert(line, new ShownRow(std::move(block.rows[idx])));
+        }
+    }
+    prefetch();
+}
+
+void QHexEdit::rangeChangedPrivate(qint64 pos, qint64 length)
+{
+    // Visible rows are read again by the next readBuffers(), which follows
+    // every edit, or by _rowsTimer, when Chunks was changed directly (e.g.
+    // by a panel showing polled data). Cached rows and tiles of the range
+    // are dropped.
+    _rowsGeneration += 1;
+    if (_rowsBytesPerLine <= 0)
+        return;
+    qint64 firstLine = pos / _rowsBytesPerLine;
+    qint64 lastLine = (length < 0) ? LLONG_MAX : (pos + length - 1) / _rowsBytesPerLine;
+    const QList<qint64> cachedLines = _rowCache.keys();
+    for (qint64 line : cachedLines)
+        if ((line >= firstLine) && (line <= lastLine))
+            _rowCache.remove(line);
+    const QList<qint64> tileLines = _tiles.keys();
+    for (qint64 line : tileLines)
+        if ((line >= firstLine) && (line <= lastLine))
+            _tiles.remove(line);
+
+    qint64 first = std::max<qint64>(firstLine - _rowsFirstLine, 0);
+    qint64 last = std::min<qint64>(lastLine - _rowsFirstLine, _rows.size() - 1);
+    for (qint64 row = first; row <= last; row++)
+        _rows[row].valid = false;
+    if (first <= last)
+    {
+        viewport()->update(0, (int)first * _pxCharHeight + _pxSelectionSub, viewport()->width(), (int)(last - first + 1) * _pxCharHeight);
+        _rowsTimer.start();
+    }
+}
+
+void QHexEdit::readBuffersPrivate()
+{
+    readBuffers();
+}
+
+bool QHexEdit::pasteFromClipboard(QByteArray &ba)
+{
+    // Parsed block by block, so large texts can show progress and be canceled
+    QByteArray text = QApplication::clipboard()->text().toLatin1();
+    QScopedPointer<QProgressDialog> progress;
+    if (text.size() > PASTE_PROGRESS)
+    {
+        progress.reset(new QProgressDialog(tr("Pasting..."), tr("Cancel"), 0, 1000, this));
+        progress->setWindowModality(Qt::WindowModal);
+        progress->setMinimumDuration(500);
+    }
+    HexParser parser;
+    ba.reserve(text.size() / 2);
+    for (qint64 pos = 0; pos < text.size(); pos += PASTE_BLOCK)
+    {
+        if (progress)
+        {
+            progress->setValue((int)(pos * 1000 / text.size()));
+            if (progress->wasCanceled())
+                return false;
+        }
+        parser.feed(text.constData() + pos, std::min<qint64>(PASTE_BLOCK, text.size() - pos), ba);
+    }
+    parser.finish(ba);
+    return true;
+}
+
+void QHexEdit::runSearch(const std::function<qint64(qint64 *, const Chunks::ProgressFunction &)> &search)
+{
+    // Chunks serializes the worker's reads with the edits done in the GUI thread
+    cancelSearch();
+    qint64 size = std::max<qint64>(_chunks->size(), 1);
+    _searchWatcher.setFuture(QtConcurrent::run([search, size](QPromise<QPair<qint64, qint64>> &promise) {
+        promise.setProgressRange(0, 1000);
+        qint64 length = 0;
+        qint64 pos = search(&length, [&promise, size](qint64 reached) {
+            promise.setProgressValue((int)(reached * 1000 / size));
+            return !promise.isCanceled();
+        });
+        promise.addResult(qMakePair(pos, length));
+    }));
+}
+
+void QHexEdit::searchFinishedPrivate()
+{
+    qint64 pos = -1;
+    qint64 length = 0;
+    if (!_searchWatcher.isCanceled() && (_searchWatcher.future().resultCount() > 0))
+    {
+        pos = _searchWatcher.result().first;
+        length = _searchWatcher.result().second;
+    }
+    if (pos > -1)
+        selectRange(pos, length);
+    emit searchFinished(pos, length);
 }
 
 void QHexEdit::updateCursor()
@@ -2,11 +2,18 @@
 #define QHEXEDIT_H
 
 #include <QAbstractScrollArea>
+#include <QCache>
+#include <QFutureWatcher>
 #include <QPen>
 #include <QBrush>
 
+#include "bytepattern.h"
 #include "chunks.h"
 #include "commands.h"
+#include "glyphcache.h"
+#include "hexformat.h"
+#include "minimap.h"
+#include "transform.h"
 
 #ifdef QHEXEDIT_EXPORTS
 #define QHEXEDIT_API Q_DECL_EXPORT
@@ -42,8 +49,9 @@ You can select data with keyboard hits or mouse movements. The copy-key will
 copy the selected data into the clipboard. The cut-key copies also but deletes
 it afterwards. In overwrite mode, the paste function overwrites the content of
 the (does not change the length) data. In insert mode, clipboard data will be
-inserted. The clipboard content is expected in ASCII Hex notation. Unknown
-characters will be ignored.
+inserted. The clipboard content is expected in ASCII Hex notation, plain or
+as a dump with address and ascii columns (see HexParser). Address and ascii
+columns and other text are skipped.
 
 QHexEdit comes with undo/redo functionality. All changes can be undone, by
 pressing the undo-key (usually ctr-z). They can also be redone afterwards.
@@ -140,6 +148,17 @@ class QHEXEDIT_API QHexEdit : public QAbstractScrollArea
     */
     Q_PROPERTY(QColor highlightingColor READ highlightingColor WRITE setHighlightingColor)
 
+    /*! Property mark color sets (setMarkColor()) the background color of the
+    ranges set by setMarkedRanges(). You can also read the color (markColor()).
+    */
+    Q_PROPERTY(QColor markColor READ markColor WRITE setMarkColor)
+
+    /*! Switch the minimap beside the vertical scrollbar on or off: true (show
+    it), false (hide it). The minimap colors the whole image by entropy and
+    byte classes, clicking into it scrolls there.
+    */
+    Q_PROPERTY(bool minimap READ minimap WRITE setMinimap)
+
     /*! Property overwrite mode sets (setOverwriteMode()) or gets (overwriteMode()) the mode
     in which the editor works. In overwrite mode the user will overwrite existing data. The
     size of data will be constant. In insert mode the size will grow, when inserting
@@ -187,6 +206,16 @@ public:
     */
     bool write(QIODevice &iODevice, qint64 pos=0, qint64 count=-1);
 
+    /*! Gives access to the storage backend, e.g. for scanning the data in worker
+    threads. Chunks is safe to be read from other threads while QHexEdit edits it.
+    */
+    Chunks *chunks();
+
+    /*! Reads \param length bytes from \param pos on again, after the QIODevice
+    changed them, e.g. when it pages data in later on. Length -1 means up to the end.
+    */
+    void reload(qint64 pos, qint64 length=-1);
+
 
     // Char handling
 
@@ -228,6 +257,15 @@ public:
     */
     void replace(qint64 pos, qint64 len, const QByteArray &ba);
 
+    /*! Applies a bulk transform (fill, xor, add, byte swap) to the selected
+    bytes as a single undo step. Large selections are transformed by a worker
+    thread behind a progress dialog.
+    \param transform Transform to apply
+    \return false if nothing is selected, the data is read only or the user
+    canceled
+    */
+    bool transformSelection(const Transform &transform);
+
 
     // Utility functions
     /*! Calc cursor position from graphics position
@@ -247,6 +285,34 @@ public:
      */
     qint64 indexOf(const QByteArray &ba, qint64 from);
 
+    /*! Find first match of a byte pattern in QHexEdit data
+     * \param pattern Compiled pattern, see BytePattern for the syntax
+     * \param from Point where the search starts
+     * \return pos if fond, else -1
+     */
+    qint64 indexOf(const BytePattern &pattern, qint64 from);
+
+    /*! Starts searching for ba in a worker thread. The editor stays usable while
+     * searching, progress is reported by searchProgress() and the result by
+     * searchFinished(). A found match is selected like indexOf() does. A search
+     * still running is cancelled.
+     * \param ba Data to find
+     * \param from Point where the search starts
+     */
+    void startSearch(const QByteArray &ba, qint64 from);
+
+    /*! Starts searching for a byte pattern in a worker thread, see startSearch()
+     */
+    void startSearch(const BytePattern &pattern, qint64 from);
+
+    /*! Cancels a running search, searchFinished() reports no match
+     */
+    void cancelSearch();
+
+    /*! Returns true while a search started by startSearch() is running
+     */
+    bool isSearching();
+
     /*! Returns if any changes where done on document
      * \return true when document is modified else false
      */
@@ -267,6 +333,46 @@ public:
     */
     QString selectedData();
 
+    /*! Position of the first selected byte
+    */
+    qint64 getSelectionBegin();
+
+    /*! Position behind the last selected byte, equals getSelectionBegin()
+    when nothing is selected
+    */
+    qint64 getSelectionEnd();
+
+    /*! Writes the selected content as text to device, block by block, so also
+    selections too large for the clipboard can be exported
+    \param format HexFormat::Hex, HexFormat::WrappedHex or HexFormat::Readable
+    \param progress Called with the position reached, returning false aborts
+    \return false, if writing failed or was aborted
+    */
+    bool writeSelection(QIODevice &device, HexFormat::Format format,
+                        const Chunks::ProgressFunction &progress=Chunks::ProgressFunction());
+
+    /*! Selects len bytes from pos, places the cursor behind them and scrolls
+     * them into view
+     */
+    void selectRange(qint64 pos, qint64 len);
+
+    /*! Marks ranges of bytes with the mark color, e.g. the differences to
+     * another image. Marks are shown below the selection and above the
+     * highlighting of changed bytes. Edits do not move them.
+     * \param ranges Pairs of position and length, sorted by position and not
+     * overlapping
+     */
+    void setMarkedRanges(const QVector<QPair<qint64, qint64>> &ranges);
+    QVector<QPair<qint64, qint64>> markedRanges();
+
+    /*! First line shown, lines are bytesPerLine() bytes long
+     */
+    qint64 topLine();
+
+    /*! Scrolls line to the top of the view, as far as possible
+     */
+    void scrollToLine(qint64 line);
+
     /*! Set Font of QHexEdit
      * \param font
      */
@@ -299,9 +405,28 @@ signals:
     /*! The signal is emitted every time, the data is changed. */
     void dataChanged();
 
+    /*! Emitted by setData() before the data is replaced and by the destructor
+    before it is destroyed. Threads reading chunks() have to stop before the
+    slot returns. */
+    void dataAboutToBeReplaced();
+
     /*! The signal is emitted every time, the overwrite mode is changed. */
     void overwriteModeChanged(bool state);
 
+    /*! Progress of a running background search in permille. */
+    void searchProgress(int permille);
+
+    /*! A background search has finished, pos is -1 when nothing was found or
+    the search was cancelled. */
+    void searchFinished(qint64 pos, qint64 length);
+
+    /*! The view was scrolled, line is the first line shown. */
+    void topLineChanged(qint64 line);
+
+    /*! The selection has changed. begin and end are byte positions, they are
+    equal when nothing is selected. */
+    void selectionChanged(qint64 begin, qint64 end);
+
 
 /*! \cond docNever */
 public:
@@ -356,6 +481,12 @@ public:
     QColor highlightingColor();
     void setHighlightingColor(const QColor &color);
 
+    QColor markColor();
+    void setMarkColor(const QColor &color);
+
+    bool minimap();
+    void setMinimap(bool minimap);
+
     bool overwriteMode();
     void setOverwriteMode(bool overwriteMode);
 
@@ -372,25 +503,68 @@ protected:
     void mousePressEvent(QMouseEvent * event);
     void paintEvent(QPaintEvent *event);
     void resizeEvent(QResizeEvent *);
+    void scrollContentsBy(int dx, int dy);
+    void wheelEvent(QWheelEvent *event);
     virtual bool focusNextPrevChild(bool next);
 private:
+    // One line of the view as read from chunks and formatted for painting
+    struct ShownRow
+    {
+        QByteArray data;
+        QByteArray hex;
+        QByteArray marked;
+        bool valid = false;
+    };
+
+    // Rendered row, valid as long as the part of the selection in it is the same
+    struct RowTile
+    {
+        QPixmap pixmap;
+        qint64 selectionBegin;
+        qint64 selectionEnd;
+    };
+
+    // Rows read ahead by the prefetcher
+    struct RowBlock
+    {
+        qint64 firstLine;
+        int bytesPerLine;
+        quint64 generation;
+        QVector<ShownRow> rows;
+    };
+
     // Handle selections
     void resetSelection(qint64 pos);            // set selectionStart and selectionEnd to pos
     void resetSelection();                      // set selectionEnd to selectionStart
     void setSelection(qint64 pos);              // set min (if below init) or max (if greater init)
-    qint64 getSelectionBegin();
-    qint64 getSelectionEnd();
+    void setSelectionRange(qint64 begin, qint64 end); // store and emit selectionChanged()
 
     // Private utility functions
     void init();
-    void readBuffers();
-    QString toReadable(const QByteArray &ba);
+    void readBuffers();                         // read rows, which are not yet in _rows
+    static QVector<ShownRow> readRows(Chunks *chunks, qint64 firstLine, int count, int bytesPerLine);
+    void prefetch();                            // read ahead rows in scroll direction
+    void updateTileStyle();                     // drop tiles, when font, colors or layout changed
+    RowTile *rowTile(qint64 line, const ShownRow &row); // cached or freshly rendered tile
+    void setTopLine(qint64 line, bool syncScrollBar=true); // scroll to line, the 64 bit position of the view
+    qint64 lineForScrollValue(int value);
+    int scrollValueForLine(qint64 line);
+    bool pasteFromClipboard(QByteArray &ba);    // parse the clipboard text, false if canceled
+    void stopWorkers();                         // before the device is replaced or destroyed
+    void runSearch(const std::function<qint64(qint64 *, const Chunks::ProgressFunction &)> &search);
 
 private slots:
     void adjust();                              // recalc pixel positions
     void dataChangedPrivate(int idx=0);         // emit dataChanged() signal
     void refresh();                             // ensureVisible() and readBuffers()
     void updateCursor();                        // update blinking cursor
+    void searchFinishedPrivate();               // select and emit search result
+    void rangeChangedPrivate(qint64 pos, qint64 length); // invalidate rows touched by an edit
+    void prefetchFinished();                    // move read ahead rows to the row cache
+    void verticalScrolled(int value);           // scrollbar moved by the user
+    void verticalAction(int action);            // scrollbar steps move by lines
+    void minimapClicked(qint64 pos);            // center the view on pos
+    void readBuffersPrivate();                  // readBuffers(), once the event loop idles
 
 private:
     // Name convention: pixel positions start with _px
@@ -414,6 +588,11 @@ private:
     qint64 _bPosLast;                           // position of last byte shown
     qint64 _bPosCurrent;                        // current position
 
+    // Vertical position, in lines of bytesPerLine
+    qint64 _topLine;                            // first line shown
+    qint64 _maxTopLine;                         // last line, which may be first line shown
+    int _wheelDelta;                            // wheel angle not yet scrolled, in 1/8 degree
+
     // variables to store the property values
     bool _addressArea;                          // left area of QHexEdit
     QColor _addressAreaColor;
@@ -432,6 +611,8 @@ private:
     QPen _penSelection;
     QBrush _brushHighlighted;
     QPen _penHighlighted;
+    QBrush _brushMarked;
+    QVector<QPair<qint64, qint64>> _markedRanges;
     bool _readOnly;
     bool _hexCaps;
     bool _dynamicBytesPerLine;
@@ -443,16 +624,29 @@ private:
     QBuffer _bData;                             // buffer, when setup with QByteArray
     Chunks *_chunks;                            // IODevice based access to data
     QTimer _cursorTimer;                        // for blinking cursor
+    QTimer _rowsTimer;                          // reads rows, which Chunks changed outside of edits
     qint64 _cursorPosition;                     // absolute position of cursor, 1 Byte == 2 tics
     QRect _cursorRect;                          // physical dimensions of cursor
     QByteArray _data;                           // QHexEdit's data, when setup with QByteArray
-    QByteArray _dataShown;                      // data in the current View
-    QByteArray _hexDataShown;                   // data in view, transformed to hex
+    QVector<ShownRow> _rows;                    // rows in the current view, _rows[0] is _rowsFirstLine
+    qint64 _rowsFirstLine;                      // line of _rows[0]
+    int _rowsBytesPerLine;                      // bytesPerLine, which _rows were read with
+    quint64 _rowsGeneration;                    // counts edits, to drop outdated prefetched rows
+    int _scrollDirection;                       // 1 after scrolling down, -1 after scrolling up
+    QCache<qint64, ShownRow> _rowCache;         // rows out of view, prefetched or scrolled out
+    QCache<qint64, RowTile> _tiles;             // rendered rows by line
+    size_t _tileStyle;                          // hash of what the tiles were rendered with
+    QFutureWatcher<RowBlock> _prefetchWatcher;  // background read ahead
     qint64 _lastEventSize;                      // size, which was emitted last time
-    QByteArray _markedShown;                    // marked data in view
     bool _modified;                             // Is any data in editor modified?
     int _rowsShown;                             // lines of text shown
     UndoStack * _undoStack;                     // Stack to store edit actions for undo/redo
+    QFutureWatcher<QPair<qint64, qint64>> _searchWatcher; // background search, result is pos and length
+    GlyphCache _glyphs;                         // pre-rendered characters for paintEvent()
+    Minimap *_minimap;                          // overview beside the scrollbar, NULL when off
+    QFutureWatcher<QUndoCommand *> *_transformWatcher; // large transformSelection() running, NULL if none
+    QSharedPointer<QAtomicInt> _transformCanceled; // set by its dialog or stopWorkers()
+    bool _transformStopped;                     // by stopWorkers(), its command is dropped
     /*! \endcond docNever */
 };
 
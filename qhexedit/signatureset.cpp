@@ -0,0 +1,255 @@
+#include "signatureset.h"
+#include <algorithm>
+#include <ctype.h>
+#include <vector>
+
+#define BUFFER_SIZE 0x10000
+
+
+// ***************************************** Signatures
+
+SignatureSet::SignatureSet()
+    : _maxLength(0)
+{
+}
+
+bool SignatureSet::load(QIODevice &device)
+{
+    _error.clear();
+    if (!device.isOpen() && !device.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        _error = device.errorString();
+        return false;
+    }
+
+    int lineNo = 0;
+    while (!device.atEnd())
+    {
+        QString line = QString::fromUtf8(device.readLine()).trimmed();
+        lineNo += 1;
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        int eq = line.lastIndexOf('=');
+        QByteArray hex = line.mid(eq + 1).remove(QRegularExpression("\\s")).toLatin1();
+        bool valid = (eq > 0) && !hex.isEmpty() && ((hex.size() % 2) == 0);
+        for (char c : hex)
+            valid = valid && isxdigit((uchar)c);
+        if (!valid)
+        {
+            if (_error.isEmpty())
+                _error = QObject::tr("Line %1: expected \"name = hex bytes\"").arg(lineNo);
+            continue;
+        }
+        add(line.left(eq).trimmed(), QByteArray::fromHex(hex));
+    }
+    compile();
+    return _error.isEmpty();
+}
+
+bool SignatureSet::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        _error = file.errorString();
+        return false;
+    }
+    return load(file);
+}
+
+QString SignatureSet::errorString() const
+{
+    return _error;
+}
+
+void SignatureSet::add(const QString &name, const QByteArray &bytes)
+{
+    if (bytes.isEmpty())
+        return;
+    _signatures.append({name, bytes});
+    _maxLength = std::max(_maxLength, (int)bytes.size());
+}
+
+void SignatureSet::clear()
+{
+    _signatures.clear();
+    _maxLength = 0;
+    compile();
+}
+
+int SignatureSet::count() const
+{
+    return _signatures.size();
+}
+
+const SignatureSet::Signature &SignatureSet::signature(int idx) const
+{
+    return _signatures.at(idx);
+}
+
+int SignatureSet::maxLength() const
+{
+    return _maxLength;
+}
+
+
+// ***************************************** Automaton
+
+void SignatureSet::compile()
+{
+    _states.clear();
+    _edges.clear();
+    _outputs.clear();
+    _root.clear();
+    if (_signatures.isEmpty())
+        return;
+
+    // 1. Build the trie
+    std::vector<std::vector<std::pair<uchar, qint32>>> children(1);
+    std::vector<std::vector<qint32>> outputs(1);
+    auto child = [&children](qint32 state, uchar b) -> qint32 {
+        for (auto &edge : children[state])
+            if (edge.first == b)
+                return edge.second;
+        return -1;
+    };
+    for (int idx=0; idx < _signatures.size(); idx++)
+    {
+        qint32 state = 0;
+        for (char c : _signatures.at(idx).bytes)
+        {
+            qint32 target = child(state, (uchar)c);
+            if (target < 0)
+            {
+                target = (qint32)children.size();
+                children[state].push_back({(uchar)c, target});
+                children.emplace_back();
+                outputs.emplace_back();
+            }
+            state = target;
+        }
+        outputs[state].push_back(idx);
+    }
+
+    // 2. Fail and dictionary links in breadth first order, so the links of
+    // shallower states are known when they are needed.
+    qint32 count = (qint32)children.size();
+    std::vector<qint32> fail(count, 0), dict(count, -1);
+    std::vector<qint32> queue;
+    for (auto &edge : children[0])
+        queue.push_back(edge.second);
+    for (size_t head=0; head < queue.size(); head++)
+    {
+        qint32 state = queue[head];
+        for (auto &edge : children[state])
+        {
+            qint32 f = fail[state];
+            while ((f != 0) && (child(f, edge.first) < 0))
+                f = fail[f];
+            qint32 target = child(f, edge.first);
+            fail[edge.second] = (target >= 0) ? target : 0;
+            qint32 failState = fail[edge.second];
+            dict[edge.second] = outputs[failState].empty() ? dict[failState] : failState;
+            queue.push_back(edge.second);
+        }
+    }
+
+    // 3. Flatten into sorted edge and output arrays
+    _states.resize(count);
+    for (qint32 state=0; state < count; state++)
+    {
+        auto &edges = children[state];
+        std::sort(edges.begin(), edges.end());
+        State &s = _states[state];
+        s.fail = fail[state];
+        s.dict = dict[state];
+        s.edgeBegin = _edges.size();
+        s.edgeCount = (qint32)edges.size();
+        s.outBegin = _outputs.size();
+        s.outCount = (qint32)outputs[state].size();
+        for (auto &edge : edges)
+            _edges.append({edge.first, edge.second});
+        for (qint32 out : outputs[state])
+            _outputs.append(out);
+    }
+    _root.fill(0, 256);
+    for (auto &edge : children[0])
+        _root[edge.first] = edge.second;
+}
+
+int SignatureSet::next(int state, uchar b) const
+{
+    const State &s = _states.at(state);
+    const Edge *begin = _edges.constData() + s.edgeBegin;
+    const Edge *end = begin + s.edgeCount;
+    const Edge *it = std::lower_bound(begin, end, b, [](const Edge &edge, uchar value) {
+        return edge.byte < value;
+    });
+    return ((it != end) && (it->byte == b)) ? it->target : -1;
+}
+
+int SignatureSet::feed(int state, const char *data, qint64 len, qint64 pos,
+                       qint64 reportFrom, qint64 reportTo, QVector<Hit> &hits) const
+{
+    const State *states = _states.constData();
+    for (qint64 idx=0; idx < len; idx++)
+    {
+        uchar b = (uchar)data[idx];
+        for (;;)
+        {
+            if (state == 0)
+            {
+                state = _root[b];
+                break;
+            }
+            int target = next(state, b);
+            if (target >= 0)
+            {
+                state = target;
+                break;
+            }
+            state = states[state].fail;
+        }
+
+        int out = states[state].outCount ? state : states[state].dict;
+        for (; out >= 0; out = states[out].dict)
+            for (int o=0; o < states[out].outCount; o++)
+            {
+                int sig = _outputs.at(states[out].outBegin + o);
+                qint64 start = pos + idx + 1 - _signatures.at(sig).bytes.size();
+                if ((start >= reportFrom) && (start < reportTo))
+                    hits.append({start, sig});
+            }
+    }
+    return state;
+}
+
+QVector<SignatureSet::Hit> SignatureSet::scan(const char *data, qint64 len, qint64 pos) const
+{
+    QVector<Hit> hits;
+    if (!_states.isEmpty())
+        feed(0, data, len, pos, pos, pos + len, hits);
+    return hits;
+}
+
+QVector<SignatureSet::Hit> SignatureSet::scan(Chunks &chunks, qint64 from, qint64 to,
+                                              const Chunks::ProgressFunction &progress) const
+{
+    QVector<Hit> hits;
+    if (_states.isEmpty())
+        return hits;
+
+    // Read maxLength()-1 bytes behind the range, so matches starting inside
+    // it are complete. The automaton state is carried from block to block.
+    qint64 end = std::min(chunks.size(), to + _maxLength - 1);
+    int state = 0;
+    for (qint64 pos=from; pos < end; pos += BUFFER_SIZE)
+    {
+        if (progress && !progress(pos))
+            break;
+        QByteArray buffer = chunks.data(pos, std::min<qint64>(BUFFER_SIZE, end - pos));
+        state = feed(state, buffer.constData(), buffer.size(), pos, from, to, hits);
+    }
+    return hits;
+}
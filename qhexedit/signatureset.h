@@ -0,0 +1,103 @@
+#ifndef SIGNATURESET_H
+#define SIGNATURESET_H
+
+/** \cond docNever */
+
+/*! SignatureSet holds a library of byte signatures and finds all of them in one
+ * pass over the data, using an Aho-Corasick automaton.
+ *
+ * Signature files are text files with one signature per line:
+ *
+ *   # comment
+ *   Bootloader v1.2 = 55 AA 01 02 4C
+ *   Vendor magic    = 50 45 41 53
+ *
+ * Everything in front of the last '=' is the name, behind it the plain hex
+ * bytes of the signature.
+ *
+ * After adding signatures, compile() builds the automaton; load() does so by
+ * itself. The root state has a full transition table, all other states keep their
+ * edges sorted by byte value, which keeps several thousand signatures small.
+ * scan() works on a range of Chunks and reports only matches starting in that
+ * range, reading up to maxLength()-1 bytes behind it. So a big image can be
+ * split into partitions, which are scanned in parallel and report every match
+ * exactly once.
+ */
+
+#include <QtCore>
+
+#include "chunks.h"
+
+class SignatureSet
+{
+public:
+    struct Signature
+    {
+        QString name;
+        QByteArray bytes;
+    };
+
+    struct Hit
+    {
+        qint64 pos;
+        int signature;                          // index into signature()
+    };
+
+    SignatureSet();
+
+    // Appends the signatures of a signature file, returns false on errors
+    bool load(QIODevice &device);
+    bool load(const QString &fileName);
+    QString errorString() const;
+
+    void add(const QString &name, const QByteArray &bytes);
+    void clear();
+    void compile();
+
+    int count() const;
+    const Signature &signature(int idx) const;
+    int maxLength() const;
+
+    // Finds all matches inside data[0..len), pos is the position of data
+    QVector<Hit> scan(const char *data, qint64 len, qint64 pos) const;
+
+    // Finds all matches starting in [from, to) of chunks. Safe to be called
+    // from several threads at once.
+    QVector<Hit> scan(Chunks &chunks, qint64 from, qint64 to,
+                      const Chunks::ProgressFunction &progress=Chunks::ProgressFunction()) const;
+
+private:
+    int next(int state, uchar b) const;
+    int feed(int state, const char *data, qint64 len, qint64 pos,
+             qint64 reportFrom, qint64 reportTo, QVector<Hit> &hits) const;
+
+    struct State
+    {
+        qint32 fail;
+        qint32 dict;                            // next state on the fail chain with outputs
+        qint32 edgeBegin;
+        qint32 edgeCount;
+        qint32 outBegin;
+        qint32 outCount;
+    };
+
+    struct Edge
+    {
+        uchar byte;
+        qint32 target;
+    };
+
+    QList<Signature> _signatures;
+    QString _error;
+    int _maxLength;
+
+    // Automaton, built by compile()
+    QVector<State> _states;
+    QVector<Edge> _edges;
+    QVector<qint32> _outputs;                   // signature indices
+    QVector<qint32> _root;                      // full transition table of state 0
+};
+
+/** \endcond docNever */
+
+#endif // SIGNATURESET_H
@@ -0,0 +1,156 @@
+#include "sparseimage.h"
+#include <algorithm>
+#include <string.h>
+
+#define MIN_FILL_RUN 0x100                      // shorter runs stay in the data extents
+
+
+// ***************************************** Assembling
+
+SparseImage::SparseImage(QObject *parent) : QIODevice(parent)
+    , _size(0)
+    , _tailRun(0)
+{
+}
+
+void SparseImage::append(const char *data, qint64 len)
+{
+    // Split into runs of equal bytes, the first one may continue the tail
+    qint64 idx = 0;
+    while (idx < len)
+    {
+        qint64 end = idx + 1;
+        while ((end < len) && (data[end] == data[idx]))
+            end++;
+        appendRun(data[idx], end - idx);
+        idx = end;
+    }
+}
+
+void SparseImage::append(const QByteArray &ba)
+{
+    append(ba.constData(), ba.size());
+}
+
+void SparseImage::clear()
+{
+    _extents.clear();
+    _size = 0;
+    _tailRun = 0;
+}
+
+void SparseImage::appendRun(char value, qint64 count)
+{
+    if (!_extents.isEmpty() && _extents.last().data.isEmpty() && (_extents.last().fill == value))
+    {
+        _extents.last().length += count;
+        _size += count;
+        return;
+    }
+
+    if (_extents.isEmpty() || _extents.last().data.isEmpty())
+    {
+        _extents.append(Extent{ _size, 0, QByteArray(), 0 });
+        _tailRun = 0;
+    }
+    Extent &tail = _extents.last();
+    qint64 run = (!tail.data.isEmpty() && (tail.data.back() == value)) ? _tailRun + count : count;
+    if (run >= MIN_FILL_RUN)
+    {
+        // The part of the run already stored moves into the new fill extent
+        qint64 stored = run - count;
+        tail.data.chop(stored);
+        tail.length -= stored;
+        if (tail.length == 0)
+            _extents.removeLast();
+        _extents.append(Extent{ _size - stored, run, QByteArray(), value });
+        _tailRun = 0;
+    }
+    else
+    {
+        tail.data.append(count, value);
+        tail.length += count;
+        _tailRun = run;
+    }
+    _size += count;
+}
+
+
+// ***************************************** Queries
+
+int SparseImage::extentAt(qint64 pos) const
+{
+    auto it = std::upper_bound(_extents.cbegin(), _extents.cend(), pos,
+                               [](qint64 pos, const Extent &extent) { return pos < extent.pos; });
+    return int(it - _extents.cbegin()) - 1;
+}
+
+qint64 SparseImage::fillLength(qint64 pos, char *value) const
+{
+    if ((pos < 0) || (pos >= _size))
+        return 0;
+    const Extent &extent = _extents.at(extentAt(pos));
+    if (!extent.data.isEmpty())
+        return 0;
+    *value = extent.fill;
+    return extent.pos + extent.length - pos;
+}
+
+qint64 SparseImage::storedSize() const
+{
+    qint64 stored = 0;
+    for (const Extent &extent : _extents)
+        stored += extent.data.size();
+    return stored;
+}
+
+int SparseImage::extentCount() const
+{
+    return _extents.size();
+}
+
+
+// ***************************************** QIODevice
+
+bool SparseImage::open(OpenMode mode)
+{
+    // Reads go straight to readData(), QIODevice would only copy them twice
+    if (mode & WriteOnly)
+        return false;
+    return QIODevice::open(mode | Unbuffered);
+}
+
+bool SparseImage::isSequential() const
+{
+    return false;
+}
+
+qint64 SparseImage::size() const
+{
+    return _size;
+}
+
+qint64 SparseImage::readData(char *data, qint64 maxSize)
+{
+    qint64 pos = this->pos();
+    qint64 done = 0;
+    if (pos >= _size)
+        return 0;
+    for (int idx = extentAt(pos);(idx < _extents.size()) && (done < maxSize); idx++)
+    {
+        const Extent &extent = _extents.at(idx);
+        qint64 offset = pos + done - extent.pos;
+        qint64 count = std::min(maxSize - done, extent.length - offset);
+        if (extent.data.isEmpty())
+            memset(data + done, extent.fill, count);
+        else
+            memcpy(data + done, extent.data.constData() + offset, count);
+        done += count;
+    }
+    return done;
+}
+
+qint64 SparseImage::writeData(const char *, qint64)
+{
+    return -1;
+}
@@ -0,0 +1,67 @@
+#ifndef SPARSEIMAGE_H
+#define SPARSEIMAGE_H
+
+/** \cond docNever */
+
+/*! SparseImage is a read only QIODevice for images, which are mostly one fill
+ * value, like flash dumps with their erased 0xff regions.
+ *
+ * The image is assembled with append(). Runs of at least MIN_FILL_RUN equal
+ * bytes are kept as fill extents (value and length), everything else as data
+ * extents. Runs are followed across append() calls, so dumps arriving in
+ * small records collapse as well.
+ *
+ * Reading expands fill extents into the caller's buffer, so Chunks and
+ * everything above it see plain bytes. fillLength() tells, how far a fill
+ * reaches from a position, which lets searches skip and hashes shortcut it.
+ */
+
+#include <QtCore>
+
+class SparseImage : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    SparseImage(QObject *parent=0);
+
+    // Assembling, only while no reader uses the image
+    void append(const char *data, qint64 len);
+    void append(const QByteArray &ba);
+    void clear();
+
+    // Bytes equal to *value from pos on, 0 if pos is no fill extent
+    qint64 fillLength(qint64 pos, char *value) const;
+
+    qint64 storedSize() const;                  // bytes held by data extents
+    int extentCount() const;
+
+    // QIODevice
+    bool open(OpenMode mode) override;
+    bool isSequential() const override;
+    qint64 size() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    struct Extent
+    {
+        qint64 pos;
+        qint64 length;
+        QByteArray data;                        // empty for fill extents
+        char fill;
+    };
+
+    void appendRun(char value, qint64 count);
+    int extentAt(qint64 pos) const;
+
+    QVector<Extent> _extents;                   // sorted and gapless
+    qint64 _size;
+    qint64 _tailRun;                            // equal bytes at the end of the last data extent
+};
+
+/** \endcond docNever */
+
+#endif // SPARSEIMAGE_H
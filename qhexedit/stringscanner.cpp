@@ -0,0 +1,254 @@
+#include "stringscanner.h"
+#include <algorithm>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define STRINGS_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define STRINGS_NEON
+#endif
+
+#define BUFFER_SIZE 0x10000
+
+
+// ***************************************** Kernel
+
+#if defined(STRINGS_NEON)
+// Bit masks of four compare results, NEON has no movemask. The bytes are
+// weighted by their bit and summed up pairwise, until 8 bytes are left.
+static inline quint64 movemask64(const uint8x16_t masks[4])
+{
+    static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint8x16_t bits = vld1q_u8(weights);
+    uint8x16_t low = vpaddq_u8(vandq_u8(masks[0], bits), vandq_u8(masks[1], bits));
+    uint8x16_t high = vpaddq_u8(vandq_u8(masks[2], bits), vandq_u8(masks[3], bits));
+    uint8x16_t sum = vpaddq_u8(low, high);
+    sum = vpaddq_u8(sum, sum);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+}
+#endif
+
+void StringScanner::classify(const char *data, quint64 *printable, quint64 *zero)
+{
+#if defined(STRINGS_SSE2)
+    // Bytes 0x80..0xff are negative, the signed compares drop them
+    const __m128i low = _mm_set1_epi8(0x1f);
+    const __m128i high = _mm_set1_epi8(0x7f);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i nul = _mm_setzero_si128();
+    quint64 p = 0;
+    quint64 z = 0;
+    for (int q = 0; q < 4; q++)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + 16 * q));
+        __m128i isPrintable = _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi8(v, low), _mm_cmplt_epi8(v, high)),
+                                           _mm_cmpeq_epi8(v, tab));
+        p |= (quint64)(quint16)_mm_movemask_epi8(isPrintable) << (16 * q);
+        z |= (quint64)(quint16)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nul)) << (16 * q);
+    }
+    *printable = p;
+    *zero = z;
+#elif defined(STRINGS_NEON)
+    uint8x16_t p[4];
+    uint8x16_t z[4];
+    for (int q = 0; q < 4; q++)
+    {
+        uint8x16_t v = vld1q_u8((const uint8_t *)(data + 16 * q));
+        p[q] = vorrq_u8(vandq_u8(vcgeq_u8(v, vdupq_n_u8(0x20)), vcleq_u8(v, vdupq_n_u8(0x7e))),
+                        vceqq_u8(v, vdupq_n_u8('\t')));
+        z[q] = vceqq_u8(v, vdupq_n_u8(0));
+    }
+    *printable = movemask64(p);
+    *zero = movemask64(z);
+#else
+    quint64 p = 0;
+    quint64 z = 0;
+    for (int idx = 0; idx < 64; idx++)
+    {
+        uchar b = (uchar)data[idx];
+        if (((b >= 0x20) && (b <= 0x7e)) || (b == '\t'))
+            p |= Q_UINT64_C(1) << idx;
+        if (b == 0)
+            z |= Q_UINT64_C(1) << idx;
+    }
+    *printable = p;
+    *zero = z;
+#endif
+}
+
+// Bits 0, 2, 4, ... of x moved to bits 0, 1, 2, ...
+static inline quint64 evenBits(quint64 x)
+{
+    x &= Q_UINT64_C(0x5555555555555555);
+    x = (x | (x >> 1)) & Q_UINT64_C(0x3333333333333333);
+    x = (x | (x >> 2)) & Q_UINT64_C(0x0f0f0f0f0f0f0f0f);
+    x = (x | (x >> 4)) & Q_UINT64_C(0x00ff00ff00ff00ff);
+    x = (x | (x >> 8)) & Q_UINT64_C(0x0000ffff0000ffff);
+    x = (x | (x >> 16)) & Q_UINT64_C(0x00000000ffffffff);
+    return x;
+}
+
+
+// ***************************************** Scanner
+
+StringScanner::StringScanner(int minLength, bool ascii, bool utf16)
+    : _minLength(std::max(1, minLength))
+    , _ascii(ascii)
+    , _utf16(utf16)
+{
+}
+
+int StringScanner::minLength() const
+{
+    return _minLength;
+}
+
+bool StringScanner::ascii() const
+{
+    return _ascii;
+}
+
+bool StringScanner::utf16() const
+{
+    return _utf16;
+}
+
+// Follows runs of set bits over successive masks, bit i of a mask stands for
+// the character at pos + i * stride
+struct RunTracker
+{
+    StringScanner::Encoding encoding;
+    int stride;
+    qint64 from;
+    qint64 to;
+    int minLength;
+    QVector<StringScanner::Match> *matches;
+    qint64 start;                               // first character of the open run, -1 if none
+    qint64 next;                                // position behind the last character fed
+
+    bool pending() const
+    {
+        return (start >= 0) && (start < to);
+    }
+
+    void close(qint64 end)
+    {
+        qint64 length = (end - start) / stride;
+        if ((start >= from) && (start < to) && (length >= minLength))
+            matches->append(StringScanner::Match{ start, length, encoding });
+        start = -1;
+    }
+
+    void feed(quint64 mask, int bits, qint64 pos)
+    {
+        quint64 ends = ~mask;
+        if (bits < 64)
+            ends |= ~Q_UINT64_C(0) << bits;
+        int idx = 0;
+        while (idx < bits)
+        {
+            if (start < 0)
+            {
+                quint64 rest = mask >> idx;
+                if (rest == 0)
+                    break;
+                idx += qCountTrailingZeroBits(rest);
+                start = pos + (qint64)idx * stride;
+            }
+            quint64 rest = ends >> idx;
+            if (rest == 0)
+                break;
+            idx += qCountTrailingZeroBits(rest);
+            if (idx >= bits)
+                break;
+            close(pos + (qint64)idx * stride);
+        }
+        next = pos + (qint64)bits * stride;
+    }
+};
+
+QVector<StringScanner::Match> StringScanner::scan(Chunks &chunks, qint64 from, qint64 to,
+                                                  const Chunks::ProgressFunction &progress) const
+{
+    QVector<Match> matches;
+    qint64 size = chunks.size();
+    to = std::min(to, size);
+    if ((from >= to) || (!_ascii && !_utf16))
+        return matches;
+
+    // Reading starts two bytes in front of the range: a string running into
+    // it then starts in front of from and is left to the partition before.
+    qint64 base = std::max<qint64>(0, from - 2);
+    RunTracker asciiRun = { Ascii, 1, from, to, _minLength, &matches, -1, base };
+    RunTracker wideRuns[2] = { { Utf16Le, 2, from, to, _minLength, &matches, -1, base },
+                               { Utf16Le, 2, from, to, _minLength, &matches, -1, base + 1 } };
+    for (qint64 pos = base; pos < size; pos += BUFFER_SIZE)
+    {
+        if ((pos >= to) && !asciiRun.pending() && !wideRuns[0].pending() && !wideRuns[1].pending())
+            break;
+        if (progress && !progress(pos))
+            break;
+
+        // One byte more, the last UTF-16 character needs the zero behind it
+        QByteArray buffer = chunks.data(pos, BUFFER_SIZE + 1);
+        const char *data = buffer.constData();
+        qint64 len = std::min<qint64>(buffer.size(), BUFFER_SIZE);
+        for (qint64 offset = 0; offset < len; offset += 64)
+        {
+            int bits = (int)std::min<qint64>(64, len - offset);
+            quint64 printable, zero;
+            if (bits == 64)
+                classify(data + offset, &printable, &zero);
+            else
+            {
+                char tail[64];
+                memset(tail, 0, sizeof(tail));
+                memcpy(tail, data + offset, bits);
+                classify(tail, &printable, &zero);
+                quint64 valid = (Q_UINT64_C(1) << bits) - 1;
+                printable &= valid;
+                zero &= valid;
+            }
+            if (_ascii)
+                asciiRun.feed(printable, bits, pos + offset);
+            if (_utf16)
+            {
+                quint64 zeroBehind = ((offset + bits) < buffer.size()) && (data[offset + bits] == 0);
+                quint64 wide = printable & ((zero >> 1) | (zeroBehind << (bits - 1)));
+                wideRuns[0].feed(evenBits(wide), (bits + 1) / 2, pos + offset);
+                wideRuns[1].feed(evenBits(wide >> 1), bits / 2, pos + offset + 1);
+            }
+        }
+    }
+
+    // Runs still open end with the data read
+    for (RunTracker *run : { &asciiRun, &wideRuns[0], &wideRuns[1] })
+        if (run->start >= 0)
+            run->close(run->next);
+    std::sort(matches.begin(), matches.end(), [](const Match &a, const Match &b) {
+        return (a.pos < b.pos) || ((a.pos == b.pos) && (a.encoding < b.encoding));
+    });
+    return matches;
+}
+
+QString StringScanner::text(Chunks &chunks, const Match &match, int maxLength)
+{
+    qint64 length = std::min<qint64>(match.length, maxLength);
+    if (match.encoding == Ascii)
+        return QString::fromLatin1(chunks.data(match.pos, length));
+
+    // Characters of found UTF-16LE strings are ASCII, the high bytes are zero
+    QByteArray data = chunks.data(match.pos, 2 * length);
+    QString result;
+    result.reserve(data.size() / 2);
+    for (int idx = 0; idx + 1 < data.size(); idx += 2)
+        result.append(QChar((uchar)data[idx]));
+    return result;
+}
+
+qint64 StringScanner::byteLength(const Match &match)
+{
+    return (match.encoding == Utf16Le) ? 2 * match.length : match.length;
+}
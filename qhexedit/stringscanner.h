@@ -0,0 +1,72 @@
+#ifndef STRINGSCANNER_H
+#define STRINGSCANNER_H
+
+/** \cond docNever */
+
+/*! StringScanner finds runs of printable characters in an image, like the
+ * strings tool does: ASCII strings and UTF-16LE strings, whose characters are
+ * printable ASCII followed by a zero byte. Printable are 0x20..0x7e and tab.
+ *
+ * The data is classified 64 bytes at a time by a SIMD kernel (SSE2 or NEON),
+ * which gives a bit mask of printable bytes and one of zero bytes. Runs are
+ * then found in the masks by counting zero bits, so the bytes are never
+ * looked at one by one. UTF-16LE characters are printable bytes with a zero
+ * byte behind; their mask is split into even and odd positions, so strings
+ * at both alignments are found.
+ *
+ * scan() works on a range of Chunks and reports only strings starting in that
+ * range, reading behind it until they end. So a big image can be split into
+ * partitions, which are scanned in parallel and report every string exactly
+ * once.
+ */
+
+#include <QtCore>
+
+#include "chunks.h"
+
+class StringScanner
+{
+public:
+    enum Encoding
+    {
+        Ascii,
+        Utf16Le
+    };
+
+    struct Match
+    {
+        qint64 pos;
+        qint64 length;                          // in characters
+        Encoding encoding;
+    };
+
+    StringScanner(int minLength=4, bool ascii=true, bool utf16=true);
+
+    int minLength() const;
+    bool ascii() const;
+    bool utf16() const;
+
+    // Finds all strings starting in [from, to) of chunks, sorted by position.
+    // Safe to be called from several threads at once.
+    QVector<Match> scan(Chunks &chunks, qint64 from, qint64 to,
+                        const Chunks::ProgressFunction &progress=Chunks::ProgressFunction()) const;
+
+    // Text of a match, cut after maxLength characters
+    static QString text(Chunks &chunks, const Match &match, int maxLength);
+
+    // Bytes a match covers in the image
+    static qint64 byteLength(const Match &match);
+
+    // Kernel: bit i of *printable (*zero) is set, if data[i] is printable
+    // (zero), for 64 bytes of data
+    static void classify(const char *data, quint64 *printable, quint64 *zero);
+
+private:
+    int _minLength;
+    bool _ascii;
+    bool _utf16;
+};
+
+/** \endcond docNever */
+
+#endif // STRINGSCANNER_H
@@ -0,0 +1,211 @@
+#include "transform.h"
+#include <algorithm>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define TRANSFORM_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define TRANSFORM_NEON
+#endif
+
+#define MIN_STREAM 0x400        // short operands are repeated at least to this length
+
+
+// ***************************************** Transform
+
+Transform::Transform(Operation operation, const QByteArray &operand)
+    : _operation(operation)
+    , _operand(operand.isEmpty() ? QByteArray(1, char(0)) : operand)
+{
+    qint64 streamLen = 16 * _operand.size();
+    while (streamLen < MIN_STREAM)
+        streamLen *= 2;
+    _stream.reserve(streamLen);
+    while (_stream.size() < streamLen)
+        _stream.append(_operand);
+}
+
+Transform::Operation Transform::operation() const
+{
+    return _operation;
+}
+
+QByteArray Transform::operand() const
+{
+    return _operand;
+}
+
+QString Transform::name() const
+{
+    switch (_operation)
+    {
+        case Fill:
+            return QObject::tr("Fill");
+        case Xor:
+            return QObject::tr("XOR");
+        case Add:
+            return QObject::tr("Add");
+        case Swap16:
+            return QObject::tr("Swap 16 bit");
+        case Swap32:
+            return QObject::tr("Swap 32 bit");
+    }
+    return QString();
+}
+
+bool Transform::isInvertible() const
+{
+    return _operation != Fill;
+}
+
+Transform Transform::inverse() const
+{
+    if (_operation != Add)
+        return *this;
+    QByteArray negated = _operand;
+    for (int idx = 0; idx < negated.size(); idx++)
+        negated[idx] = char(-negated[idx]);
+    return Transform(Add, negated);
+}
+
+void Transform::apply(char *data, qint64 len, qint64 offset) const
+{
+    qint64 phase = offset % _stream.size();
+    switch (_operation)
+    {
+        case Fill:
+            fillStream(data, len, _stream.constData(), _stream.size(), phase);
+            break;
+        case Xor:
+            xorStream(data, len, _stream.constData(), _stream.size(), phase);
+            break;
+        case Add:
+            addStream(data, len, _stream.constData(), _stream.size(), phase);
+            break;
+        case Swap16:
+            swap16(data, len);
+            break;
+        case Swap32:
+            swap32(data, len);
+            break;
+    }
+}
+
+
+// ***************************************** Kernels
+
+static void xorBytes(char *data, const char *operand, qint64 len)
+{
+    qint64 idx = 0;
+#if defined(TRANSFORM_SSE2)
+    for (; idx + 16 <= len; idx += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + idx));
+        __m128i k = _mm_loadu_si128((const __m128i *)(operand + idx));
+        _mm_storeu_si128((__m128i *)(data + idx), _mm_xor_si128(v, k));
+    }
+#elif defined(TRANSFORM_NEON)
+    for (; idx + 16 <= len; idx += 16)
+        vst1q_u8((uint8_t *)(data + idx), veorq_u8(vld1q_u8((const uint8_t *)(data + idx)),
+                                                   vld1q_u8((const uint8_t *)(operand + idx))));
+#endif
+    for (; idx < len; idx++)
+        data[idx] ^= operand[idx];
+}
+
+static void addBytes(char *data, const char *operand, qint64 len)
+{
+    qint64 idx = 0;
+#if defined(TRANSFORM_SSE2)
+    for (; idx + 16 <= len; idx += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + idx));
+        __m128i k = _mm_loadu_si128((const __m128i *)(operand + idx));
+        _mm_storeu_si128((__m128i *)(data + idx), _mm_add_epi8(v, k));
+    }
+#elif defined(TRANSFORM_NEON)
+    for (; idx + 16 <= len; idx += 16)
+        vst1q_u8((uint8_t *)(data + idx), vaddq_u8(vld1q_u8((const uint8_t *)(data + idx)),
+                                                   vld1q_u8((const uint8_t *)(operand + idx))));
+#endif
+    for (; idx < len; idx++)
+        data[idx] = char(uchar(data[idx]) + uchar(operand[idx]));
+}
+
+static void copyBytes(char *data, const char *operand, qint64 len)
+{
+    memcpy(data, operand, len);
+}
+
+// Runs op over data and the stream side by side, wrapping the stream
+static void forStream(char *data, qint64 len, const char *stream, qint64 streamLen, qint64 phase,
+                      void (*op)(char *, const char *, qint64))
+{
+    qint64 idx = 0;
+    while (idx < len)
+    {
+        qint64 count = std::min(len - idx, streamLen - phase);
+        op(data + idx, stream + phase, count);
+        idx += count;
+        phase = 0;
+    }
+}
+
+void Transform::fillStream(char *data, qint64 len, const char *stream, qint64 streamLen, qint64 phase)
+{
+    forStream(data, len, stream, streamLen, phase, copyBytes);
+}
+
+void Transform::xorStream(char *data, qint64 len, const char *stream, qint64 streamLen, qint64 phase)
+{
+    forStream(data, len, stream, streamLen, phase, xorBytes);
+}
+
+void Transform::addStream(char *data, qint64 len, const char *stream, qint64 streamLen, qint64 phase)
+{
+    forStream(data, len, stream, streamLen, phase, addBytes);
+}
+
+void Transform::swap16(char *data, qint64 len)
+{
+    qint64 idx = 0;
+#if defined(TRANSFORM_SSE2)
+    for (; idx + 16 <= len; idx += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + idx));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *)(data + idx), v);
+    }
+#elif defined(TRANSFORM_NEON)
+    for (; idx + 16 <= len; idx += 16)
+        vst1q_u8((uint8_t *)(data + idx), vrev16q_u8(vld1q_u8((const uint8_t *)(data + idx))));
+#endif
+    for (; idx + 2 <= len; idx += 2)
+        std::swap(data[idx], data[idx + 1]);
+}
+
+void Transform::swap32(char *data, qint64 len)
+{
+    qint64 idx = 0;
+#if defined(TRANSFORM_SSE2)
+    // Bytes are swapped within 16 bit words, then the words within 32 bits
+    for (; idx + 16 <= len; idx += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + idx));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128((__m128i *)(data + idx), v);
+    }
+#elif defined(TRANSFORM_NEON)
+    for (; idx + 16 <= len; idx += 16)
+        vst1q_u8((uint8_t *)(data + idx), vrev32q_u8(vld1q_u8((const uint8_t *)(data + idx))));
+#endif
+    for (; idx + 4 <= len; idx += 4)
+    {
+        std::swap(data[idx], data[idx + 3]);
+        std::swap(data[idx + 1], data[idx + 2]);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+/** \cond docNever */
+
+/*! Transform is one bulk operation on a range of bytes:
+ *
+ *   Fill     the range repeats the operand
+ *   Xor      bytes are xored with the operand, repeated (decoding xor ciphers)
+ *   Add      the operand, repeated, is added bytewise modulo 256
+ *   Swap16   byte order of 16 bit words is swapped
+ *   Swap32   byte order of 32 bit words is swapped
+ *
+ * Patterns and words are aligned to the start of the range: apply() gets the
+ * distance of its bytes from there, so a range can be done block by block.
+ * Trailing bytes, which are no whole word, are left as they are.
+ *
+ * The kernels work on 16 bytes at a time (SSE2 or NEON). Operands are
+ * repeated into a stream, whose length is a multiple of 16 and of the
+ * operand length, so any operand length is done with full vectors.
+ *
+ * All operations but Fill can be undone by their inverse().
+ */
+
+#include <QtCore>
+
+#define TRANSFORM_BLOCK 0x100000        // bytes of a range done per step, multiple of the word sizes
+
+class Transform
+{
+public:
+    enum Operation
+    {
+        Fill,
+        Xor,
+        Add,
+        Swap16,
+        Swap32
+    };
+
+    Transform(Operation operation=Fill, const QByteArray &operand=QByteArray(1, char(0)));
+
+    Operation operation() const;
+    QByteArray operand() const;
+    QString name() const;
+
+    bool isInvertible() const;
+    Transform inverse() const;
+
+    // Transforms len bytes at data, offset is their distance from the start
+    // of the range. For swaps it must be a multiple of the word size.
+    void apply(char *data, qint64 len, qint64 offset) const;
+
+    // Kernels, stream is repeated from phase on
+    static void fillStream(char *data, qint64 len, const char *stream, qint64 streamLen, qint64 phase);
+    static void xorStream(char *data, qint64 len, const char *stream, qint64 streamLen, qint64 phase);
+    static void addStream(char *data, qint64 len, const char *stream, qint64 streamLen, qint64 phase);
+    static void swap16(char *data, qint64 len);
+    static void swap32(char *data, qint64 len);
+
+private:
+    Operation _operation;
+    QByteArray _operand;
+    QByteArray _stream;                         // operand repeated to a multiple of 16 bytes
+};
+
+/** \endcond docNever */
+
+#endif // TRANSFORM_H
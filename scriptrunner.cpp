@@ -0,0 +1,280 @@
+#include "scriptrunner.h"
+#include "picoeasemodel.h"
+#include "sparseimage.h"
+#include "checksum.h"
+#include "chunks.h"
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QTimer>
+
+// Loops cannot expand a script to more steps than this
+constexpr int maxSteps = 100000;
+// Nor make parsing visit more lines and loop passes, e.g. ones only setting
+// variables
+constexpr qint64 maxVisits = 1000000;
+
+ScriptRunner::ScriptRunner(PicoEaseModel *model, QObject *parent)
+    : QObject(parent), m_model(model), m_running(false), m_stepActive(false), m_generation(0), m_stepsDone(0),
+      m_recordSize(32), m_window(8)
+{
+    connect(m_model, &PicoEaseModel::ManualCommandFinish, this, &ScriptRunner::manualCommandFinished);
+    connect(m_model, &PicoEaseModel::UnlockFinished, this, &ScriptRunner::unlockFinished);
+    connect(m_model, &PicoEaseModel::UpdateDumpContentToUi, this, &ScriptRunner::dumpFinished);
+    connect(m_model, &PicoEaseModel::WriteRomFinished, this, &ScriptRunner::writeFinished);
+    connect(m_model, &PicoEaseModel::SerialPortUnexpectedDisconnection, this, &ScriptRunner::portLost);
+    // A step held back by a command of the user starts once it finished
+    connect(m_model, &PicoEaseModel::BulkCommandLockUi, this, [this](bool locked) {
+        if (!locked) runNext();
+    }, Qt::QueuedConnection);
+}
+
+ScriptRunner::~ScriptRunner()
+{
+}
+
+bool ScriptRunner::enqueue(const QString &script, QString *error)
+{
+    // Variables set by lines with an error are not kept either
+    auto variables = m_variables;
+    auto lines = script.split('\n');
+    QVector<Step> steps;
+    QString message;
+    qint64 visits = 0;
+    if (!parse(lines, 0, lines.size(), steps, visits, message)) {
+        m_variables = variables;
+        if (error) *error = message;
+        return false;
+    }
+    for (auto &&step : steps)
+        m_steps.enqueue(step);
+
+    // Started later, so finished() of a step failing at once does not come
+    // before this returns
+    if (!m_running && !m_steps.isEmpty()) {
+        m_running = true;
+        m_stepsDone = 0;
+        m_totalTimer.start();
+        QMetaObject::invokeMethod(this, &ScriptRunner::runNext, Qt::QueuedConnection);
+    }
+    return true;
+}
+
+void ScriptRunner::stop()
+{
+    m_steps.clear();
+    m_stepActive = false;
+    m_generation += 1;
+    if (!m_running) return;
+    m_running = false;
+    emit finished(false, m_stepsDone, m_totalTimer.elapsed());
+}
+
+bool ScriptRunner::parse(const QStringList &lines, int begin, int end, QVector<Step> &steps, qint64 &visits,
+                         QString &error)
+{
+    auto fail = [&error](int idx, QString reason) {
+        error = tr("Line %1: %2").arg(idx + 1).arg(reason);
+        return false;
+    };
+
+    for (int idx = begin; idx < end; idx++) {
+        if (++visits > maxVisits) return fail(idx, tr("loops run more than %1 lines").arg(maxVisits));
+        if (lines.at(idx).trimmed().startsWith('#')) continue;
+        QString unknown;
+        auto line = substitute(lines.at(idx), unknown).simplified();
+        if (!unknown.isEmpty()) return fail(idx, tr("%1 is not set").arg(unknown));
+        if (line.isEmpty()) continue;
+        if (steps.size() >= maxSteps) return fail(idx, tr("more than %1 steps").arg(maxSteps));
+
+        auto args = line.split(' ');
+        auto keyword = args.first();
+        bool ok = true, ok2 = true;
+        if (keyword == "set" && args.size() == 3) {
+            m_variables[args[1]] = args[2];
+        } else if (keyword == "add" && args.size() == 3) {
+            qint64 value = m_variables.value(args[1]).toLongLong(&ok, 16);
+            qint64 delta = args[2].toLongLong(&ok2, 16);
+            if (!ok || !ok2) return fail(idx, tr("%1 or %2 is not a hex number").arg(args[1], args[2]));
+            m_variables[args[1]] = QString::number(value + delta, 16);
+        } else if (keyword == "repeat" && (args.size() == 2 || args.size() == 3)) {
+            int count = args[1].toInt(&ok);
+            if (!ok || count < 0) return fail(idx, tr("%1 is not a count").arg(args[1]));
+            // The matching end, nested loops have their own
+            int close = idx + 1;
+            for (int depth = 1; close < end; close++) {
+                auto word = lines.at(close).simplified().section(' ', 0, 0);
+                if (word == "repeat") depth++;
+                if (word == "end" && --depth == 0) break;
+            }
+            if (close == end) return fail(idx, tr("repeat without end"));
+            for (int pass = 0; pass < count; pass++) {
+                if (++visits > maxVisits) return fail(idx, tr("loops run more than %1 lines").arg(maxVisits));
+                if (args.size() == 3) m_variables[args[2]] = QString::number(pass);
+                if (!parse(lines, idx + 1, close, steps, visits, error)) return false;
+            }
+            idx = close;
+        } else if (keyword == "end") {
+            return fail(idx, tr("end without repeat"));
+        } else if (keyword == "unlock" && args.size() == 1) {
+            steps.append(Step { Step::Unlock, line, 0, 0, QString() });
+        } else if (keyword == "dump" && args.size() >= 3) {
+            qint64 address = args[1].toLongLong(&ok, 16);
+            qint64 length = args[2].toLongLong(&ok2, 16);
+            if (!ok || !ok2 || length <= 0) return fail(idx, tr("bad address or length"));
+            steps.append(Step { Step::Dump, line, address, length, args.mid(3).join(' ') });
+        } else if (keyword == "write" && args.size() >= 3) {
+            qint64 address = args[1].toLongLong(&ok, 16);
+            if (!ok) return fail(idx, tr("bad address"));
+            steps.append(Step { Step::Write, line, address, 0, args.mid(2).join(' ') });
+        } else if (keyword == "wait" && args.size() == 2) {
+            int ms = args[1].toInt(&ok);
+            if (!ok || ms < 0) return fail(idx, tr("%1 is not a time").arg(args[1]));
+            steps.append(Step { Step::Wait, line, 0, ms, QString() });
+        } else if (QStringList { "set", "add", "repeat", "unlock", "dump", "write", "wait" }.contains(keyword)) {
+            return fail(idx, tr("wrong arguments for %1").arg(keyword));
+        } else {
+            steps.append(Step { Step::Send, line, 0, 0, QString() });
+        }
+    }
+    return true;
+}
+
+QString ScriptRunner::substitute(const QString &line, QString &unknown) const
+{
+    static const QRegularExpression variable("\\$\\{(\\w+)\\}");
+    QString result;
+    qsizetype done = 0;
+    auto it = variable.globalMatch(line);
+    while (it.hasNext()) {
+        auto match = it.next();
+        auto name = match.captured(1);
+        if (!m_variables.contains(name) && unknown.isEmpty())
+            unknown = name;
+        result += line.mid(done, match.capturedStart() - done) + m_variables.value(name);
+        done = match.capturedEnd();
+    }
+    return result + line.mid(done);
+}
+
+void ScriptRunner::runNext()
+{
+    // Runs from the event loop, so the model has finished with the answer of
+    // the step before. One of the user holds the next step back.
+    if (!m_running || m_stepActive) return;
+    if (m_steps.isEmpty()) {
+        m_running = false;
+        emit finished(true, m_stepsDone, m_totalTimer.elapsed());
+        return;
+    }
+    if (m_model->IsBusy()) return;
+
+    m_step = m_steps.dequeue();
+    m_stepActive = true;
+    startStep();
+}
+
+void ScriptRunner::startStep()
+{
+    emit stepStarted(m_step.text);
+    m_stepTimer.start();
+    switch (m_step.kind) {
+    case Step::Send:
+        m_model->SendPicoEaseCommand(m_step.text + '\n');
+        break;
+    case Step::Unlock:
+        if (!m_model->IssueBulkCommand(PicoEaseModel::BCUnlockTarget))
+            stepDone(false, tr("cannot be issued"));
+        break;
+    case Step::Dump:
+        if (!m_model->IssueBulkCommand(PicoEaseModel::BCDumpRom, { {"offset", QString::number(m_step.address, 16)},
+                                                                    {"length", QString::number(m_step.length, 16)} }))
+            stepDone(false, tr("cannot be issued"));
+        break;
+    case Step::Write: {
+        m_writeFile.setFileName(m_step.path);
+        if (!m_writeFile.exists()) {
+            stepDone(false, tr("%1 does not exist").arg(m_step.path));
+            break;
+        }
+        m_writeChunks.reset(new Chunks(m_writeFile, nullptr));
+        if (!m_model->IssueWriteRom(m_writeChunks.data(), 0, m_writeChunks->size(), m_step.address,
+                                    m_recordSize, m_window)) {
+            m_writeChunks.reset();
+            stepDone(false, tr("cannot be issued"));
+        }
+        break;
+    }
+    case Step::Wait: {
+        int generation = m_generation;
+        QTimer::singleShot(int(m_step.length), this, [this, generation]() {
+            if (generation == m_generation) stepDone(true, QString());
+        });
+        break;
+    }
+    }
+}
+
+void ScriptRunner::stepDone(bool ok, QString result)
+{
+    m_stepActive = false;
+    m_stepsDone += 1;
+    emit stepFinished(m_step.text, ok, result, m_stepTimer.elapsed());
+    if (!ok) {
+        m_steps.clear();
+        m_running = false;
+        emit finished(false, m_stepsDone, m_totalTimer.elapsed());
+        return;
+    }
+    QMetaObject::invokeMethod(this, &ScriptRunner::runNext, Qt::QueuedConnection);
+}
+
+void ScriptRunner::manualCommandFinished()
+{
+    if (m_stepActive && m_step.kind == Step::Send)
+        stepDone(true, QString());
+}
+
+void ScriptRunner::unlockFinished(bool unlocked)
+{
+    if (m_stepActive && m_step.kind == Step::Unlock)
+        stepDone(unlocked, unlocked ? QString() : tr("target is still locked"));
+}
+
+void ScriptRunner::dumpFinished(QSharedPointer<SparseImage> image, size_t)
+{
+    if (!m_stepActive || m_step.kind != Step::Dump) return;
+    image->open(QIODevice::ReadOnly);
+    auto data = image->readAll();
+    image->close();
+
+    quint32 crc = Checksum::crc32(0xffffffff, data.constData(), data.size()) ^ 0xffffffff;
+    QString result = tr("CRC-32 %1").arg(crc, 8, 16, QChar('0')).toUpper();
+    if (data.size() != m_step.length) {
+        stepDone(false, tr("%1 of %2 bytes read").arg(data.size()).arg(m_step.length));
+        return;
+    }
+    if (!m_step.path.isEmpty()) {
+        QSaveFile file(m_step.path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+            stepDone(false, tr("%1 cannot be saved").arg(m_step.path));
+            return;
+        }
+    }
+    stepDone(true, result);
+}
+
+void ScriptRunner::writeFinished(bool ok)
+{
+    // Kept until the model is done with it, also if the step was stopped
+    m_writeChunks.reset();
+    if (m_stepActive && m_step.kind == Step::Write)
+        stepDone(ok, ok ? QString() : tr("write failed"));
+}
+
+void ScriptRunner::portLost()
+{
+    if (m_stepActive)
+        stepDone(false, tr("serial port error"));
+    else
+        stop();
+}
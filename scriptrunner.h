@@ -0,0 +1,97 @@
+#ifndef SCRIPTRUNNER_H
+#define SCRIPTRUNNER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QQueue>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QVector>
+
+class Chunks;
+class PicoEaseModel;
+class SparseImage;
+
+// Runs commands of a script or typed ahead one after the other, each started
+// as soon as the one before finished, so the link does not wait for the user
+// between them. A script has one command per line:
+//
+//   # comment
+//   set <name> <value>             ${name} is replaced by value in later lines
+//   add <name> <value>             adds value to the variable (both hex)
+//   repeat <count> [<name>]        runs the lines up to the matching "end"
+//   end                            count times, name counting from 0
+//   unlock
+//   dump <address> <length> [<file>]
+//   write <address> <file>
+//   wait <ms>
+//
+// Every other line is sent to PicoEASE as typed. Counts and ms are decimal,
+// the other numbers hex. Loops and variables are expanded when lines are
+// enqueued, variables are kept for the lines enqueued later.
+class ScriptRunner : public QObject
+{
+    Q_OBJECT
+public:
+    ScriptRunner(PicoEaseModel *model, QObject *parent = nullptr);
+    ~ScriptRunner();
+
+    // Appends the commands of the lines and starts them from the event loop
+    // unless others run. Lines with an error append nothing, error tells the
+    // line and why.
+    bool enqueue(const QString &script, QString *error = nullptr);
+    // Drops the queued commands, the answer of the one running is ignored
+    void stop();
+    bool isRunning() const { return m_running; }
+    int pending() const { return m_steps.size(); }
+
+    void setWriteParameters(int recordSize, int window) { m_recordSize = recordSize; m_window = window; }
+
+signals:
+    void stepStarted(QString step);
+    void stepFinished(QString step, bool ok, QString result, qint64 ms);
+    // The queue ran empty or a step failed, which drops the rest
+    void finished(bool ok, int steps, qint64 ms);
+
+private slots:
+    void runNext();
+    void manualCommandFinished();
+    void unlockFinished(bool unlocked);
+    void dumpFinished(QSharedPointer<SparseImage> image, size_t offset);
+    void writeFinished(bool ok);
+    void portLost();
+
+private:
+    struct Step {
+        enum Kind { Send, Unlock, Dump, Write, Wait } kind;
+        QString text;                             ///< Line as run, variables replaced
+        qint64 address;
+        qint64 length;                            ///< Bytes of a dump, ms of a wait
+        QString path;
+    };
+
+    bool parse(const QStringList &lines, int begin, int end, QVector<Step> &steps, qint64 &visits, QString &error);
+    QString substitute(const QString &line, QString &unknown) const; ///< unknown gets a variable not set
+    void startStep();
+    void stepDone(bool ok, QString result);
+
+    PicoEaseModel *m_model;
+    QHash<QString, QString> m_variables;
+    QQueue<Step> m_steps;
+    Step m_step;                                  ///< Step running
+    bool m_running;                               ///< Steps run until the queue is empty
+    bool m_stepActive;                            ///< m_step is running
+    int m_generation;                             ///< Counts stop(), late waits are told apart by it
+    int m_stepsDone;
+    QElapsedTimer m_stepTimer;
+    QElapsedTimer m_totalTimer;
+
+    int m_recordSize;
+    int m_window;
+    QFile m_writeFile;
+    QScopedPointer<Chunks> m_writeChunks;         ///< Over m_writeFile while it is written
+};
+
+#endif // SCRIPTRUNNER_H
@@ -0,0 +1,205 @@
+#include "signaturepanel.h"
+#include "qhexedit.h"
+#include <QAbstractTableModel>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QSettings>
+#include <QTableView>
+#include <QtConcurrent>
+#include <algorithm>
+
+// Partitions are scanned in parallel, each one at least this big
+constexpr qint64 minPartitionSize = 0x100000;
+
+class SignatureHitModel : public QAbstractTableModel
+{
+public:
+    SignatureHitModel(const SignatureSet *signatures, QObject *parent = nullptr) :
+        QAbstractTableModel(parent), m_signatures(signatures), m_addressOffset(0) {}
+
+    void setHits(QVector<SignatureSet::Hit> hits, qint64 addressOffset) {
+        beginResetModel();
+        m_hits = std::move(hits);
+        m_addressOffset = addressOffset;
+        endResetModel();
+    }
+
+    const SignatureSet::Hit &hit(int row) const { return m_hits.at(row); }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : m_hits.size();
+    }
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : 3;
+    }
+
+    QVariant data(const QModelIndex &index, int role) const override {
+        if (role != Qt::DisplayRole) return QVariant();
+
+        auto &hit = m_hits.at(index.row());
+        auto &signature = m_signatures->signature(hit.signature);
+        switch (index.column()) {
+        case 0: return QString("%1").arg(hit.pos + m_addressOffset, 8, 16, QChar('0')).toUpper();
+        case 1: return QString::number(signature.bytes.size());
+        case 2: return signature.name;
+        }
+        return QVariant();
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override {
+        if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return QVariant();
+        switch (section) {
+        case 0: return QObject::tr("Address");
+        case 1: return QObject::tr("Length");
+        case 2: return QObject::tr("Signature");
+        }
+        return QVariant();
+    }
+
+private:
+    const SignatureSet *m_signatures;
+    QVector<SignatureSet::Hit> m_hits;
+    qint64 m_addressOffset;
+};
+
+SignaturePanel::SignaturePanel(QWidget *parent)
+    : QWidget(parent)
+{
+    m_btnLoad = new QPushButton(tr("Load..."), this);
+    m_btnScan = new QPushButton(tr("Scan"), this);
+    m_btnCancel = new QPushButton(tr("Cancel"), this);
+    m_status = new QLabel(this);
+    m_model = new SignatureHitModel(&m_signatures, this);
+    m_view = new QTableView(this);
+    m_view->setModel(m_model);
+    m_view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_view->verticalHeader()->setVisible(false);
+    m_view->horizontalHeader()->setStretchLastSection(true);
+
+    auto buttons = new QHBoxLayout;
+    buttons->addWidget(m_btnLoad);
+    buttons->addWidget(m_btnScan);
+    buttons->addWidget(m_btnCancel);
+    auto layout = new QVBoxLayout(this);
+    layout->setContentsMargins(3, 3, 3, 3);
+    layout->addLayout(buttons);
+    layout->addWidget(m_status);
+    layout->addWidget(m_view);
+
+    connect(m_btnLoad, &QPushButton::clicked, this, &SignaturePanel::loadSignatures);
+    connect(m_btnScan, &QPushButton::clicked, this, &SignaturePanel::startScan);
+    connect(m_btnCancel, &QPushButton::clicked, this, &SignaturePanel::cancelScan);
+    connect(m_view, &QTableView::doubleClicked, this, &SignaturePanel::hitDoubleClicked);
+    connect(&m_watcher, &QFutureWatcherBase::finished, this, &SignaturePanel::scanFinished);
+    connect(&m_watcher, &QFutureWatcherBase::progressValueChanged, this, [this](int value) {
+        m_status->setText(tr("Scanning... %1/%2").arg(value).arg(m_watcher.progressMaximum()));
+    });
+
+    updateState();
+}
+
+SignaturePanel::~SignaturePanel()
+{
+    m_watcher.cancel();
+    m_watcher.waitForFinished();
+}
+
+void SignaturePanel::setEditor(QHexEdit *editor)
+{
+    // A scan running goes on, it stops with the editor it reads
+    m_editor = editor;
+    updateState();
+}
+
+void SignaturePanel::loadSignatures()
+{
+    QSettings settings("RigoLigo", "PicoEaseUI");
+    auto path = QFileDialog::getOpenFileName(this,
+                                             tr("Load signature library"),
+                                             settings.value("DialogPath/Signatures").toString(),
+                                             tr("Signature file (*.sig *.txt);;All Files (*.*)"));
+    if (path.isEmpty()) return;
+    settings.setValue("DialogPath/Signatures", QFileInfo(path).dir().path());
+
+    m_model->setHits({}, 0);
+    m_signatures.clear();
+    if (!m_signatures.load(path)) {
+        QMessageBox::warning(this, tr("Signature library"), m_signatures.errorString());
+    }
+    updateState();
+}
+
+void SignaturePanel::startScan()
+{
+    if (!m_editor || m_watcher.isRunning() || m_signatures.count() == 0) return;
+
+    // Every partition reports the hits starting inside it, reading across its
+    // end as far as the longest signature needs.
+    m_scannedEditor = m_editor;
+    // The scan stops before the data it reads is replaced or destroyed, also
+    // if another editor is shown meanwhile
+    disconnect(m_scanConnection);
+    m_scanConnection = connect(m_scannedEditor, &QHexEdit::dataAboutToBeReplaced, this, [this]() {
+        m_watcher.cancel();
+        m_watcher.waitForFinished();
+    });
+    Chunks *chunks = m_editor->chunks();
+    qint64 size = chunks->size();
+    qint64 step = std::max(minPartitionSize, size / (QThread::idealThreadCount() * 4) + 1);
+    QList<QPair<qint64, qint64>> partitions;
+    for (qint64 pos = 0; pos < size; pos += step)
+        partitions.append(qMakePair(pos, std::min(size, pos + step)));
+
+    const SignatureSet *signatures = &m_signatures;
+    m_watcher.setFuture(QtConcurrent::mapped(partitions, [chunks, signatures](const QPair<qint64, qint64> &range) {
+        return signatures->scan(*chunks, range.first, range.second);
+    }));
+    updateState();
+}
+
+void SignaturePanel::cancelScan()
+{
+    m_watcher.cancel();
+}
+
+void SignaturePanel::scanFinished()
+{
+    disconnect(m_scanConnection);
+    QVector<SignatureSet::Hit> hits;
+    if (!m_watcher.isCanceled()) {
+        for (auto &partition : m_watcher.future().results())
+            hits += partition;
+        std::sort(hits.begin(), hits.end(), [](const SignatureSet::Hit &a, const SignatureSet::Hit &b) {
+            return a.pos < b.pos || (a.pos == b.pos && a.signature < b.signature);
+        });
+    }
+    m_model->setHits(hits, m_scannedEditor ? m_scannedEditor->addressOffset() : 0);
+    updateState();
+    if (m_watcher.isCanceled())
+        m_status->setText(tr("Scan cancelled"));
+    else
+        m_status->setText(tr("%n hit(s)", nullptr, hits.size()));
+}
+
+void SignaturePanel::hitDoubleClicked(const QModelIndex &index)
+{
+    if (!index.isValid() || !m_scannedEditor) return;
+    auto &hit = m_model->hit(index.row());
+    emit hitActivated(m_scannedEditor, hit.pos, m_signatures.signature(hit.signature).bytes.size());
+}
+
+void SignaturePanel::updateState()
+{
+    bool running = m_watcher.isRunning();
+    m_btnLoad->setEnabled(!running);
+    m_btnScan->setEnabled(!running && m_editor && m_signatures.count() > 0);
+    m_btnCancel->setEnabled(running);
+    if (!running)
+        m_status->setText(tr("%n signature(s) loaded", nullptr, m_signatures.count()));
+}
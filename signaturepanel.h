@@ -0,0 +1,52 @@
+#ifndef SIGNATUREPANEL_H
+#define SIGNATUREPANEL_H
+
+#include <QWidget>
+#include <QFutureWatcher>
+#include <QPointer>
+#include "signatureset.h"
+
+class QHexEdit;
+class QLabel;
+class QPushButton;
+class QTableView;
+class SignatureHitModel;
+
+// Scans the image of an editor for a library of byte signatures and lists the hits
+class SignaturePanel : public QWidget
+{
+    Q_OBJECT
+public:
+    SignaturePanel(QWidget *parent = nullptr);
+    ~SignaturePanel();
+
+    void setEditor(QHexEdit *editor); ///< Editor to be scanned by the next scan
+
+signals:
+    void hitActivated(QHexEdit *editor, qint64 pos, qint64 length);
+
+private slots:
+    void loadSignatures();
+    void startScan();
+    void cancelScan();
+    void scanFinished();
+    void hitDoubleClicked(const QModelIndex &index);
+
+private:
+    void updateState();
+
+    SignatureSet m_signatures;
+    QPointer<QHexEdit> m_editor;
+    QPointer<QHexEdit> m_scannedEditor;
+    QMetaObject::Connection m_scanConnection;    ///< Stops the scan before m_scannedEditor replaces its data
+    QFutureWatcher<QVector<SignatureSet::Hit>> m_watcher;
+
+    QLabel *m_status;
+    QPushButton *m_btnLoad;
+    QPushButton *m_btnScan;
+    QPushButton *m_btnCancel;
+    QTableView *m_view;
+    SignatureHitModel *m_model;
+};
+
+#endif // SIGNATUREPANEL_H
@@ -0,0 +1,218 @@
+#include "stringspanel.h"
+#include "qhexedit.h"
+#include <QAbstractTableModel>
+#include <QCheckBox>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QSettings>
+#include <QSpinBox>
+#include <QTableView>
+#include <QtConcurrent>
+
+// Partitions are scanned in parallel, each one at least this big
+constexpr qint64 minPartitionSize = 0x100000;
+// Longer strings are cut in the list
+constexpr int maxShownLength = 256;
+
+// Only the rows in view are asked for, so the text is read from the editor
+// then instead of being kept for every match
+class StringMatchModel : public QAbstractTableModel
+{
+public:
+    StringMatchModel(QObject *parent = nullptr) :
+        QAbstractTableModel(parent), m_addressOffset(0) {}
+
+    void setMatches(QVector<StringScanner::Match> matches, QHexEdit *editor) {
+        beginResetModel();
+        m_matches = std::move(matches);
+        m_editor = editor;
+        m_addressOffset = editor ? editor->addressOffset() : 0;
+        endResetModel();
+    }
+
+    const StringScanner::Match &match(int row) const { return m_matches.at(row); }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : m_matches.size();
+    }
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : 4;
+    }
+
+    QVariant data(const QModelIndex &index, int role) const override {
+        if (role != Qt::DisplayRole) return QVariant();
+
+        auto &match = m_matches.at(index.row());
+        switch (index.column()) {
+        case 0: return QString("%1").arg(match.pos + m_addressOffset, 8, 16, QChar('0')).toUpper();
+        case 1: return QString::number(match.length);
+        case 2: return match.encoding == StringScanner::Utf16Le ? QStringLiteral("UTF-16LE") : QStringLiteral("ASCII");
+        case 3:
+            if (!m_editor) return QVariant();
+            return StringScanner::text(*m_editor->chunks(), match, maxShownLength);
+        }
+        return QVariant();
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override {
+        if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return QVariant();
+        switch (section) {
+        case 0: return QObject::tr("Address");
+        case 1: return QObject::tr("Length");
+        case 2: return QObject::tr("Type");
+        case 3: return QObject::tr("String");
+        }
+        return QVariant();
+    }
+
+private:
+    QVector<StringScanner::Match> m_matches;
+    QPointer<QHexEdit> m_editor;
+    qint64 m_addressOffset;
+};
+
+StringsPanel::StringsPanel(QWidget *parent)
+    : QWidget(parent)
+{
+    QSettings settings("RigoLigo", "PicoEaseUI");
+    m_minLength = new QSpinBox(this);
+    m_minLength->setRange(2, 256);
+    m_minLength->setValue(settings.value("Strings/MinLength", 4).toInt());
+    m_minLength->setPrefix(tr("Min. length: "));
+    m_chkAscii = new QCheckBox(tr("ASCII"), this);
+    m_chkAscii->setChecked(settings.value("Strings/Ascii", true).toBool());
+    m_chkUtf16 = new QCheckBox(tr("UTF-16LE"), this);
+    m_chkUtf16->setChecked(settings.value("Strings/Utf16", true).toBool());
+    m_btnScan = new QPushButton(tr("Scan"), this);
+    m_btnCancel = new QPushButton(tr("Cancel"), this);
+    m_status = new QLabel(this);
+    m_model = new StringMatchModel(this);
+    m_view = new QTableView(this);
+    m_view->setModel(m_model);
+    m_view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_view->setWordWrap(false);
+    m_view->verticalHeader()->setVisible(false);
+    // Fixed row heights, so a million rows do not have to be measured
+    m_view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    m_view->horizontalHeader()->setStretchLastSection(true);
+
+    auto options = new QHBoxLayout;
+    options->addWidget(m_minLength);
+    options->addWidget(m_chkAscii);
+    options->addWidget(m_chkUtf16);
+    auto buttons = new QHBoxLayout;
+    buttons->addWidget(m_btnScan);
+    buttons->addWidget(m_btnCancel);
+    auto layout = new QVBoxLayout(this);
+    layout->setContentsMargins(3, 3, 3, 3);
+    layout->addLayout(options);
+    layout->addLayout(buttons);
+    layout->addWidget(m_status);
+    layout->addWidget(m_view);
+
+    connect(m_btnScan, &QPushButton::clicked, this, &StringsPanel::startScan);
+    connect(m_btnCancel, &QPushButton::clicked, this, &StringsPanel::cancelScan);
+    connect(m_chkAscii, &QCheckBox::toggled, this, &StringsPanel::updateState);
+    connect(m_chkUtf16, &QCheckBox::toggled, this, &StringsPanel::updateState);
+    connect(m_view, &QTableView::doubleClicked, this, &StringsPanel::matchDoubleClicked);
+    connect(&m_watcher, &QFutureWatcherBase::finished, this, &StringsPanel::scanFinished);
+    connect(&m_watcher, &QFutureWatcherBase::progressValueChanged, this, [this](int value) {
+        m_status->setText(tr("Scanning... %1/%2").arg(value).arg(m_watcher.progressMaximum()));
+    });
+
+    updateState();
+}
+
+StringsPanel::~StringsPanel()
+{
+    m_watcher.cancel();
+    m_watcher.waitForFinished();
+
+    QSettings settings("RigoLigo", "PicoEaseUI");
+    settings.setValue("Strings/MinLength", m_minLength->value());
+    settings.setValue("Strings/Ascii", m_chkAscii->isChecked());
+    settings.setValue("Strings/Utf16", m_chkUtf16->isChecked());
+}
+
+void StringsPanel::setEditor(QHexEdit *editor)
+{
+    // A scan running goes on, it stops with the editor it reads
+    m_editor = editor;
+    updateState();
+}
+
+void StringsPanel::startScan()
+{
+    if (!m_editor || m_watcher.isRunning()) return;
+    StringScanner scanner(m_minLength->value(), m_chkAscii->isChecked(), m_chkUtf16->isChecked());
+    if (!scanner.ascii() && !scanner.utf16()) return;
+
+    // Every partition reports the strings starting inside it, reading across
+    // its end until they end.
+    m_scannedEditor = m_editor;
+    // The scan stops before the data it reads is replaced or destroyed, also
+    // if another editor is shown meanwhile
+    disconnect(m_scanConnection);
+    m_scanConnection = connect(m_scannedEditor, &QHexEdit::dataAboutToBeReplaced, this, [this]() {
+        m_watcher.cancel();
+        m_watcher.waitForFinished();
+    });
+    m_model->setMatches({}, nullptr);
+    Chunks *chunks = m_editor->chunks();
+    qint64 size = chunks->size();
+    qint64 step = std::max(minPartitionSize, size / (QThread::idealThreadCount() * 4) + 1);
+    QList<QPair<qint64, qint64>> partitions;
+    for (qint64 pos = 0; pos < size; pos += step)
+        partitions.append(qMakePair(pos, std::min(size, pos + step)));
+
+    m_watcher.setFuture(QtConcurrent::mapped(partitions, [chunks, scanner](const QPair<qint64, qint64> &range) {
+        return scanner.scan(*chunks, range.first, range.second);
+    }));
+    updateState();
+}
+
+void StringsPanel::cancelScan()
+{
+    m_watcher.cancel();
+}
+
+void StringsPanel::scanFinished()
+{
+    disconnect(m_scanConnection);
+    // Partitions are in order and their matches sorted, so they are only appended
+    QVector<StringScanner::Match> matches;
+    if (!m_watcher.isCanceled()) {
+        for (auto &partition : m_watcher.future().results())
+            matches += partition;
+    }
+    m_model->setMatches(matches, m_scannedEditor);
+    updateState();
+    if (m_watcher.isCanceled())
+        m_status->setText(tr("Scan cancelled"));
+    else
+        m_status->setText(tr("%n string(s)", nullptr, matches.size()));
+}
+
+void StringsPanel::matchDoubleClicked(const QModelIndex &index)
+{
+    if (!index.isValid() || !m_scannedEditor) return;
+    auto &match = m_model->match(index.row());
+    emit stringActivated(m_scannedEditor, match.pos, StringScanner::byteLength(match));
+}
+
+void StringsPanel::updateState()
+{
+    bool running = m_watcher.isRunning();
+    bool encodings = m_chkAscii->isChecked() || m_chkUtf16->isChecked();
+    m_minLength->setEnabled(!running);
+    m_chkAscii->setEnabled(!running);
+    m_chkUtf16->setEnabled(!running);
+    m_btnScan->setEnabled(!running && m_editor && encodings);
+    m_btnCancel->setEnabled(running);
+    if (!running && m_model->rowCount() == 0)
+        m_status->setText(m_editor ? tr("Ready") : tr("No editor"));
+}
@@ -0,0 +1,54 @@
+#ifndef STRINGSPANEL_H
+#define STRINGSPANEL_H
+
+#include <QWidget>
+#include <QFutureWatcher>
+#include <QPointer>
+#include "stringscanner.h"
+
+class QHexEdit;
+class QCheckBox;
+class QLabel;
+class QPushButton;
+class QSpinBox;
+class QTableView;
+class StringMatchModel;
+
+// Lists the ASCII and UTF-16LE strings in the image of an editor
+class StringsPanel : public QWidget
+{
+    Q_OBJECT
+public:
+    StringsPanel(QWidget *parent = nullptr);
+    ~StringsPanel();
+
+    void setEditor(QHexEdit *editor); ///< Editor to be scanned by the next scan
+
+signals:
+    void stringActivated(QHexEdit *editor, qint64 pos, qint64 length);
+
+private slots:
+    void startScan();
+    void cancelScan();
+    void scanFinished();
+    void matchDoubleClicked(const QModelIndex &index);
+
+private:
+    void updateState();
+
+    QPointer<QHexEdit> m_editor;
+    QPointer<QHexEdit> m_scannedEditor;
+    QMetaObject::Connection m_scanConnection;    ///< Stops the scan before m_scannedEditor replaces its data
+    QFutureWatcher<QVector<StringScanner::Match>> m_watcher;
+
+    QLabel *m_status;
+    QSpinBox *m_minLength;
+    QCheckBox *m_chkAscii;
+    QCheckBox *m_chkUtf16;
+    QPushButton *m_btnScan;
+    QPushButton *m_btnCancel;
+    QTableView *m_view;
+    StringMatchModel *m_model;
+};
+
+#endif // STRINGSPANEL_H
@@ -0,0 +1,236 @@
+#include "watchpanel.h"
+#include "picoeasemodel.h"
+#include "hexvalidator.h"
+#include "qhexedit.h"
+#include "bindiff.h"
+#include <QAction>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QSettings>
+#include <QSpinBox>
+#include <QSplitter>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+#include <algorithm>
+
+// Due watches are looked for this often, intervals are not shorter
+constexpr int schedulerTickMs = 20;
+
+WatchPanel::WatchPanel(PicoEaseModel *model, QWidget *parent)
+    : QWidget(parent), m_model(model), m_shown(-1), m_polling(-1), m_readToken(0), m_lastTick(0), m_budget(0)
+{
+    m_clock.start();
+    QSettings settings("RigoLigo", "PicoEaseUI");
+    m_edtAddress = new QLineEdit("0", this);
+    m_edtAddress->setValidator(new HexValidator(8, this));
+    m_edtAddress->setToolTip(tr("Address (hex)"));
+    m_edtLength = new QLineEdit("100", this);
+    m_edtLength->setValidator(new HexValidator(8, this));
+    m_edtLength->setToolTip(tr("Length (hex)"));
+    m_interval = new QSpinBox(this);
+    m_interval->setRange(schedulerTickMs, 60000);
+    m_interval->setValue(settings.value("Watch/Interval", 500).toInt());
+    m_interval->setSuffix(tr(" ms"));
+    auto btnAdd = new QPushButton(tr("Add"), this);
+    // Intel HEX makes the serial link carry close to three times these bytes
+    m_maxRate = new QSpinBox(this);
+    m_maxRate->setRange(64, 1000000);
+    m_maxRate->setValue(settings.value("Watch/MaxBytesPerSecond", 2048).toInt());
+    m_maxRate->setPrefix(tr("Max. "));
+    m_maxRate->setSuffix(tr(" bytes/s"));
+    m_status = new QLabel(this);
+
+    m_view = new QTreeWidget(this);
+    m_view->setColumnCount(5);
+    m_view->setHeaderLabels({ tr("Address"), tr("Length"), tr("Interval"), tr("Changed"), tr("Polls") });
+    m_view->setRootIsDecorated(false);
+    m_view->header()->setStretchLastSection(true);
+    m_view->setContextMenuPolicy(Qt::ActionsContextMenu);
+    auto remove = new QAction(tr("Remove"), m_view);
+    remove->setShortcut(QKeySequence::Delete);
+    remove->setShortcutContext(Qt::WidgetShortcut);
+    m_view->addAction(remove);
+
+    m_editor = new QHexEdit(this);
+    m_editor->setReadOnly(true);
+    m_editor->setAddressWidth(8);
+
+    auto input = new QHBoxLayout;
+    input->addWidget(m_edtAddress);
+    input->addWidget(m_edtLength);
+    input->addWidget(m_interval);
+    input->addWidget(btnAdd);
+    auto splitter = new QSplitter(Qt::Vertical, this);
+    splitter->addWidget(m_view);
+    splitter->addWidget(m_editor);
+    auto layout = new QVBoxLayout(this);
+    layout->setContentsMargins(3, 3, 3, 3);
+    layout->addLayout(input);
+    layout->addWidget(m_maxRate);
+    layout->addWidget(m_status);
+    layout->addWidget(splitter);
+
+    // Address, length (both hex), interval and whether it is polled
+    for (auto &&entry : settings.value("Watch/Ranges").toStringList()) {
+        auto fields = entry.split(' ');
+        if (fields.size() == 4)
+            appendWatch(fields[0].toLongLong(nullptr, 16), fields[1].toLongLong(nullptr, 16),
+                        fields[2].toInt(), fields[3] == "1");
+    }
+
+    connect(btnAdd, &QPushButton::clicked, this, &WatchPanel::addWatch);
+    connect(m_edtLength, &QLineEdit::returnPressed, this, &WatchPanel::addWatch);
+    connect(remove, &QAction::triggered, this, &WatchPanel::removeWatch);
+    connect(m_view, &QTreeWidget::currentItemChanged, this, &WatchPanel::currentWatchChanged);
+    connect(m_model, &PicoEaseModel::MemoryReadFinished, this, &WatchPanel::readFinished);
+    connect(&m_timer, &QTimer::timeout, this, &WatchPanel::poll);
+    m_timer.start(schedulerTickMs);
+}
+
+WatchPanel::~WatchPanel()
+{
+    QStringList ranges;
+    for (int idx = 0; idx < m_watches.size(); idx++) {
+        auto &watch = m_watches.at(idx);
+        bool enabled = m_view->topLevelItem(idx)->checkState(0) == Qt::Checked;
+        ranges.append(QString("%1 %2 %3 %4").arg(watch.address, 0, 16).arg(watch.length, 0, 16)
+                                            .arg(watch.interval).arg(enabled ? 1 : 0));
+    }
+    QSettings settings("RigoLigo", "PicoEaseUI");
+    settings.setValue("Watch/Ranges", ranges);
+    settings.setValue("Watch/Interval", m_interval->value());
+    settings.setValue("Watch/MaxBytesPerSecond", m_maxRate->value());
+}
+
+void WatchPanel::addWatch()
+{
+    qint64 length = m_edtLength->text().toLongLong(nullptr, 16);
+    if (length <= 0) return;
+    appendWatch(m_edtAddress->text().toLongLong(nullptr, 16), length, m_interval->value(), true);
+    m_view->setCurrentItem(m_view->topLevelItem(m_watches.size() - 1));
+}
+
+void WatchPanel::appendWatch(qint64 address, qint64 length, int interval, bool enabled)
+{
+    m_watches.append(Watch { address, length, interval, m_clock.elapsed(), QByteArray(), {}, 0 });
+    auto item = new QTreeWidgetItem(m_view);
+    item->setCheckState(0, enabled ? Qt::Checked : Qt::Unchecked);
+    updateItem(m_watches.size() - 1);
+}
+
+void WatchPanel::removeWatch()
+{
+    int idx = m_view->indexOfTopLevelItem(m_view->currentItem());
+    if (idx < 0) return;
+
+    // A late answer for the removed watch is not taken for another one
+    if (m_polling == idx)
+        m_polling = -1;
+    else if (m_polling > idx)
+        m_polling -= 1;
+    if (m_shown >= idx)
+        m_shown = -1;
+    m_watches.removeAt(idx);
+    delete m_view->takeTopLevelItem(idx);
+    currentWatchChanged();
+}
+
+void WatchPanel::updateItem(int idx)
+{
+    auto &watch = m_watches.at(idx);
+    auto item = m_view->topLevelItem(idx);
+    qint64 changed = 0;
+    for (auto &&run : watch.changes)
+        changed += run.second;
+    item->setText(0, QString("%1").arg(watch.address, 8, 16, QChar('0')).toUpper());
+    item->setText(1, QString::number(watch.length, 16).toUpper());
+    item->setText(2, tr("%1 ms").arg(watch.interval));
+    item->setText(3, QString::number(changed));
+    item->setText(4, QString::number(watch.polls));
+}
+
+void WatchPanel::poll()
+{
+    // The budget fills up with the bandwidth allowed, at most for one second.
+    // A read larger than it leaves it negative, later polls wait for it.
+    qint64 now = m_clock.elapsed();
+    double rate = m_maxRate->value();
+    m_budget = std::min(rate, m_budget + rate * (now - m_lastTick) / 1000);
+    m_lastTick = now;
+    if (m_polling >= 0 || m_budget < 0) return;
+
+    // One read out at a time, the most overdue watch first, so each gets its turn
+    int next = -1;
+    for (int idx = 0; idx < m_watches.size(); idx++) {
+        if (m_view->topLevelItem(idx)->checkState(0) != Qt::Checked || m_watches.at(idx).due > now)
+            continue;
+        if (next < 0 || m_watches.at(idx).due < m_watches.at(next).due)
+            next = idx;
+    }
+    if (next < 0) return;
+
+    auto &watch = m_watches[next];
+    watch.due = now + watch.interval;
+    m_budget -= watch.length;
+    m_polling = next;
+    m_readToken = m_model->RequestMemoryRead(watch.address, watch.length);
+}
+
+void WatchPanel::readFinished(quint64 token, qint64 address, QByteArray data)
+{
+    // Answers to other readers, e.g. a live view, or to a watch removed meanwhile
+    // have another token. A short answer, e.g. with a record dropped, failed.
+    if (m_polling < 0 || token != m_readToken) return;
+    int idx = m_polling;
+    m_polling = -1;
+    auto &watch = m_watches[idx];
+    if (data.size() < watch.length) {
+        m_status->setText(tr("Reading %1 failed").arg(QString("%1").arg(address, 8, 16, QChar('0')).toUpper()));
+        return;
+    }
+    m_status->clear();
+
+    data.truncate(watch.length);
+    auto previous = watch.changes;
+    bool first = watch.snapshot.isEmpty();
+    if (!first)
+        watch.changes = BinDiff::changes(watch.snapshot.constData(), data.constData(), data.size());
+    watch.snapshot = data;
+    watch.polls += 1;
+    updateItem(idx);
+    if (idx != m_shown) return;
+    if (first) {
+        showWatch(idx);
+        return;
+    }
+
+    // Only the bytes changed by this poll or the one before are touched, so
+    // just their rows are painted again
+    Chunks *chunks = m_editor->chunks();
+    for (auto &&run : previous)
+        chunks->setDataChanged(run.first, QByteArray(run.second, char(0)));
+    for (auto &&run : watch.changes)
+        chunks->overwrite(run.first, data.mid(run.first, run.second));
+}
+
+void WatchPanel::currentWatchChanged()
+{
+    showWatch(m_view->indexOfTopLevelItem(m_view->currentItem()));
+}
+
+void WatchPanel::showWatch(int idx)
+{
+    m_shown = idx;
+    if (idx < 0) {
+        m_editor->setData(QByteArray());
+        return;
+    }
+    auto &watch = m_watches.at(idx);
+    m_editor->setData(watch.snapshot);
+    m_editor->setAddressOffset(watch.address);
+    for (auto &&run : watch.changes)
+        m_editor->chunks()->setDataChanged(run.first, QByteArray(run.second, char(1)));
+}
@@ -0,0 +1,65 @@
+#ifndef WATCHPANEL_H
+#define WATCHPANEL_H
+
+#include <QWidget>
+#include <QElapsedTimer>
+#include <QTimer>
+
+class PicoEaseModel;
+class QHexEdit;
+class QLabel;
+class QLineEdit;
+class QSpinBox;
+class QTreeWidget;
+
+// Polls ranges of target memory every few ms and shows the latest snapshot of
+// the current one, the bytes changed by the last poll highlighted
+class WatchPanel : public QWidget
+{
+    Q_OBJECT
+public:
+    WatchPanel(PicoEaseModel *model, QWidget *parent = nullptr);
+    ~WatchPanel();
+
+private slots:
+    void addWatch();
+    void removeWatch();
+    void poll();
+    void readFinished(quint64 token, qint64 address, QByteArray data);
+    void currentWatchChanged();
+
+private:
+    struct Watch {
+        qint64 address;
+        qint64 length;
+        int interval;                             ///< ms from one poll to the next
+        qint64 due;                               ///< m_clock time of the next poll
+        QByteArray snapshot;
+        QVector<QPair<qint64, qint64>> changes;   ///< Bytes changed by the last poll
+        int polls;
+    };
+
+    void appendWatch(qint64 address, qint64 length, int interval, bool enabled);
+    void updateItem(int idx);
+    void showWatch(int idx);
+
+    PicoEaseModel *m_model;
+    QVector<Watch> m_watches;                     ///< In the order of the view
+    int m_shown;                                  ///< Watch in the editor, -1 if none
+    int m_polling;                                ///< Watch being read, -1 if none
+    quint64 m_readToken;                          ///< Of the read of m_polling
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    qint64 m_lastTick;
+    double m_budget;                              ///< Bytes, which may be read now
+
+    QLineEdit *m_edtAddress;
+    QLineEdit *m_edtLength;
+    QSpinBox *m_interval;
+    QSpinBox *m_maxRate;
+    QLabel *m_status;
+    QTreeWidget *m_view;
+    QHexEdit *m_editor;
+};
+
+#endif // WATCHPANEL_H